@@ -0,0 +1,201 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATFileWriter.cpp
+//
+// Purpose: Streams Log messages out to a file in large batches using a fixed size buffer.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATFileWriter.h"
+#include <cstring>
+
+namespace Atlas
+{
+   //Constructor
+   CATFileWriter::CATFileWriter(unsigned int unCapacity)
+   {
+      m_unCapacity = unCapacity;
+      m_pBuffer = new char[m_unCapacity];
+      m_unUsed = 0;
+      m_unFlushSize = m_unCapacity;
+      m_unFlushInterval = AT_LOG_FILE_INTERVAL;
+      m_ullBytesWritten = 0;
+   }
+
+   //Destructor
+   CATFileWriter::~CATFileWriter()
+   {
+      this->Close();
+      delete[] m_pBuffer;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Open
+   //
+   // Purpose:  Opens (and truncates) the file to stream into, closing any file that was already open.
+   //
+   // In:  sFilename - Name of the file to be created.
+   //      bAppend - Keep what's already in the file and carry on at the end of it instead.
+   //
+   // Out:  true if the file was opened, false otherwise.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATFileWriter::Open(const CString& sFilename, bool bAppend)
+   {
+      this->Close();
+
+      //No name?  Nothing to open.
+      if (sFilename.Empty())
+         return false;
+
+      m_fFile.open(sFilename.getCstr(), std::ios::out | (bAppend ? std::ios::app : std::ios::trunc) | std::ios::binary);
+      m_ullBytesWritten = 0;
+
+      //The size counts from the start of the file, not from when we opened it.
+      if (bAppend && m_fFile.is_open())
+      {
+         m_fFile.seekp(0, std::ios::end);
+         std::streamoff soSize = m_fFile.tellp();
+         if (soSize > 0)
+            m_ullBytesWritten = static_cast<unsigned long long>(soSize);
+      }
+      return m_fFile.is_open();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Close
+   //
+   // Purpose:  Writes out anything still waiting and closes the file.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFileWriter::Close()
+   {
+      if (!m_fFile.is_open())
+         return;
+
+      this->Flush();
+      m_fFile.close();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  WriteLine
+   //
+   // Purpose:  Adds a message and a newline to the buffer, writing the buffer out first if it won't fit.
+   //
+   // In:  pText - The message.
+   //      unLength - Number of characters in pText.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFileWriter::WriteLine(const char* pText, unsigned int unLength)
+   {
+      this->Append(pText, unLength, true);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Write
+   //
+   // Purpose:  Adds raw bytes to the buffer, writing the buffer out first if they won't fit.
+   //
+   // In:  pData - The bytes.
+   //      unLength - Number of bytes in pData.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFileWriter::Write(const char* pData, unsigned int unLength)
+   {
+      this->Append(pData, unLength, false);
+   }
+
+   //Buffers pData, adding a newline if asked.
+   void CATFileWriter::Append(const char* pData, unsigned int unLength, bool bNewline)
+   {
+      if (!m_fFile.is_open())
+         return;
+
+      unsigned int unTotal = unLength + (bNewline ? 1 : 0);
+
+      //Won't fit behind what's already waiting?  Make some room.
+      if (m_unUsed + unTotal > m_unCapacity)
+         this->Flush();
+
+      //Bigger than the whole buffer?  Then skip the buffer altogether.
+      if (unTotal > m_unCapacity)
+      {
+         m_fFile.write(pData, unLength);
+         if (bNewline)
+            m_fFile.put('\n');
+         m_fFile.flush();
+         m_ullBytesWritten += unTotal;
+         return;
+      }
+
+      if (m_unUsed == 0)
+         m_tpFirstWaiting = std::chrono::steady_clock::now();
+
+      memcpy(m_pBuffer + m_unUsed, pData, unLength);
+      m_unUsed += unLength;
+      if (bNewline)
+         m_pBuffer[m_unUsed++] = '\n';
+
+      if (m_unUsed >= m_unFlushSize)
+         this->Flush();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Flush
+   //
+   // Purpose:  Writes everything waiting in the buffer out to the file.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFileWriter::Flush()
+   {
+      if (m_unUsed == 0 || !m_fFile.is_open())
+         return;
+
+      m_fFile.write(m_pBuffer, m_unUsed);
+      m_fFile.flush();
+      m_ullBytesWritten += m_unUsed;
+      m_unUsed = 0;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  FlushIfDue
+   //
+   // Purpose:  Writes out the buffer if the oldest waiting message has been there longer than the flush interval.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFileWriter::FlushIfDue()
+   {
+      if (m_unUsed == 0)
+         return;
+
+      std::chrono::steady_clock::duration tdWaiting = std::chrono::steady_clock::now() - m_tpFirstWaiting;
+      if (tdWaiting >= std::chrono::milliseconds(m_unFlushInterval))
+         this->Flush();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  SetFlushPolicy
+   //
+   // Purpose:  Sets when the buffer gets written out.
+   //
+   // In:  unFlushSize - Write out once this many bytes are waiting, capped at the buffer size.
+   //      unFlushInterval - Write out once the oldest waiting message is this many milliseconds old.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFileWriter::SetFlushPolicy(unsigned int unFlushSize, unsigned int unFlushInterval)
+   {
+      if (unFlushSize == 0 || unFlushSize > m_unCapacity)
+         unFlushSize = m_unCapacity;
+
+      m_unFlushSize = unFlushSize;
+      m_unFlushInterval = unFlushInterval;
+   }
+}
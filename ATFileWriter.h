@@ -0,0 +1,141 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATFileWriter.h
+//
+// Purpose: Streams Log messages out to a file in large batches using a fixed size buffer, so memory use stays flat no
+//          matter how long the Logger runs and at most one batch is lost if the process goes down.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <fstream>
+#include <chrono>
+#include "CString.h"
+
+//Size of the file buffer, this is all the memory the file output will ever use.
+#ifndef AT_LOG_FILE_BUFFER
+#define AT_LOG_FILE_BUFFER (64 * 1024)
+#endif
+
+//Longest a message will sit in the file buffer before it gets written out (in milliseconds).
+#ifndef AT_LOG_FILE_INTERVAL
+#define AT_LOG_FILE_INTERVAL 1000
+#endif
+
+namespace Atlas
+{
+   //Somewhere bytes can be streamed out to, e.g. a file or a socket (see CATBinaryWriter).
+   class CATByteOutput
+   {
+      public:
+         virtual ~CATByteOutput() {}  //Destructor
+
+         //Adds raw bytes to the output.
+         virtual void Write(const char* pData, unsigned int unLength) = 0;
+   };
+
+   class CATFileWriter : public CATByteOutput
+   {
+      private:
+         std::ofstream           m_fFile;  //The file we're streaming into.
+         char*                   m_pBuffer;  //Messages waiting to be written out.
+         unsigned int            m_unCapacity;  //Size of m_pBuffer.
+         unsigned int            m_unUsed;  //Number of bytes waiting in m_pBuffer.
+         unsigned int            m_unFlushSize;  //Write out once this many bytes are waiting.
+         unsigned int            m_unFlushInterval;  //Write out once the oldest waiting message is this old (milliseconds).
+         std::chrono::steady_clock::time_point m_tpFirstWaiting;  //When the oldest waiting message was added.
+         unsigned long long      m_ullBytesWritten;  //Total number of bytes written to the file since it was opened.
+
+         void Append(const char* pData, unsigned int unLength, bool bNewline);  //Buffers pData, adding a newline if asked.
+
+         CATFileWriter(const CATFileWriter&);  //Copy Constructor
+         CATFileWriter& operator=(const CATFileWriter&);  //Assignment Operator
+
+      public:
+         CATFileWriter(unsigned int unCapacity = AT_LOG_FILE_BUFFER);  //Constructor
+         ~CATFileWriter();  //Destructor
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Open
+         //
+         // Purpose:  Opens (and truncates) the file to stream into, closing any file that was already open.
+         //
+         // In:  sFilename - Name of the file to be created.
+         //      bAppend - Keep what's already in the file and carry on at the end of it instead.
+         //
+         // Out:  true if the file was opened, false otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Open(const CString& sFilename, bool bAppend = false);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Close
+         //
+         // Purpose:  Writes out anything still waiting and closes the file.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Close();
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  WriteLine
+         //
+         // Purpose:  Adds a message and a newline to the buffer, writing the buffer out first if it won't fit.
+         //
+         // In:  pText - The message.
+         //      unLength - Number of characters in pText.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void WriteLine(const char* pText, unsigned int unLength);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Write
+         //
+         // Purpose:  Adds raw bytes to the buffer, writing the buffer out first if they won't fit.
+         //
+         // In:  pData - The bytes.
+         //      unLength - Number of bytes in pData.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         virtual void Write(const char* pData, unsigned int unLength) override;
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Flush
+         //
+         // Purpose:  Writes everything waiting in the buffer out to the file.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Flush();
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  FlushIfDue
+         //
+         // Purpose:  Writes out the buffer if the oldest waiting message has been there longer than the flush interval.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void FlushIfDue();
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetFlushPolicy
+         //
+         // Purpose:  Sets when the buffer gets written out.
+         //
+         // In:  unFlushSize - Write out once this many bytes are waiting, capped at the buffer size.
+         //      unFlushInterval - Write out once the oldest waiting message is this many milliseconds old.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetFlushPolicy(unsigned int unFlushSize, unsigned int unFlushInterval);
+
+         bool IsOpen() const { return m_fFile.is_open(); }
+         unsigned long long GetBytesWritten() const { return m_ullBytesWritten; }
+         unsigned long long GetSize() const { return m_ullBytesWritten + m_unUsed; }  //Size the file will be once the buffer is written out.
+   };
+}
@@ -0,0 +1,721 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogBinary.cpp
+//
+// Purpose: The Logger's binary format and format id registry.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogBinary.h"
+#include <cstdint>
+
+namespace Atlas
+{
+   std::atomic<const char*>  CATFormatRegistry::m_apKeys[AT_LOG_MAX_FORMATS * 2] = {};
+   unsigned int              CATFormatRegistry::m_aunIds[AT_LOG_MAX_FORMATS * 2] = {};
+   std::atomic<const char*>  CATFormatRegistry::m_apFormats[AT_LOG_MAX_FORMATS] = {};
+   std::atomic<SATFormatTemplate*> CATFormatRegistry::m_apTemplates[AT_LOG_MAX_FORMATS] = {};
+   std::atomic<unsigned int> CATFormatRegistry::m_unCount(1);
+   std::mutex                CATFormatRegistry::m_mtxInsert;
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Register
+   //
+   // Purpose:  Returns the id of a string literal format, handing out a new one the first time it's seen.
+   //
+   // In:  pFormat - The format, must stay around for the life of the program.
+   //
+   // Out:  The id, PREFORMATTED_ID if the registry is full.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned int CATFormatRegistry::Register(const char* pFormat)
+   {
+      const unsigned int unMask = AT_LOG_MAX_FORMATS * 2 - 1;
+      unsigned int unSlot = static_cast<unsigned int>((reinterpret_cast<uintptr_t>(pFormat) >> 3) * 2654435761u) & unMask;
+
+      //Already have it?  Then we're done, no locking needed.
+      for (;;)
+      {
+         const char* pKey = m_apKeys[unSlot].load(std::memory_order_acquire);
+         if (pKey == pFormat)
+            return m_aunIds[unSlot];
+         if (!pKey)
+            break;
+         unSlot = (unSlot + 1) & unMask;
+      }
+
+      //First time we've seen it, add it under the lock (someone may have beaten us to it).
+      std::lock_guard<std::mutex> lgInsert(m_mtxInsert);
+      for (;;)
+      {
+         const char* pKey = m_apKeys[unSlot].load(std::memory_order_relaxed);
+         if (pKey == pFormat)
+            return m_aunIds[unSlot];
+         if (!pKey)
+            break;
+         unSlot = (unSlot + 1) & unMask;
+      }
+
+      unsigned int unId = m_unCount.load(std::memory_order_relaxed);
+      if (unId >= AT_LOG_MAX_FORMATS)
+         return PREFORMATTED_ID;
+
+      m_apFormats[unId].store(pFormat, std::memory_order_release);
+      m_aunIds[unSlot] = unId;
+      m_apKeys[unSlot].store(pFormat, std::memory_order_release);
+      m_unCount.store(unId + 1, std::memory_order_release);
+      return unId;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  GetFormat
+   //
+   // Purpose:  Returns the format for a given id.
+   //
+   // In:  unId - The id handed out by Register.
+   //
+   // Out:  The format, "{s}" for an unknown id.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   const char* CATFormatRegistry::GetFormat(unsigned int unId)
+   {
+      const char* pFormat = 0;
+      if (unId != PREFORMATTED_ID && unId < AT_LOG_MAX_FORMATS)
+         pFormat = m_apFormats[unId].load(std::memory_order_acquire);
+      return pFormat ? pFormat : "{s}";
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  GetTemplate
+   //
+   // Purpose:  Returns the compiled format for a given id, compiling it the first time it's asked for.  Every
+   //           message from the same call site shares it from then on, so its format is only ever scanned once.
+   //
+   // In:  unId - The id handed out by Register.
+   //
+   // Out:  The template, "{s}" compiled for an unknown id.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   const SATFormatTemplate& CATFormatRegistry::GetTemplate(unsigned int unId)
+   {
+      //Anything without a format of its own shares id 0's "{s}".
+      const char* pFormat = GetFormat(unId);
+      if (unId >= AT_LOG_MAX_FORMATS || (unId != PREFORMATTED_ID && !m_apFormats[unId].load(std::memory_order_relaxed)))
+         unId = PREFORMATTED_ID;
+
+      SATFormatTemplate* pTemplate = m_apTemplates[unId].load(std::memory_order_acquire);
+      if (pTemplate)
+         return *pTemplate;
+
+      //Two threads may compile the same format at once, the loser throws its copy away.
+      SATFormatTemplate* pCompiled = CATFormatter::Compile(pFormat);
+      if (m_apTemplates[unId].compare_exchange_strong(pTemplate, pCompiled, std::memory_order_acq_rel))
+         return *pCompiled;
+
+      CATFormatter::Free(pCompiled);
+      return *pTemplate;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  EncodeArgs
+   //
+   // Purpose:  Copies the arguments' raw bytes into a buffer, strings are truncated to fit and end in
+   //           AT_LOG_TRUNCATED.  Stops at the first argument that doesn't fit at all, a field's name and value go
+   //           in together or not at all.
+   //
+   // In:  pOut - Where the bytes are going.
+   //      unSize - Size of pOut.
+   //      pArgs - The arguments.
+   //      unArgCount - Number of arguments.
+   //      unEncoded - Receives the number of arguments that were encoded.
+   //      pCut - Set to true if a string had to be truncated, left alone otherwise.
+   //
+   // Out:  Number of bytes used.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned int CATLogBinary::EncodeArgs(char* pOut, unsigned int unSize, const SATFormatArg* pArgs, unsigned int unArgCount, unsigned int& unEncoded,
+      bool* pCut)
+   {
+      unsigned int unUsed = 0;
+      for (unEncoded = 0; unEncoded < unArgCount; unEncoded++)
+      {
+         const SATFormatArg& Arg = pArgs[unEncoded];
+         unsigned int unStart = unUsed;  //Where to back up to if the value doesn't fit after its name.
+
+         //Fields start off with their name.
+         if (Arg.m_pKey)
+         {
+            if (unSize - unUsed < 2u + Arg.m_ucKeyLength)
+               return unUsed;
+            pOut[unUsed++] = static_cast<char>(ARG_KEY);
+            pOut[unUsed++] = static_cast<char>(Arg.m_ucKeyLength);
+            memcpy(pOut + unUsed, Arg.m_pKey, Arg.m_ucKeyLength);
+            unUsed += Arg.m_ucKeyLength;
+         }
+
+         unsigned int unRoom = unSize - unUsed;
+         switch (Arg.m_ucType)
+         {
+            case ARG_CHAR:
+            case ARG_BOOL:
+            {
+               if (unRoom < 2)
+                  return unStart;
+               pOut[unUsed++] = static_cast<char>(Arg.m_ucType);
+               pOut[unUsed++] = (Arg.m_ucType == ARG_CHAR) ? Arg.m_cValue : static_cast<char>(Arg.m_bValue);
+               break;
+            }
+            case ARG_STRING:
+            {
+               if (unRoom < 3)
+                  return unStart;
+
+               unsigned short usLength = 0;
+               bool bCut = Arg.m_pString && Arg.m_unLength > unRoom - 3;
+               if (Arg.m_pString)
+                  usLength = static_cast<unsigned short>(bCut ? unRoom - 3 : Arg.m_unLength);
+
+               pOut[unUsed++] = static_cast<char>(ARG_STRING);
+               memcpy(pOut + unUsed, &usLength, sizeof(usLength));
+               unUsed += sizeof(usLength);
+               if (usLength > 0)
+                  memcpy(pOut + unUsed, Arg.m_pString, usLength);
+               unUsed += usLength;
+
+               //Let whoever reads it know there was more.
+               if (bCut)
+               {
+                  const unsigned int unMarker = sizeof(AT_LOG_TRUNCATED) - 1;
+                  if (usLength >= unMarker)
+                     memcpy(pOut + unUsed - unMarker, AT_LOG_TRUNCATED, unMarker);
+                  if (pCut)
+                     *pCut = true;
+               }
+               break;
+            }
+            case ARG_USER:
+            {
+               //The tag goes along with the value, formatter ids are only good within this run of the program.
+               const SATTypeFormatter* pFormatter = CATTypeFormatters::Get(Arg.m_usFormatter);
+               unsigned int unTagLength = pFormatter ? pFormatter->m_unTagLength : 0;
+               if (Arg.m_unLength > 255 || unRoom < 3 + unTagLength + Arg.m_unLength)
+                  return unStart;
+
+               pOut[unUsed++] = static_cast<char>(ARG_USER);
+               pOut[unUsed++] = static_cast<char>(unTagLength);
+               if (pFormatter)
+                  memcpy(pOut + unUsed, pFormatter->m_cTag, unTagLength);
+               unUsed += unTagLength;
+               pOut[unUsed++] = static_cast<char>(Arg.m_unLength);
+               memcpy(pOut + unUsed, Arg.m_pPointer, Arg.m_unLength);
+               unUsed += Arg.m_unLength;
+               break;
+            }
+            default:  //Numbers and pointers all take up 8 bytes.
+            {
+               if (unRoom < 9)
+                  return unStart;
+               pOut[unUsed++] = static_cast<char>(Arg.m_ucType);
+               memcpy(pOut + unUsed, &Arg.m_ullValue, 8);
+               unUsed += 8;
+               break;
+            }
+         }
+      }
+      return unUsed;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  DecodeArgs
+   //
+   // Purpose:  Turns bytes written by EncodeArgs back into arguments.  Strings and field names point into pData.
+   //
+   // In:  pData - The encoded arguments.
+   //      unLength - Number of bytes in pData.
+   //      pArgs - Where the arguments are going.
+   //      unMaxArgs - Size of pArgs.
+   //
+   // Out:  Number of arguments decoded.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned int CATLogBinary::DecodeArgs(const char* pData, unsigned int unLength, SATFormatArg* pArgs, unsigned int unMaxArgs)
+   {
+      unsigned int unCount = 0;
+      unsigned int unUsed = 0;
+      while (unUsed < unLength && unCount < unMaxArgs)
+      {
+         SATFormatArg& Arg = pArgs[unCount];
+         Arg.m_ucType = static_cast<unsigned char>(pData[unUsed++]);
+         Arg.m_ucKeyLength = 0;
+         Arg.m_usFormatter = 0;
+         Arg.m_unLength = 0;
+         Arg.m_pKey = 0;
+
+         //A field's name, its value follows.
+         if (Arg.m_ucType == ARG_KEY)
+         {
+            if (unUsed >= unLength || static_cast<unsigned char>(pData[unUsed]) > unLength - unUsed - 1)
+               return unCount;
+            Arg.m_ucKeyLength = static_cast<unsigned char>(pData[unUsed++]);
+            Arg.m_pKey = pData + unUsed;
+            unUsed += Arg.m_ucKeyLength;
+            if (unUsed >= unLength)
+               return unCount;
+            Arg.m_ucType = static_cast<unsigned char>(pData[unUsed++]);
+         }
+
+         unsigned int unRoom = unLength - unUsed;
+
+         switch (Arg.m_ucType)
+         {
+            case ARG_CHAR:
+            case ARG_BOOL:
+            {
+               if (unRoom < 1)
+                  return unCount;
+               if (Arg.m_ucType == ARG_CHAR)
+                  Arg.m_cValue = pData[unUsed];
+               else
+                  Arg.m_bValue = (pData[unUsed] != 0);
+               unUsed++;
+               break;
+            }
+            case ARG_STRING:
+            {
+               unsigned short usLength = 0;
+               if (unRoom < sizeof(usLength))
+                  return unCount;
+               memcpy(&usLength, pData + unUsed, sizeof(usLength));
+               unUsed += sizeof(usLength);
+               if (usLength > unLength - unUsed)
+                  return unCount;
+
+               Arg.m_pString = pData + unUsed;
+               Arg.m_unLength = usLength;
+               unUsed += usLength;
+               break;
+            }
+            case ARG_USER:
+            {
+               if (unRoom < 2 || static_cast<unsigned char>(pData[unUsed]) > unRoom - 2)
+                  return unCount;
+               unsigned int unTagLength = static_cast<unsigned char>(pData[unUsed++]);
+               Arg.m_usFormatter = CATTypeFormatters::Find(pData + unUsed, unTagLength);
+               unUsed += unTagLength;
+
+               Arg.m_unLength = static_cast<unsigned char>(pData[unUsed++]);
+               if (Arg.m_unLength > unLength - unUsed)
+                  return unCount;
+               Arg.m_pPointer = pData + unUsed;
+               unUsed += Arg.m_unLength;
+               break;
+            }
+            case ARG_SIGNED:
+            case ARG_UNSIGNED:
+            case ARG_FLOAT:
+            case ARG_POINTER:
+            {
+               if (unRoom < 8)
+                  return unCount;
+               memcpy(&Arg.m_ullValue, pData + unUsed, 8);
+               unUsed += 8;
+               break;
+            }
+            default:  //Garbage, stop here.
+               return unCount;
+         }
+
+         unCount++;
+      }
+      return unCount;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  FillRecord
+   //
+   // Purpose:  Fills in a record for a message.  Formats that can't be given an id (not a string literal, or the
+   //           registry is full) are formatted right here and stored as a single string argument, followed by
+   //           the message's fields.
+   //
+   // In:  Record - The record to fill in.
+   //      ucLevel - eLevel of the message.
+   //      unChannel - CATLogChannels id of the message.
+   //      ullTimestamp - When the message was logged.
+   //      pFormat - The message's format.
+   //      bLiteral - Is pFormat a string literal?
+   //      pArgs - The arguments.
+   //      unArgCount - Number of arguments.
+   //      unCapacity - Room for arguments from Record.m_cData on, bigger than m_cData for a SATLogLargeRecord.
+   //
+   // Out:  true if the whole message fit, false if anything was truncated or left out.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATLogBinary::FillRecord(SATLogRecord& Record, unsigned char ucLevel, unsigned int unChannel, unsigned long long ullTimestamp,
+      const char* pFormat, bool bLiteral, const SATFormatArg* pArgs, unsigned int unArgCount, unsigned int unCapacity)
+   {
+      Record.m_ullTimestamp = ullTimestamp;
+      Record.m_ucLevel = ucLevel;
+      Record.m_ucChannel = static_cast<unsigned char>(unChannel);
+      Record.m_unFormatId = bLiteral ? CATFormatRegistry::Register(pFormat) : static_cast<unsigned int>(CATFormatRegistry::PREFORMATTED_ID);
+
+      unsigned int unEncoded = 0;
+      bool bCut = false;
+      if (Record.m_unFormatId != CATFormatRegistry::PREFORMATTED_ID)
+      {
+         Record.m_usLength = static_cast<unsigned short>(EncodeArgs(Record.m_cData, unCapacity, pArgs, unArgCount, unEncoded, &bCut));
+         Record.m_ucArgCount = static_cast<unsigned char>(unEncoded);
+         return !bCut && unEncoded == unArgCount;
+      }
+
+      //No id for this one, build the text now and send it along as a plain string.
+      static thread_local CATLineBuffer s_lbMessage;
+      CATFormatBuffer fbMessage = s_lbMessage.Begin();
+      CATFormatter::BuildMessage(fbMessage, pFormat, pArgs, unArgCount);
+      while (s_lbMessage.Grow(fbMessage))
+      {
+         fbMessage = s_lbMessage.Begin();
+         CATFormatter::BuildMessage(fbMessage, pFormat, pArgs, unArgCount);
+      }
+      if (fbMessage.IsTruncated())
+      {
+         fbMessage.MarkTruncated();
+         bCut = true;
+      }
+
+      SATFormatArg Message;
+      Message.m_ucType = ARG_STRING;
+      Message.m_ucKeyLength = 0;
+      Message.m_usFormatter = 0;
+      Message.m_pString = fbMessage.Data();
+      Message.m_unLength = fbMessage.Length();
+      Message.m_pKey = 0;
+
+      Record.m_usLength = static_cast<unsigned short>(EncodeArgs(Record.m_cData, unCapacity, &Message, 1, unEncoded, &bCut));
+      Record.m_ucArgCount = static_cast<unsigned char>(unEncoded);
+      bool bFit = (unEncoded == 1);
+
+      //The fields still go along as they are.
+      for (unsigned int i = 0; i < unArgCount; i++)
+      {
+         if (!pArgs[i].m_pKey)
+            continue;
+         if (!bFit)
+            return false;
+         Record.m_usLength = static_cast<unsigned short>(Record.m_usLength + EncodeArgs(Record.m_cData + Record.m_usLength,
+            unCapacity - Record.m_usLength, pArgs + i, 1, unEncoded, &bCut));
+         Record.m_ucArgCount = static_cast<unsigned char>(Record.m_ucArgCount + unEncoded);
+         bFit = (unEncoded == 1);
+      }
+      return bFit && !bCut;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  FitRecord
+   //
+   // Purpose:  Cuts a record from a SATLogLargeRecord down to one that fits in a SATLogRecord, for outputs that
+   //           store or send records as they are (BINARY and INDEXED files, CATSocketSink).
+   //
+   // In:  Record - The record, its arguments possibly running past m_cData.
+   //      Fitted - Receives the cut down record.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogBinary::FitRecord(const SATLogRecord& Record, SATLogRecord& Fitted)
+   {
+      SATFormatArg aArgs[AT_LOG_MAX_ARGS];
+      unsigned int unArgCount = DecodeArgs(Record.m_cData, Record.m_usLength, aArgs, AT_LOG_MAX_ARGS);
+
+      unsigned int unEncoded = 0;
+      memcpy(&Fitted, &Record, offsetof(SATLogRecord, m_cData));
+      Fitted.m_usLength = static_cast<unsigned short>(EncodeArgs(Fitted.m_cData, sizeof(Fitted.m_cData), aArgs, unArgCount, unEncoded));
+      Fitted.m_ucArgCount = static_cast<unsigned char>(unEncoded);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  FormatRecord
+   //
+   // Purpose:  Builds a record's text the same way CATLogger::buildMessage would have.  Messages on any channel
+   //           but the general one get the channel's name in square brackets up front, fields go on the end.
+   //
+   // In:  fbOut - Where the text is going.
+   //      pFormat - The record's format.
+   //      pChannel - Name of the record's channel.
+   //      Record - The record.
+   //      bTimestamp - Start the message off with its time stamp?
+   //      unDigits - Digits after the seconds in the time stamp.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogBinary::FormatRecord(CATFormatBuffer& fbOut, const char* pFormat, const char* pChannel, const SATLogRecord& Record,
+      bool bTimestamp, unsigned int unDigits)
+   {
+      SATFormatArg aArgs[AT_LOG_MAX_ARGS];
+      unsigned int unArgCount = DecodeArgs(Record.m_cData, Record.m_usLength, aArgs, AT_LOG_MAX_ARGS);
+
+      AppendPrefix(fbOut, pChannel, Record, bTimestamp, unDigits);
+      CATFormatter::BuildMessage(fbOut, pFormat, aArgs, unArgCount);
+      CATFormatter::AppendFields(fbOut, aArgs, unArgCount);
+   }
+
+   //Same as above with the record's format already compiled, what the sinks use (see CATFormatRegistry::GetTemplate).
+   void CATLogBinary::FormatRecord(CATFormatBuffer& fbOut, const SATFormatTemplate& Template, const char* pChannel, const SATLogRecord& Record,
+      bool bTimestamp, unsigned int unDigits)
+   {
+      SATFormatArg aArgs[AT_LOG_MAX_ARGS];
+      unsigned int unArgCount = DecodeArgs(Record.m_cData, Record.m_usLength, aArgs, AT_LOG_MAX_ARGS);
+
+      AppendPrefix(fbOut, pChannel, Record, bTimestamp, unDigits);
+      CATFormatter::BuildMessage(fbOut, Template, aArgs, unArgCount);
+      CATFormatter::AppendFields(fbOut, aArgs, unArgCount);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  EstimateLength
+   //
+   // Purpose:  Guesses how long FormatRecord's text for a record will be, from its compiled format and the size
+   //           of its arguments, so the line buffer can be made big enough before the first try.
+   //
+   // In:  Template - The record's format compiled.
+   //      Record - The record.
+   //
+   // Out:  Roughly the length of the line, on the generous side.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned int CATLogBinary::EstimateLength(const SATFormatTemplate& Template, const SATLogRecord& Record)
+   {
+      //The encoded arguments cover strings byte for byte, a number is never wider than 24 characters written out
+      //(padding aside), and the time stamp, level and channel name fit in 64.
+      return Template.m_unLiteralLength + Template.m_unPlaceholders * 24 + Record.m_usLength + 64;
+   }
+
+   //Writes out what goes in front of a record's message, its time stamp and the channel's name in square brackets.
+   void CATLogBinary::AppendPrefix(CATFormatBuffer& fbOut, const char* pChannel, const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits)
+   {
+      if (bTimestamp)
+         CATFormatter::AppendTimestamp(fbOut, Record.m_ullTimestamp, unDigits);
+
+      if (Record.m_ucChannel != CATLogChannels::CHANNEL_GENERAL && pChannel && *pChannel)
+      {
+         fbOut.Append('[');
+         fbOut.Append(pChannel, static_cast<unsigned int>(strlen(pChannel)));
+         fbOut.Append("] ", 2);
+      }
+   }
+
+   //Writes the file header, returns HEADER_SIZE.
+   unsigned int CATLogBinary::WriteHeader(char* pOut, unsigned short usFlags)
+   {
+      unsigned short usVersion = AT_LOG_BINARY_VERSION;
+      memcpy(pOut, AT_LOG_BINARY_MAGIC, 4);
+      memcpy(pOut + 4, &usVersion, 2);
+      memcpy(pOut + 6, &usFlags, 2);
+      return HEADER_SIZE;
+   }
+
+   //Checks the file header and grabs its flags.
+   bool CATLogBinary::ReadHeader(const char* pData, unsigned short& usFlags)
+   {
+      unsigned short usVersion = 0;
+      if (memcmp(pData, AT_LOG_BINARY_MAGIC, 4) != 0)
+         return false;
+
+      memcpy(&usVersion, pData + 4, 2);
+      memcpy(&usFlags, pData + 6, 2);
+      return usVersion == AT_LOG_BINARY_VERSION;
+   }
+
+   //Writes everything but the data, returns RECORD_HEADER_SIZE.
+   unsigned int CATLogBinary::WriteRecordHeader(char* pOut, const SATLogRecord& Record)
+   {
+      pOut[0] = ENTRY_RECORD;
+      memcpy(pOut + 1, &Record.m_ullTimestamp, 8);
+      memcpy(pOut + 9, &Record.m_unFormatId, 4);
+      memcpy(pOut + 13, &Record.m_usLength, 2);
+      pOut[15] = static_cast<char>(Record.m_ucLevel);
+      pOut[16] = static_cast<char>(Record.m_ucArgCount);
+      pOut[17] = static_cast<char>(Record.m_ucChannel);
+      return RECORD_HEADER_SIZE;
+   }
+
+   //Reads everything but the tag and the data.
+   void CATLogBinary::ReadRecordHeader(const char* pData, SATLogRecord& Record)
+   {
+      memcpy(&Record.m_ullTimestamp, pData + 1, 8);
+      memcpy(&Record.m_unFormatId, pData + 9, 4);
+      memcpy(&Record.m_usLength, pData + 13, 2);
+      Record.m_ucLevel = static_cast<unsigned char>(pData[15]);
+      Record.m_ucArgCount = static_cast<unsigned char>(pData[16]);
+      Record.m_ucChannel = static_cast<unsigned char>(pData[17]);
+   }
+
+   //Checks the tag and reads the rest, see SATLogBlock.
+   bool CATLogBinary::ReadBlockHeader(const char* pData, SATLogBlock& Block)
+   {
+      if (pData[0] != ENTRY_BLOCK)
+         return false;
+
+      memcpy(&Block.m_unLength, pData + 1, 4);
+      memcpy(&Block.m_unCount, pData + 5, 4);
+      memcpy(&Block.m_ullFirst, pData + 9, 8);
+      memcpy(&Block.m_ullLast, pData + 17, 8);
+      Block.m_ucLevels = static_cast<unsigned char>(pData[25]);
+      return true;
+   }
+
+   //Writes the file header, call right after the file is opened.  FILE_INDEXED in usFlags starts gathering blocks.
+   void CATBinaryWriter::Begin(unsigned short usFlags)
+   {
+      char cHeader[CATLogBinary::HEADER_SIZE];
+      memset(m_aucDefined, 0, sizeof(m_aucDefined));
+      memset(m_aucChannels, 0, sizeof(m_aucChannels));
+      m_pOutput->Write(cHeader, CATLogBinary::WriteHeader(cHeader, usFlags));
+
+      if ((usFlags & CATLogBinary::FILE_INDEXED) && !m_pBlock)
+         m_pBlock = new char[CATLogBinary::BLOCK_HEADER_SIZE + AT_LOG_BLOCK_SIZE];
+      else if (!(usFlags & CATLogBinary::FILE_INDEXED))
+      {
+         delete[] m_pBlock;
+         m_pBlock = 0;
+      }
+      m_unBlockUsed = 0;
+      memset(&m_Block, 0, sizeof(m_Block));
+   }
+
+   //Adds bytes to the block, or straight to the file without one.
+   void CATBinaryWriter::Put(const char* pData, unsigned int unLength)
+   {
+      if (m_pBlock)
+      {
+         memcpy(m_pBlock + CATLogBinary::BLOCK_HEADER_SIZE + m_unBlockUsed, pData, unLength);
+         m_unBlockUsed += unLength;
+      }
+      else
+         m_pOutput->Write(pData, unLength);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Write
+   //
+   // Purpose:  Writes a record, preceded by its format and channel if this file hasn't had them yet.  In a
+   //           FILE_INDEXED file the record goes into the current block, which is written out first if the
+   //           record won't fit.
+   //
+   // In:  Record - The record, its time stamp already in nanoseconds since the epoch.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATBinaryWriter::Write(const SATLogRecord& Record)
+   {
+      //Records from sinks without a thread can be bigger than ATLogDecode and the rest will read, cut those down first.
+      if (Record.m_usLength > sizeof(Record.m_cData))
+      {
+         SATLogRecord Fitted;
+         CATLogBinary::FitRecord(Record, Fitted);
+         this->Write(Fitted);
+         return;
+      }
+
+      unsigned int unChannel = Record.m_ucChannel;
+      unsigned int unId = Record.m_unFormatId;
+      bool bChannel = unChannel < AT_LOG_MAX_CHANNELS && !(m_aucChannels[unChannel / 8] & (1 << (unChannel % 8)));
+      bool bFormat = unId < AT_LOG_MAX_FORMATS && !(m_aucDefined[unId / 8] & (1 << (unId % 8)));
+      const char* pFormat = bFormat ? CATFormatRegistry::GetFormat(unId) : 0;
+      size_t unFormatLength = pFormat ? strlen(pFormat) : 0;
+
+      //Blocks have to stand on their own, so a record that spills over starts a new one and defines everything again.
+      //Formats are cut down to a quarter of a block there so the worst case still fits in an empty one.
+      if (m_pBlock)
+      {
+         if (unFormatLength > AT_LOG_BLOCK_SIZE / 4)
+            unFormatLength = AT_LOG_BLOCK_SIZE / 4;
+
+         size_t unNeeded = CATLogBinary::RECORD_HEADER_SIZE + Record.m_usLength + (bChannel ? CATLogBinary::CHANNEL_HEADER_SIZE + 255 : 0) +
+            (bFormat ? CATLogBinary::FORMAT_HEADER_SIZE + unFormatLength : 0);
+         if (m_Block.m_unCount > 0 && m_unBlockUsed + unNeeded > AT_LOG_BLOCK_SIZE)
+         {
+            this->EndBlock();
+            bChannel = unChannel < AT_LOG_MAX_CHANNELS;
+            if (!bFormat && unId < AT_LOG_MAX_FORMATS)
+            {
+               bFormat = true;
+               pFormat = CATFormatRegistry::GetFormat(unId);
+               unFormatLength = strlen(pFormat);
+               if (unFormatLength > AT_LOG_BLOCK_SIZE / 4)
+                  unFormatLength = AT_LOG_BLOCK_SIZE / 4;
+            }
+         }
+      }
+
+      if (bChannel)
+      {
+         const char* pName = CATLogChannels::GetName(unChannel);
+         unsigned char ucLength = static_cast<unsigned char>(strlen(pName));
+
+         char cHeader[CATLogBinary::CHANNEL_HEADER_SIZE];
+         cHeader[0] = CATLogBinary::ENTRY_CHANNEL;
+         cHeader[1] = static_cast<char>(unChannel);
+         cHeader[2] = static_cast<char>(ucLength);
+         this->Put(cHeader, sizeof(cHeader));
+         this->Put(pName, ucLength);
+
+         m_aucChannels[unChannel / 8] |= static_cast<unsigned char>(1 << (unChannel % 8));
+      }
+
+      if (bFormat)
+      {
+         unsigned short usLength = static_cast<unsigned short>((unFormatLength < 0xFFFF) ? unFormatLength : 0xFFFF);
+
+         char cHeader[CATLogBinary::FORMAT_HEADER_SIZE];
+         cHeader[0] = CATLogBinary::ENTRY_FORMAT;
+         memcpy(cHeader + 1, &unId, 4);
+         memcpy(cHeader + 5, &usLength, 2);
+         this->Put(cHeader, sizeof(cHeader));
+         this->Put(pFormat, usLength);
+
+         m_aucDefined[unId / 8] |= static_cast<unsigned char>(1 << (unId % 8));
+      }
+
+      char cHeader[CATLogBinary::RECORD_HEADER_SIZE];
+      this->Put(cHeader, CATLogBinary::WriteRecordHeader(cHeader, Record));
+      this->Put(Record.m_cData, Record.m_usLength);
+
+      //Keep the block's index up to date.
+      if (m_pBlock)
+      {
+         if (m_Block.m_unCount == 0)
+         {
+            m_Block.m_ullFirst = m_Block.m_ullLast = Record.m_ullTimestamp;
+            m_tpBlockStarted = std::chrono::steady_clock::now();
+         }
+         else if (Record.m_ullTimestamp < m_Block.m_ullFirst)
+            m_Block.m_ullFirst = Record.m_ullTimestamp;
+         else if (Record.m_ullTimestamp > m_Block.m_ullLast)
+            m_Block.m_ullLast = Record.m_ullTimestamp;
+
+         m_Block.m_unCount++;
+         if (Record.m_ucLevel < 8)
+            m_Block.m_ucLevels |= static_cast<unsigned char>(1 << Record.m_ucLevel);
+      }
+   }
+
+   //Writes the current block out to the file in a single Write, if there is one.  Call before flushing or closing the file.
+   void CATBinaryWriter::EndBlock()
+   {
+      if (!m_pBlock || m_Block.m_unCount == 0)
+         return;
+
+      //The header goes in the room left for it up front, so the block goes out in a single write.
+      char* pHeader = m_pBlock;
+      pHeader[0] = CATLogBinary::ENTRY_BLOCK;
+      memcpy(pHeader + 1, &m_unBlockUsed, 4);
+      memcpy(pHeader + 5, &m_Block.m_unCount, 4);
+      memcpy(pHeader + 9, &m_Block.m_ullFirst, 8);
+      memcpy(pHeader + 17, &m_Block.m_ullLast, 8);
+      pHeader[25] = static_cast<char>(m_Block.m_ucLevels);
+      m_pOutput->Write(m_pBlock, CATLogBinary::BLOCK_HEADER_SIZE + m_unBlockUsed);
+
+      //The next block defines everything it uses all over again.
+      memset(m_aucDefined, 0, sizeof(m_aucDefined));
+      memset(m_aucChannels, 0, sizeof(m_aucChannels));
+      m_unBlockUsed = 0;
+      memset(&m_Block, 0, sizeof(m_Block));
+   }
+
+   //Writes the current block out if it's been held back for AT_LOG_BLOCK_INTERVAL or more.
+   void CATBinaryWriter::EndBlockIfDue()
+   {
+      if (m_pBlock && m_Block.m_unCount > 0 &&
+         std::chrono::steady_clock::now() - m_tpBlockStarted >= std::chrono::milliseconds(AT_LOG_BLOCK_INTERVAL))
+         this->EndBlock();
+   }
+}
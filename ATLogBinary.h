@@ -0,0 +1,304 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogBinary.h
+//
+// Purpose: The Logger's binary format.  A binary message is just its format id, time stamp and raw argument bytes, the
+//          text is only built later by the ATLogDecode tool.  Also home to the registry handing out format ids and
+//          keeping each one's compiled format.
+//
+//          File layout (native byte order):
+//             Header:  "ATLB"  u16 version  u16 flags (eFileFlags)
+//             Format:  'F'  u32 id  u16 length  char[length]              (written before the first record using it)
+//             Channel: 'C'  u8 id  u8 length  char[length]                (written before the first record using it)
+//             Record:  'R'  u64 timestamp  u32 format id  u16 length  u8 level  u8 arg count  u8 channel  char[length]
+//             Block:   'B'  u32 length  u32 record count  u64 first timestamp  u64 last timestamp  u8 level mask
+//                      followed by length bytes of F, C and R entries    (FILE_INDEXED files only)
+//             Source:  'S'  u8 length  char[length]                     (right after the header, socket streams only)
+//
+//          FILE_INDEXED files hold nothing but blocks after the header.  Every block defines the formats and channels
+//          its own records use, so a reader (e.g. ATLogQuery) can hop from block header to block header, skip whatever
+//          falls outside the time range or levels it's after, and decode the rest on their own in any order.  A
+//          CATSocketSink sends the same FILE_INDEXED stream to ATLogCollector, naming the process it comes from first.
+//
+//          Arguments are encoded back to back as a u8 eArgType followed by 8 bytes for numbers and pointers, 1 byte for
+//          char and bool, a u16 length and the characters for strings, or a u8 tag length, the tag, a u8 size and the
+//          value's bytes for types with their own placeholder.  A field's value is preceded by its name, a u8 ARG_KEY, a
+//          u8 length and the characters.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "ATLogFormat.h"
+#include "ATLogRecord.h"
+#include "ATFileWriter.h"
+#include "ATLogChannel.h"
+
+//Most distinct string literal formats that can be given ids, anything past this is formatted on the calling thread.
+#ifndef AT_LOG_MAX_FORMATS
+#define AT_LOG_MAX_FORMATS 4096
+#endif
+
+//Bytes of entries gathered up before a block is written out in a FILE_INDEXED file.
+#ifndef AT_LOG_BLOCK_SIZE
+#define AT_LOG_BLOCK_SIZE 65536
+#endif
+
+//Longest a block is held back before being written out anyway, in milliseconds.
+#ifndef AT_LOG_BLOCK_INTERVAL
+#define AT_LOG_BLOCK_INTERVAL 1000
+#endif
+
+#define AT_LOG_BINARY_MAGIC "ATLB"
+#define AT_LOG_BINARY_VERSION 2
+
+namespace Atlas
+{
+   //Hands out ids for string literal formats.  Lookups are lock-free, only the first use of a format takes a lock.
+   class CATFormatRegistry
+   {
+      private:
+         static std::atomic<const char*>  m_apKeys[AT_LOG_MAX_FORMATS * 2];  //Open addressed table of registered formats.
+         static unsigned int              m_aunIds[AT_LOG_MAX_FORMATS * 2];  //Id of each entry in m_apKeys.
+         static std::atomic<const char*>  m_apFormats[AT_LOG_MAX_FORMATS];  //Format of each id.
+         static std::atomic<SATFormatTemplate*> m_apTemplates[AT_LOG_MAX_FORMATS];  //Each id's format compiled, once it's been used.
+         static std::atomic<unsigned int> m_unCount;  //Number of ids handed out, id 0 included.
+         static std::mutex                m_mtxInsert;  //Held while adding a new format.
+
+      public:
+
+         //Id 0 is always "{s}", a message that was formatted before it was logged.
+         enum { PREFORMATTED_ID = 0 };
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Register
+         //
+         // Purpose:  Returns the id of a string literal format, handing out a new one the first time it's seen.
+         //
+         // In:  pFormat - The format, must stay around for the life of the program.
+         //
+         // Out:  The id, PREFORMATTED_ID if the registry is full.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned int Register(const char* pFormat);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  GetFormat
+         //
+         // Purpose:  Returns the format for a given id.
+         //
+         // In:  unId - The id handed out by Register.
+         //
+         // Out:  The format, "{s}" for an unknown id.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static const char* GetFormat(unsigned int unId);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  GetTemplate
+         //
+         // Purpose:  Returns the compiled format for a given id, compiling it the first time it's asked for.  Every
+         //           message from the same call site shares it from then on, so its format is only ever scanned once.
+         //
+         // In:  unId - The id handed out by Register.
+         //
+         // Out:  The template, "{s}" compiled for an unknown id.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static const SATFormatTemplate& GetTemplate(unsigned int unId);
+   };
+
+   //A block's index, what's at the front of every block in a FILE_INDEXED file.
+   struct SATLogBlock
+   {
+      unsigned int         m_unLength;  //Bytes of entries following the block header.
+      unsigned int         m_unCount;  //Number of records in the block.
+      unsigned long long   m_ullFirst;  //Earliest record's time stamp.
+      unsigned long long   m_ullLast;  //Latest record's time stamp.
+      unsigned char        m_ucLevels;  //Bit per eLevel found in the block.
+   };
+
+   class CATLogBinary
+   {
+      private:
+         //Writes out what goes in front of a record's message, its time stamp and the channel's name in square brackets.
+         static void AppendPrefix(CATFormatBuffer& fbOut, const char* pChannel, const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits);
+
+      public:
+
+         //Entry tags in a binary Log file.
+         enum eEntry {ENTRY_FORMAT = 'F', ENTRY_CHANNEL = 'C', ENTRY_RECORD = 'R', ENTRY_BLOCK = 'B', ENTRY_SOURCE = 'S'};
+
+         //Sizes of the fixed parts of a binary Log file.
+         enum eSizes {HEADER_SIZE = 8, FORMAT_HEADER_SIZE = 7, CHANNEL_HEADER_SIZE = 3, RECORD_HEADER_SIZE = 18, BLOCK_HEADER_SIZE = 26, SOURCE_HEADER_SIZE = 2};
+
+         //Flags stored in the file header.
+         //FILE_TIMESTAMP - Text built from this file should start with time stamps.
+         //FILE_INDEXED - Entries are grouped into self-contained blocks, each with its own small index.
+         //FILE_DIGITS - Digits after the seconds in those time stamps, stored shifted up by FILE_DIGITS_SHIFT.
+         enum eFileFlags {FILE_TIMESTAMP = 1, FILE_INDEXED = 2, FILE_DIGITS = 0x0F00, FILE_DIGITS_SHIFT = 8};
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  EncodeArgs
+         //
+         // Purpose:  Copies the arguments' raw bytes into a buffer, strings are truncated to fit and end in
+         //           AT_LOG_TRUNCATED.  Stops at the first argument that doesn't fit at all, a field's name and value go
+         //           in together or not at all.
+         //
+         // In:  pOut - Where the bytes are going.
+         //      unSize - Size of pOut.
+         //      pArgs - The arguments.
+         //      unArgCount - Number of arguments.
+         //      unEncoded - Receives the number of arguments that were encoded.
+         //      pCut - Set to true if a string had to be truncated, left alone otherwise.
+         //
+         // Out:  Number of bytes used.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned int EncodeArgs(char* pOut, unsigned int unSize, const SATFormatArg* pArgs, unsigned int unArgCount, unsigned int& unEncoded,
+            bool* pCut = 0);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  DecodeArgs
+         //
+         // Purpose:  Turns bytes written by EncodeArgs back into arguments.  Strings and field names point into pData.
+         //
+         // In:  pData - The encoded arguments.
+         //      unLength - Number of bytes in pData.
+         //      pArgs - Where the arguments are going.
+         //      unMaxArgs - Size of pArgs.
+         //
+         // Out:  Number of arguments decoded.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned int DecodeArgs(const char* pData, unsigned int unLength, SATFormatArg* pArgs, unsigned int unMaxArgs);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  FillRecord
+         //
+         // Purpose:  Fills in a record for a message.  Formats that can't be given an id (not a string literal, or the
+         //           registry is full) are formatted right here and stored as a single string argument, followed by
+         //           the message's fields.
+         //
+         // In:  Record - The record to fill in.
+         //      ucLevel - eLevel of the message.
+         //      unChannel - CATLogChannels id of the message.
+         //      ullTimestamp - When the message was logged.
+         //      pFormat - The message's format.
+         //      bLiteral - Is pFormat a string literal?
+         //      pArgs - The arguments.
+         //      unArgCount - Number of arguments.
+         //      unCapacity - Room for arguments from Record.m_cData on, bigger than m_cData for a SATLogLargeRecord.
+         //
+         // Out:  true if the whole message fit, false if anything was truncated or left out.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static bool FillRecord(SATLogRecord& Record, unsigned char ucLevel, unsigned int unChannel, unsigned long long ullTimestamp,
+            const char* pFormat, bool bLiteral, const SATFormatArg* pArgs, unsigned int unArgCount,
+            unsigned int unCapacity = sizeof(SATLogRecord::m_cData));
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  FitRecord
+         //
+         // Purpose:  Cuts a record from a SATLogLargeRecord down to one that fits in a SATLogRecord, for outputs that
+         //           store or send records as they are (BINARY and INDEXED files, CATSocketSink).
+         //
+         // In:  Record - The record, its arguments possibly running past m_cData.
+         //      Fitted - Receives the cut down record.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void FitRecord(const SATLogRecord& Record, SATLogRecord& Fitted);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  FormatRecord
+         //
+         // Purpose:  Builds a record's text the same way CATLogger::buildMessage would have.  Messages on any channel
+         //           but the general one get the channel's name in square brackets up front, fields go on the end.
+         //
+         // In:  fbOut - Where the text is going.
+         //      pFormat - The record's format.
+         //      pChannel - Name of the record's channel.
+         //      Record - The record.
+         //      bTimestamp - Start the message off with its time stamp?
+         //      unDigits - Digits after the seconds in the time stamp.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void FormatRecord(CATFormatBuffer& fbOut, const char* pFormat, const char* pChannel, const SATLogRecord& Record,
+            bool bTimestamp, unsigned int unDigits);
+
+         //Same as above with the record's format already compiled, what the sinks use (see CATFormatRegistry::GetTemplate).
+         static void FormatRecord(CATFormatBuffer& fbOut, const SATFormatTemplate& Template, const char* pChannel, const SATLogRecord& Record,
+            bool bTimestamp, unsigned int unDigits);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  EstimateLength
+         //
+         // Purpose:  Guesses how long FormatRecord's text for a record will be, from its compiled format and the size
+         //           of its arguments, so the line buffer can be made big enough before the first try.
+         //
+         // In:  Template - The record's format compiled.
+         //      Record - The record.
+         //
+         // Out:  Roughly the length of the line, on the generous side.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned int EstimateLength(const SATFormatTemplate& Template, const SATLogRecord& Record);
+
+         static unsigned int WriteHeader(char* pOut, unsigned short usFlags);  //Writes the file header, returns HEADER_SIZE.
+         static bool ReadHeader(const char* pData, unsigned short& usFlags);  //Checks the file header and grabs its flags.
+         static unsigned int WriteRecordHeader(char* pOut, const SATLogRecord& Record);  //Returns RECORD_HEADER_SIZE.
+         static void ReadRecordHeader(const char* pData, SATLogRecord& Record);  //Reads everything but the tag and the data.
+         static bool ReadBlockHeader(const char* pData, SATLogBlock& Block);  //Checks the tag and reads the rest, see SATLogBlock.
+   };
+
+   //Writes records to a file (or any CATByteOutput) in the binary format, defining each format and channel the first
+   //time the file (or in a FILE_INDEXED file, the block) sees it.
+   class CATBinaryWriter
+   {
+      private:
+         static_assert(AT_LOG_BLOCK_SIZE >= 16384, "AT_LOG_BLOCK_SIZE has to leave room for a record and its definitions");
+
+         CATByteOutput*    m_pOutput;  //The file (or socket) being written to.
+         unsigned char     m_aucDefined[AT_LOG_MAX_FORMATS / 8];  //Bit per format id, set once it's been written.
+         unsigned char     m_aucChannels[(AT_LOG_MAX_CHANNELS + 7) / 8];  //Bit per channel, set once it's been written.
+
+         char*             m_pBlock;  //Block being gathered up behind room for its header, 0 unless the file is FILE_INDEXED.
+         unsigned int      m_unBlockUsed;  //Bytes used in m_pBlock.
+         SATLogBlock       m_Block;  //Index of the block being gathered up.
+         std::chrono::steady_clock::time_point m_tpBlockStarted;  //When the block's first record went in.
+
+         CATBinaryWriter(const CATBinaryWriter&);  //Copy Constructor
+         CATBinaryWriter& operator=(const CATBinaryWriter&);  //Assignment Operator
+
+         void Put(const char* pData, unsigned int unLength);  //Adds bytes to the block, or straight to the file without one.
+
+      public:
+         CATBinaryWriter(CATByteOutput* pOutput) : m_pOutput(pOutput), m_pBlock(0), m_unBlockUsed(0)
+         {
+            memset(m_aucDefined, 0, sizeof(m_aucDefined));
+            memset(m_aucChannels, 0, sizeof(m_aucChannels));
+            memset(&m_Block, 0, sizeof(m_Block));
+         }
+
+         ~CATBinaryWriter() { delete[] m_pBlock; }  //Destructor, call EndBlock first or the last block is lost.
+
+         //Writes the file header, call right after the file is opened.  FILE_INDEXED in usFlags starts gathering blocks.
+         void Begin(unsigned short usFlags);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Write
+         //
+         // Purpose:  Writes a record, preceded by its format and channel if this file hasn't had them yet.  In a
+         //           FILE_INDEXED file the record goes into the current block, which is written out first if the
+         //           record won't fit.
+         //
+         // In:  Record - The record, its time stamp already in nanoseconds since the epoch.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Write(const SATLogRecord& Record);
+
+         //Writes the current block out to the file in a single Write, if there is one.  Call before flushing or closing the file.
+         void EndBlock();
+
+         //Writes the current block out if it's been held back for AT_LOG_BLOCK_INTERVAL or more.
+         void EndBlockIfDue();
+
+         unsigned int GetBlockCount() const { return m_Block.m_unCount; }  //Number of records in the block being gathered up.
+   };
+}
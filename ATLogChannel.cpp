@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogChannel.cpp
+//
+// Purpose: Named Log channels, each with its own level mask.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogChannel.h"
+#include <cstring>
+
+//Every level on, matches CATLogger::LevelMask(eLevel::ALL).
+#define ALL_LEVELS 0x0F
+
+namespace Atlas
+{
+   std::atomic<unsigned char>   CATLogChannels::m_aucMasks[AT_LOG_MAX_CHANNELS] = {ALL_LEVELS, ALL_LEVELS, ALL_LEVELS, ALL_LEVELS, ALL_LEVELS};
+   char                         CATLogChannels::m_acNames[AT_LOG_MAX_CHANNELS][AT_LOG_CHANNEL_NAME] = {"general", "render", "physics", "net", "audio"};
+   std::atomic<unsigned int>    CATLogChannels::m_unCount(CHANNEL_BUILTIN_COUNT);
+   std::mutex                   CATLogChannels::m_mtxRegister;
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Register
+   //
+   // Purpose:  Adds a channel, or returns the existing one if a channel already has that name.
+   //
+   // In:  pName - Name of the channel e.g. "ai".
+   //      ucMask - Level mask the channel starts out with (CATLogger::LevelMask).
+   //
+   // Out:  The channel's id, INVALID_CHANNEL if there's no room for more channels.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned int CATLogChannels::Register(const char* pName, unsigned char ucMask)
+   {
+      std::lock_guard<std::mutex> lgRegister(m_mtxRegister);
+
+      unsigned int unChannel = Find(pName);
+      if (unChannel != INVALID_CHANNEL)
+         return unChannel;
+
+      unChannel = m_unCount.load(std::memory_order_relaxed);
+      if (unChannel >= AT_LOG_MAX_CHANNELS)
+         return INVALID_CHANNEL;
+
+      strncpy(m_acNames[unChannel], pName, AT_LOG_CHANNEL_NAME - 1);
+      m_acNames[unChannel][AT_LOG_CHANNEL_NAME - 1] = '\0';
+      m_aucMasks[unChannel].store(ucMask, std::memory_order_relaxed);
+
+      m_unCount.store(unChannel + 1, std::memory_order_release);  //Publish it once it's all filled in.
+      return unChannel;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Find
+   //
+   // Purpose:  Looks a channel up by name.
+   //
+   // In:  pName - Name of the channel.
+   //
+   // Out:  The channel's id, INVALID_CHANNEL if there's no such channel.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned int CATLogChannels::Find(const char* pName)
+   {
+      unsigned int unCount = Count();
+      for (unsigned int i = 0; i < unCount; i++)
+      {
+         if (strncmp(m_acNames[i], pName, AT_LOG_CHANNEL_NAME - 1) == 0)
+            return i;
+      }
+      return INVALID_CHANNEL;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  GetName
+   //
+   // Purpose:  Returns the name of a channel.
+   //
+   // In:  unChannel - The channel's id.
+   //
+   // Out:  The name, "" for an unknown channel.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   const char* CATLogChannels::GetName(unsigned int unChannel)
+   {
+      if (unChannel >= Count())
+         return "";
+      return m_acNames[unChannel];
+   }
+
+   //Sets the level mask of one channel.
+   void CATLogChannels::SetMask(unsigned int unChannel, unsigned char ucMask)
+   {
+      if (unChannel < AT_LOG_MAX_CHANNELS)
+         m_aucMasks[unChannel].store(ucMask, std::memory_order_relaxed);
+   }
+
+   //Sets the level mask of every channel.
+   void CATLogChannels::SetAllMasks(unsigned char ucMask)
+   {
+      for (unsigned int i = 0; i < AT_LOG_MAX_CHANNELS; i++)
+         m_aucMasks[i].store(ucMask, std::memory_order_relaxed);
+   }
+
+   //Returns the level mask of a channel.
+   unsigned char CATLogChannels::GetMask(unsigned int unChannel)
+   {
+      if (unChannel >= AT_LOG_MAX_CHANNELS)
+         return 0;
+      return m_aucMasks[unChannel].load(std::memory_order_relaxed);
+   }
+}
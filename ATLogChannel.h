@@ -0,0 +1,93 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogChannel.h
+//
+// Purpose: Named Log channels (render, physics, net, ...) each with its own level mask, so one subsystem can be turned up
+//          to trace without flooding the output with every other subsystem's messages.  Checking whether a message gets
+//          through is a single load and AND against the channel's mask.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+//Most channels that can exist at once, built in channels included.
+#ifndef AT_LOG_MAX_CHANNELS
+#define AT_LOG_MAX_CHANNELS 32
+#endif
+
+//Longest channel name, anything longer is cut short.
+#define AT_LOG_CHANNEL_NAME 24
+
+namespace Atlas
+{
+   class CATLogChannels
+   {
+      private:
+         static std::atomic<unsigned char>   m_aucMasks[AT_LOG_MAX_CHANNELS];  //Level mask of each channel.
+         static char                         m_acNames[AT_LOG_MAX_CHANNELS][AT_LOG_CHANNEL_NAME];  //Name of each channel.
+         static std::atomic<unsigned int>    m_unCount;  //Number of channels that exist.
+         static std::mutex                   m_mtxRegister;  //Held while adding a channel.
+
+      public:
+
+         //Channels that always exist.  CHANNEL_GENERAL is where messages without a channel go.
+         enum eChannel {CHANNEL_GENERAL = 0, CHANNEL_RENDER, CHANNEL_PHYSICS, CHANNEL_NET, CHANNEL_AUDIO, CHANNEL_BUILTIN_COUNT};
+
+         //Returned by Register and Find when there's no channel to give back.
+         enum { INVALID_CHANNEL = 0xFFFFFFFF };
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  IsEnabled
+         //
+         // Purpose:  Checks if a message of the given level gets through on a channel.
+         //
+         // In:  unChannel - The channel, must be a valid id.
+         //      ucLevelBit - The message's level bit (CATLogger::LevelBit).
+         //
+         // Out:  true if the message should be displayed.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static bool IsEnabled(unsigned int unChannel, unsigned char ucLevelBit)
+         {
+            return (m_aucMasks[unChannel].load(std::memory_order_relaxed) & ucLevelBit) != 0;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Register
+         //
+         // Purpose:  Adds a channel, or returns the existing one if a channel already has that name.
+         //
+         // In:  pName - Name of the channel e.g. "ai".
+         //      ucMask - Level mask the channel starts out with (CATLogger::LevelMask).
+         //
+         // Out:  The channel's id, INVALID_CHANNEL if there's no room for more channels.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned int Register(const char* pName, unsigned char ucMask);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Find
+         //
+         // Purpose:  Looks a channel up by name.
+         //
+         // In:  pName - Name of the channel.
+         //
+         // Out:  The channel's id, INVALID_CHANNEL if there's no such channel.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned int Find(const char* pName);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  GetName
+         //
+         // Purpose:  Returns the name of a channel.
+         //
+         // In:  unChannel - The channel's id.
+         //
+         // Out:  The name, "" for an unknown channel.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static const char* GetName(unsigned int unChannel);
+
+         static void SetMask(unsigned int unChannel, unsigned char ucMask);  //Sets the level mask of one channel.
+         static void SetAllMasks(unsigned char ucMask);  //Sets the level mask of every channel.
+         static unsigned char GetMask(unsigned int unChannel);  //Returns the level mask of a channel.
+         static unsigned int Count() { return m_unCount.load(std::memory_order_acquire); }
+   };
+}
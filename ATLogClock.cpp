@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogClock.cpp
+//
+// Purpose: The clock Log messages are stamped with.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogClock.h"
+#include <mutex>
+#include <thread>
+
+namespace Atlas
+{
+   std::atomic<unsigned long long>  CATLogClock::m_ullBaseTicks(0);
+   std::atomic<unsigned long long>  CATLogClock::m_ullBaseTime(0);
+   std::atomic<double>              CATLogClock::m_dNsPerTick(1.0);
+   std::atomic<double>              CATLogClock::m_dMeasuredNsPerTick(1.0);
+   std::atomic<unsigned int>        CATLogClock::m_unSequence(0);
+   std::atomic<bool>                CATLogClock::m_bCalibrated(false);
+
+   static std::once_flag s_ofCalibrate;  //Makes sure only one thread calibrates.
+   static std::mutex s_mtxAnchor;  //Held while re-anchoring, guards the two below.
+   static std::chrono::steady_clock::time_point s_tpAnchor;  //Steady clock at the last anchor, the start of the next rate measurement.
+   static unsigned long long s_ullAnchorTicks = 0;  //Tick count at the same moment.
+
+   //Wall clock time, nanoseconds since the epoch.
+   static unsigned long long WallNanoseconds()
+   {
+      return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::system_clock::now().time_since_epoch()).count());
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Calibrate
+   //
+   // Purpose:  Ties the tick count to the wall clock and, with the time stamp counter, measures how fast it
+   //           ticks (takes AT_LOG_CLOCK_CALIBRATION milliseconds).  Only the first call does anything, Reanchor
+   //           keeps it up to date from then on.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogClock::Calibrate()
+   {
+      std::call_once(s_ofCalibrate, []()
+      {
+         double dNsPerTick = 1.0;
+         #ifdef AT_LOG_TSC
+            //Count ticks over a stretch of the steady clock to find out how fast the counter runs.
+            std::chrono::steady_clock::time_point tpStart = std::chrono::steady_clock::now();
+            unsigned long long ullStart = Now();
+            std::this_thread::sleep_for(std::chrono::milliseconds(AT_LOG_CLOCK_CALIBRATION));
+            unsigned long long ullEnd = Now();
+            std::chrono::steady_clock::time_point tpEnd = std::chrono::steady_clock::now();
+
+            long long llNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tpEnd - tpStart).count();
+            if (ullEnd > ullStart && llNs > 0)
+               dNsPerTick = static_cast<double>(llNs) / static_cast<double>(ullEnd - ullStart);
+         #endif
+
+         std::lock_guard<std::mutex> lgAnchor(s_mtxAnchor);
+         s_tpAnchor = std::chrono::steady_clock::now();
+         s_ullAnchorTicks = Now();
+         unsigned long long ullWall = WallNanoseconds();
+         m_dMeasuredNsPerTick.store(dNsPerTick, std::memory_order_relaxed);
+         Store(s_ullAnchorTicks, ullWall, dNsPerTick);
+         m_bCalibrated.store(true, std::memory_order_release);
+      });
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Reanchor
+   //
+   // Purpose:  Once AT_LOG_CLOCK_REANCHOR milliseconds have gone by since the last time, re-measures how fast the
+   //           time stamp counter ticks over that whole stretch and steers the time stamps back onto the wall
+   //           clock.  Rather than jumping to the wall clock, which would put records either side of the anchor out
+   //           of order, the new calibration starts where the old one puts this moment and runs a little fast or
+   //           slow (at most AT_LOG_CLOCK_SLEW) until it has caught up by the next anchor.  A wall clock that
+   //           jumped ahead by more than a whole stretch is stepped to, it's still forwards.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogClock::Reanchor()
+   {
+      if (!m_bCalibrated.load(std::memory_order_acquire))
+         return;
+
+      std::lock_guard<std::mutex> lgAnchor(s_mtxAnchor);
+      if (std::chrono::steady_clock::now() - s_tpAnchor < std::chrono::milliseconds(AT_LOG_CLOCK_REANCHOR))
+         return;
+
+      //Read the clocks back to back, anything that runs between them shows up as an error in the offset.
+      std::chrono::steady_clock::time_point tpNow = std::chrono::steady_clock::now();
+      unsigned long long ullTicks = Now();
+      unsigned long long ullWall = WallNanoseconds();
+
+      unsigned long long ullBaseTicks, ullBaseTime;
+      double dNsPerTick;
+      Load(ullBaseTicks, ullBaseTime, dNsPerTick);
+
+      double dMeasured = m_dMeasuredNsPerTick.load(std::memory_order_relaxed);
+      #ifdef AT_LOG_TSC
+         long long llNs = std::chrono::duration_cast<std::chrono::nanoseconds>(tpNow - s_tpAnchor).count();
+         if (ullTicks > s_ullAnchorTicks && llNs > 0)
+            dMeasured = static_cast<double>(llNs) / static_cast<double>(ullTicks - s_ullAnchorTicks);
+      #endif
+
+      //Carry on from where the current calibration puts this moment, so the time stamps don't jump.
+      long long llElapsed = static_cast<long long>(ullTicks - ullBaseTicks);
+      unsigned long long ullHere = ullBaseTime + static_cast<long long>(static_cast<double>(llElapsed) * dNsPerTick);
+
+      //Make up the difference to the wall clock over the next stretch, within the slew limit.
+      const double dStretch = AT_LOG_CLOCK_REANCHOR * 1000000.0;
+      double dError = static_cast<double>(static_cast<long long>(ullWall - ullHere));
+      if (dError > dStretch)
+      {
+         ullHere = ullWall;
+         dError = 0.0;
+      }
+      double dSlew = dError / dStretch;
+      if (dSlew > AT_LOG_CLOCK_SLEW)
+         dSlew = AT_LOG_CLOCK_SLEW;
+      else if (dSlew < -AT_LOG_CLOCK_SLEW)
+         dSlew = -AT_LOG_CLOCK_SLEW;
+
+      s_tpAnchor = tpNow;
+      s_ullAnchorTicks = ullTicks;
+      m_dMeasuredNsPerTick.store(dMeasured, std::memory_order_relaxed);
+      Store(ullTicks, ullHere, dMeasured * (1.0 + dSlew));
+   }
+
+   //Changes the calibration, bumping the sequence to odd first so Load retries until it's even again.
+   void CATLogClock::Store(unsigned long long ullBaseTicks, unsigned long long ullBaseTime, double dNsPerTick)
+   {
+      unsigned int unSequence = m_unSequence.load(std::memory_order_relaxed);
+      m_unSequence.store(unSequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      m_ullBaseTicks.store(ullBaseTicks, std::memory_order_relaxed);
+      m_ullBaseTime.store(ullBaseTime, std::memory_order_relaxed);
+      m_dNsPerTick.store(dNsPerTick, std::memory_order_relaxed);
+      m_unSequence.store(unSequence + 2, std::memory_order_release);
+   }
+}
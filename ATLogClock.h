@@ -0,0 +1,167 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogClock.h
+//
+// Purpose: The clock Log messages are stamped with.  The calling thread only reads a raw tick count (the CPU's time stamp
+//          counter where there is one, the steady clock otherwise), turning ticks into wall clock time is left to
+//          whoever outputs the message, using a calibration done when the Logger starts up and redone every
+//          AT_LOG_CLOCK_REANCHOR milliseconds so the time stamps don't drift away from the wall clock.  The time
+//          stamps never go backwards, a wall clock that's stepped or slewed is caught up with gradually.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+//Use the CPU's time stamp counter on x86/x64 unless told not to.  Define AT_LOG_NO_TSC on machines without an invariant TSC.
+#if !defined(AT_LOG_NO_TSC) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define AT_LOG_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+//How long Calibrate watches the time stamp counter against the steady clock, in milliseconds.
+#ifndef AT_LOG_CLOCK_CALIBRATION
+#define AT_LOG_CLOCK_CALIBRATION 10
+#endif
+
+//How often Reanchor ties the tick count back to the wall clock and re-measures the counter's rate over everything
+//since the last time, in milliseconds.
+#ifndef AT_LOG_CLOCK_REANCHOR
+#define AT_LOG_CLOCK_REANCHOR 1000
+#endif
+
+//Most Reanchor speeds the time stamps up or slows them down by while catching up with the wall clock, as a fraction.
+//Has to stay under 1 so they keep moving forwards.
+#ifndef AT_LOG_CLOCK_SLEW
+#define AT_LOG_CLOCK_SLEW 0.5
+#endif
+
+//Times ToNanosecondsFromSignal retries reading the calibration before settling for what it read last.
+#ifndef AT_LOG_CLOCK_SIGNAL_TRIES
+#define AT_LOG_CLOCK_SIGNAL_TRIES 1000
+#endif
+
+namespace Atlas
+{
+   class CATLogClock
+   {
+      private:
+         static std::atomic<unsigned long long> m_ullBaseTicks;  //Tick count when we last calibrated.
+         static std::atomic<unsigned long long> m_ullBaseTime;  //Wall clock time then, nanoseconds since the epoch.
+         static std::atomic<double>             m_dNsPerTick;  //Nanoseconds in one tick, sped up or slowed down while catching up with the wall clock.
+         static std::atomic<unsigned int>       m_unSequence;  //Odd while the three above are being changed.
+         static std::atomic<bool>               m_bCalibrated;  //Has Calibrate been run?
+         static std::atomic<double>             m_dMeasuredNsPerTick;  //Nanoseconds in one tick as measured, for ElapsedNanoseconds.
+
+         //Changes the calibration, readers going through Load never see half of it.
+         static void Store(unsigned long long ullBaseTicks, unsigned long long ullBaseTime, double dNsPerTick);
+
+         //Reads the calibration, retrying if Store was partway through.  unTries limits the retries (0 keeps trying), after
+         //which it settles for the last values it read.
+         static void Load(unsigned long long& ullBaseTicks, unsigned long long& ullBaseTime, double& dNsPerTick, unsigned int unTries = 0)
+         {
+            for (unsigned int i = 0; !unTries || i < unTries; i++)
+            {
+               unsigned int unSequence = m_unSequence.load(std::memory_order_acquire);
+               ullBaseTicks = m_ullBaseTicks.load(std::memory_order_relaxed);
+               ullBaseTime = m_ullBaseTime.load(std::memory_order_relaxed);
+               dNsPerTick = m_dNsPerTick.load(std::memory_order_relaxed);
+               std::atomic_thread_fence(std::memory_order_acquire);
+               if (!(unSequence & 1) && m_unSequence.load(std::memory_order_relaxed) == unSequence)
+                  return;
+            }
+         }
+
+      public:
+
+         //Digits written after the seconds in a time stamp.
+         enum ePrecision {PRECISION_SECONDS = 0, PRECISION_MILLI = 3, PRECISION_MICRO = 6, PRECISION_NANO = 9};
+
+         //Raw tick count, all the calling thread pays for a time stamp.
+         static unsigned long long Now()
+         {
+            #ifdef AT_LOG_TSC
+               return __rdtsc();
+            #else
+               return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now().time_since_epoch()).count());
+            #endif
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Calibrate
+         //
+         // Purpose:  Ties the tick count to the wall clock and, with the time stamp counter, measures how fast it
+         //           ticks (takes AT_LOG_CLOCK_CALIBRATION milliseconds).  Only the first call does anything.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void Calibrate();
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Reanchor
+         //
+         // Purpose:  Once AT_LOG_CLOCK_REANCHOR milliseconds have gone by since the last time, re-measures how fast
+         //           the time stamp counter ticks over that whole stretch, which is far more accurate than
+         //           Calibrate's short window, and steers the time stamps back onto the wall clock over the next
+         //           stretch without ever stepping them back.  The Logger's tick thread calls this, it does nothing
+         //           before Calibrate.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void Reanchor();
+
+         //Turns a difference between two tick counts into nanoseconds, calibrating first if nobody has yet.
+         static unsigned long long ElapsedNanoseconds(unsigned long long ullTicks)
+         {
+            if (!m_bCalibrated.load(std::memory_order_acquire))
+               Calibrate();
+            return static_cast<unsigned long long>(static_cast<double>(ullTicks) * m_dMeasuredNsPerTick.load(std::memory_order_relaxed));
+         }
+
+         //Has Calibrate been run?  Lets code that can't afford to calibrate (signal handlers) check first.
+         static bool IsCalibrated() { return m_bCalibrated.load(std::memory_order_acquire); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  ToNanoseconds
+         //
+         // Purpose:  Turns a tick count from Now into wall clock time, calibrating first if nobody has yet.
+         //
+         // In:  ullTicks - The tick count.
+         //
+         // Out:  The time, nanoseconds since the epoch.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned long long ToNanoseconds(unsigned long long ullTicks)
+         {
+            if (!m_bCalibrated.load(std::memory_order_acquire))
+               Calibrate();
+
+            unsigned long long ullBaseTicks, ullBaseTime;
+            double dNsPerTick;
+            Load(ullBaseTicks, ullBaseTime, dNsPerTick);
+
+            long long llElapsed = static_cast<long long>(ullTicks - ullBaseTicks);
+            return ullBaseTime + static_cast<long long>(static_cast<double>(llElapsed) * dNsPerTick);
+         }
+
+         //Same as above for signal handlers, which may have interrupted Store on their own thread, so rather than wait
+         //on it forever this gives up after AT_LOG_CLOCK_SIGNAL_TRIES and uses what it read.  Never calibrates, check
+         //IsCalibrated first.
+         static unsigned long long ToNanosecondsFromSignal(unsigned long long ullTicks)
+         {
+            unsigned long long ullBaseTicks = 0, ullBaseTime = 0;
+            double dNsPerTick = 1.0;
+            Load(ullBaseTicks, ullBaseTime, dNsPerTick, AT_LOG_CLOCK_SIGNAL_TRIES);
+
+            long long llElapsed = static_cast<long long>(ullTicks - ullBaseTicks);
+            return ullBaseTime + static_cast<long long>(static_cast<double>(llElapsed) * dNsPerTick);
+         }
+   };
+}
@@ -0,0 +1,213 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogConsoleSink.cpp
+//
+// Purpose: Sink that prints messages to the Console, colored by level.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogConsoleSink.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <iostream>
+#else
+#include <cerrno>
+#endif
+
+namespace Atlas
+{
+   #ifdef _WIN32
+
+   //Constructor
+   CATConsoleSink::CATConsoleSink(HANDLE hConsole)
+   {
+      m_hConsole = hConsole;
+      m_bColors = true;
+      m_usColor = eColors::WHITE;
+   }
+
+   //Destructor
+   CATConsoleSink::~CATConsoleSink()
+   {
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  WriteText
+   //
+   // Purpose:  Prints a completed message in the color for its level.  The color is only changed when it differs
+   //           from the last message's and put back to white at the end of the batch.  Does not flush the Console,
+   //           that's left to EndBatch so a sink thread only flushes once per batch.
+   //
+   // In:  ucLevel - The eLevel of the message, picks the Console color.
+   //      pText - The completed, null terminated message.
+   //      unLength - Number of characters in pText.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATConsoleSink::WriteText(unsigned char ucLevel, const char* pText, unsigned int unLength)
+   {
+      unsigned short usColor = GetLevelColor(ucLevel);
+      if (m_bColors && usColor != m_usColor)
+      {
+         std::cout.flush();  //Text still waiting in cout has to go out in the old color.
+         SetConsoleTextAttribute(this->m_hConsole, usColor);
+         m_usColor = usColor;
+      }
+
+      std::cout.write(pText, unLength);
+      std::cout.put('\n');
+      this->AddBytesWritten(unLength + 1);
+   }
+
+   //Puts the color back and flushes the Console once per batch.
+   void CATConsoleSink::EndBatch(bool /*bFlush*/)
+   {
+      std::cout.flush();
+      if (m_usColor != eColors::WHITE)
+      {
+         SetConsoleTextAttribute(this->m_hConsole, eColors::WHITE);
+         m_usColor = eColors::WHITE;
+      }
+   }
+
+   //Turns colors on or off.
+   void CATConsoleSink::SetColors(bool bColors)
+   {
+      m_bColors = bColors;
+   }
+
+   #else
+
+   //ANSI escape code that puts the Console in the given eColors color.  Console API colors are blue, green and red bits
+   //plus an intensity bit, ANSI colors number red, green and blue the other way round.
+   static unsigned int GetAnsiColor(unsigned short usColor, char* pOut)
+   {
+      unsigned int unColor = ((usColor & 1) << 2) | (usColor & 2) | ((usColor & 4) >> 2);
+      unsigned int unCode = ((usColor & 8) ? 90 : 30) + unColor;
+
+      pOut[0] = '\x1b';
+      pOut[1] = '[';
+      pOut[2] = static_cast<char>('0' + unCode / 10);
+      pOut[3] = static_cast<char>('0' + unCode % 10);
+      pOut[4] = 'm';
+      return 5;
+   }
+
+   //Puts the Console back to its own colors.
+   static const char s_cAnsiReset[] = "\x1b[0m";
+
+   //Constructor
+   CATConsoleSink::CATConsoleSink(int nFile)
+   {
+      m_nFile = nFile;
+      m_unUsed = 0;
+      m_usColor = eColors::WHITE;
+
+      //Escape codes only mean something to a terminal, anything else (a pipe, a file, /dev/null) gets plain text.
+      const char* pTerm = getenv("TERM");
+      m_bColors = isatty(nFile) && !getenv("NO_COLOR") && !(pTerm && strcmp(pTerm, "dumb") == 0);
+   }
+
+   //Destructor
+   CATConsoleSink::~CATConsoleSink()
+   {
+      this->WriteBuffer();
+   }
+
+   //Writes out m_cBuffer in one go, riding out partial writes and interruptions.
+   void CATConsoleSink::WriteBuffer()
+   {
+      unsigned int unDone = 0;
+      while (unDone < m_unUsed)
+      {
+         ssize_t nWritten = write(m_nFile, m_cBuffer + unDone, m_unUsed - unDone);
+         if (nWritten > 0)
+            unDone += static_cast<unsigned int>(nWritten);
+         else if (nWritten < 0 && errno == EINTR)
+            continue;
+         else
+            break;  //Nowhere to put it, nothing more we can do.
+      }
+      m_unUsed = 0;
+   }
+
+   //Adds bytes to m_cBuffer, writing it out when it fills up.
+   void CATConsoleSink::Append(const char* pData, unsigned int unLength)
+   {
+      while (unLength > 0)
+      {
+         if (m_unUsed == sizeof(m_cBuffer))
+            this->WriteBuffer();
+
+         unsigned int unCopy = sizeof(m_cBuffer) - m_unUsed;
+         if (unCopy > unLength)
+            unCopy = unLength;
+         memcpy(m_cBuffer + m_unUsed, pData, unCopy);
+         m_unUsed += unCopy;
+         pData += unCopy;
+         unLength -= unCopy;
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  WriteText
+   //
+   // Purpose:  Adds a completed message to the batch, preceded by the escape code for its level's color when that
+   //           differs from the last message's.  Nothing is written until the buffer fills or EndBatch.
+   //
+   // In:  ucLevel - The eLevel of the message, picks the Console color.
+   //      pText - The completed, null terminated message.
+   //      unLength - Number of characters in pText.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATConsoleSink::WriteText(unsigned char ucLevel, const char* pText, unsigned int unLength)
+   {
+      //Write out what's there first if the whole line won't fit, so a line is never split across two writes and
+      //nothing else writing to the same terminal can land in the middle of it.
+      if (m_unUsed + unLength + 16 > sizeof(m_cBuffer))
+         this->WriteBuffer();
+
+      unsigned short usColor = GetLevelColor(ucLevel);
+      if (m_bColors && usColor != m_usColor)
+      {
+         char cColor[8];
+         this->Append(cColor, GetAnsiColor(usColor, cColor));
+         m_usColor = usColor;
+      }
+
+      this->Append(pText, unLength);
+      this->Append("\n", 1);
+      this->AddBytesWritten(unLength + 1);
+   }
+
+   //Puts the color back and writes the whole batch out in a single write().
+   void CATConsoleSink::EndBatch(bool /*bFlush*/)
+   {
+      if (m_usColor != eColors::WHITE)
+      {
+         this->Append(s_cAnsiReset, sizeof(s_cAnsiReset) - 1);
+         m_usColor = eColors::WHITE;
+      }
+      this->WriteBuffer();
+   }
+
+   //Turns colors on or off.
+   void CATConsoleSink::SetColors(bool bColors)
+   {
+      m_bColors = bColors;
+   }
+
+   #endif
+
+   //Console color used for a given message level (CATLogger::eLevel).
+   unsigned short CATConsoleSink::GetLevelColor(unsigned char ucLevel)
+   {
+      switch (ucLevel)
+      {
+         case 0:  return eColors::RED;  //ERR
+         case 1:  return eColors::YELLOW;  //WARN
+         case 2:  return eColors::GREEN;  //TRACE
+         default: return eColors::AQUA;  //INFO
+      }
+   }
+}
@@ -0,0 +1,61 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogConsoleSink.h
+//
+// Purpose: Sink that prints messages to the Console, colored by level.  On Windows the colors are set through the
+//          Console API.  Everywhere else the colors are ANSI escape codes (left off when the output isn't a terminal)
+//          and a whole batch of messages goes out in a single write().
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "ATLogSink.h"
+
+//Size of the buffer a batch of Console messages is put together in before it's written (POSIX only).
+#ifndef AT_LOG_CONSOLE_BUFFER
+#define AT_LOG_CONSOLE_BUFFER (16 * 1024)
+#endif
+
+namespace Atlas
+{
+   class CATConsoleSink : public CATLogSink
+   {
+      private:
+         #ifdef _WIN32
+            HANDLE               m_hConsole;  //The handle to the Console that we're outputting to.
+         #else
+            int                  m_nFile;  //File descriptor of the Console that we're outputting to.
+            char                 m_cBuffer[AT_LOG_CONSOLE_BUFFER];  //The batch being put together.
+            unsigned int         m_unUsed;  //Number of bytes in m_cBuffer.
+
+            void WriteBuffer();  //Writes out m_cBuffer in one go.
+            void Append(const char* pData, unsigned int unLength);  //Adds bytes to m_cBuffer, writing it out when it fills.
+         #endif
+         bool                    m_bColors;  //Color the messages by level?
+         unsigned short          m_usColor;  //Color the Console is currently set to.
+
+         //Colors that can be used on Console Output.
+         enum eColors {BLACK = 0, BLUE, GREEN, AQUA, RED, PURPLE, YELLOW, WHITE, GRAY, LIGHT_BLUE,
+            LIGHT_GREEN, LIGHT_AQUA, LIGHT_RED, LIGHT_PURPLE, LIGHT_YELLO, BRIGHT_WHITE};
+
+         static unsigned short GetLevelColor(unsigned char ucLevel);  //Console color used for a given message level.
+
+      protected:
+         virtual void WriteText(unsigned char ucLevel, const char* pText, unsigned int unLength) override;  //Prints a message in its level's color.
+         virtual void EndBatch(bool bFlush) override;  //Puts the color back and flushes the Console once per batch.
+
+      public:
+         #ifdef _WIN32
+            CATConsoleSink(HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE));  //Constructor, hConsole is the Console's output handle.
+         #else
+            CATConsoleSink(int nFile = STDOUT_FILENO);  //Constructor, nFile is the Console's file descriptor.
+         #endif
+         ~CATConsoleSink();  //Destructor
+
+         //Turns colors on or off, by default they're on only when the output is a terminal and NO_COLOR isn't set.
+         void SetColors(bool bColors);
+   };
+}
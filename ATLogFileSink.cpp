@@ -0,0 +1,91 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogFileSink.cpp
+//
+// Purpose: Sink that streams messages out to a file, as text or binary.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogFileSink.h"
+
+namespace Atlas
+{
+   //Constructor
+   CATFileSink::CATFileSink(bool bBinary, bool bIndexed) : m_Binary(&m_File)
+   {
+      m_bBinary = bBinary || bIndexed;
+      m_bIndexed = bIndexed;
+   }
+
+   //Destructor
+   CATFileSink::~CATFileSink()
+   {
+      this->Close();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Open
+   //
+   // Purpose:  Opens (and truncates) the file.  Binary files get their header written with the sink's current
+   //           time stamp settings, so set those first.  An appended to file that already has something in it
+   //           doesn't get another header.
+   //
+   // In:  sFilename - Name of the file to be created.
+   //      bAppend - Keep what's already in the file and carry on at the end of it instead.
+   //
+   // Out:  true if the file was opened, false otherwise.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATFileSink::Open(const CString& sFilename, bool bAppend)
+   {
+      if (!m_File.Open(sFilename, bAppend))
+         return false;
+
+      //Binary files start off with a header so ATLogDecode knows what it's looking at.
+      if (m_bBinary && m_File.GetSize() == 0)
+      {
+         unsigned short usFlags = static_cast<unsigned short>(this->GetTimestampDigits() << CATLogBinary::FILE_DIGITS_SHIFT);
+         if (this->HasTimestamp())
+            usFlags |= CATLogBinary::FILE_TIMESTAMP;
+         if (m_bIndexed)
+            usFlags |= CATLogBinary::FILE_INDEXED;
+         m_Binary.Begin(usFlags);
+      }
+      return true;
+   }
+
+   //Writes the raw record in binary, the text otherwise.
+   void CATFileSink::WriteRecord(const SATLogRecord& Record)
+   {
+      if (m_bBinary)
+      {
+         unsigned long long ullSize = m_File.GetSize();
+         m_Binary.Write(Record);
+         this->AddBytesWritten(m_File.GetSize() - ullSize);
+      }
+      else
+         CATLogSink::WriteRecord(Record);
+   }
+
+   //Adds a line to the next batch.
+   void CATFileSink::WriteText(unsigned char /*ucLevel*/, const char* pText, unsigned int unLength)
+   {
+      m_File.WriteLine(pText, unLength);
+      this->AddBytesWritten(unLength + 1);
+   }
+
+   //Writes out the file buffer if it's due, or right now if asked to.  An indexed file's block goes first.
+   void CATFileSink::EndBatch(bool bFlush)
+   {
+      if (m_bIndexed)
+      {
+         unsigned long long ullSize = m_File.GetSize();
+         if (bFlush)
+            m_Binary.EndBlock();
+         else
+            m_Binary.EndBlockIfDue();
+         this->AddBytesWritten(m_File.GetSize() - ullSize);
+      }
+
+      if (bFlush)
+         m_File.Flush();
+      else
+         m_File.FlushIfDue();
+   }
+}
@@ -0,0 +1,53 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogFileSink.h
+//
+// Purpose: Sink that streams messages out to a file, either as text or as raw records in the binary format read by
+//          ATLogDecode.  Binary files can also be written in indexed blocks for ATLogQuery (see ATLogBinary.h).
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "ATLogSink.h"
+#include "ATFileWriter.h"
+#include "ATLogBinary.h"
+
+namespace Atlas
+{
+   class CATFileSink : public CATLogSink
+   {
+      private:
+         CATFileWriter           m_File;  //Streams the messages out to file in batches.
+         CATBinaryWriter         m_Binary;  //Writes records to m_File in binary.
+         bool                    m_bBinary;  //Are we writing raw records instead of text?
+         bool                    m_bIndexed;  //Are those records grouped into indexed blocks?
+
+      protected:
+         virtual void WriteRecord(const SATLogRecord& Record) override;  //Writes the raw record in binary, the text otherwise.
+         virtual void WriteText(unsigned char ucLevel, const char* pText, unsigned int unLength) override;  //Adds a line to the next batch.
+         virtual void EndBatch(bool bFlush) override;  //Writes out the file buffer if it's due (or if asked to).
+
+      public:
+         CATFileSink(bool bBinary = false, bool bIndexed = false);  //Constructor, bBinary writes raw records instead of text, bIndexed in blocks.
+         ~CATFileSink();  //Destructor
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Open
+         //
+         // Purpose:  Opens (and truncates) the file.  Binary files get their header written with the sink's current
+         //           time stamp settings, so set those first.  An appended to file that already has something in it
+         //           doesn't get another header.
+         //
+         // In:  sFilename - Name of the file to be created.
+         //      bAppend - Keep what's already in the file and carry on at the end of it instead.
+         //
+         // Out:  true if the file was opened, false otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Open(const CString& sFilename, bool bAppend = false);
+
+         void Close() { m_Binary.EndBlock(); m_File.Close(); }  //Writes out whatever is left and closes the file.
+         bool IsOpen() const { return m_File.IsOpen(); }
+         unsigned long long GetSize() const { return m_File.GetSize(); }  //Size the file will be once everything handed to it is written out.
+
+         //Sets how often buffered messages get written out, see CATFileWriter::SetFlushPolicy.  Call before adding the sink.
+         void SetFlushPolicy(unsigned int unFlushSize, unsigned int unFlushInterval) { m_File.SetFlushPolicy(unFlushSize, unFlushInterval); }
+   };
+}
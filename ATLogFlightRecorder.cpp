@@ -0,0 +1,364 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogFlightRecorder.cpp
+//
+// Purpose: Ring of recent Log records, dumped when the program crashes.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogFlightRecorder.h"
+#include "ATLogBinary.h"
+#include "ATLogChannel.h"
+#include "ATLogClock.h"
+#include <csignal>
+#include <exception>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#define AT_OPEN(name) _open(name, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE)
+#define AT_WRITE(file, data, size) _write(file, data, static_cast<unsigned int>(size))
+#define AT_CLOSE(file) _close(file)
+#else
+#include <unistd.h>
+#include <cerrno>
+#define AT_OPEN(name) open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+#define AT_WRITE(file, data, size) write(file, data, size)
+#define AT_CLOSE(file) close(file)
+#endif
+
+namespace Atlas
+{
+   CATFlightRecorder::SSlot            CATFlightRecorder::m_aSlots[AT_LOG_FLIGHT_RECORDS];
+   std::atomic<unsigned long long>     CATFlightRecorder::m_ullNext(0);
+   std::atomic<unsigned char>          CATFlightRecorder::m_ucLevelMask(0);
+   std::atomic<bool>                   CATFlightRecorder::m_bDumping(false);
+   char                                CATFlightRecorder::m_acCrashFile[AT_LOG_FLIGHT_PATH] = {};
+   unsigned char                       CATFlightRecorder::m_ucTimestampDigits = CATLogClock::PRECISION_MICRO;
+
+   static std::terminate_handler s_pfnPrevTerminate = 0;  //The terminate handler we replaced.
+
+   //Signals that dump the ring.
+   static const int s_anSignals[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL
+   #ifdef SIGBUS
+      , SIGBUS
+   #endif
+   };
+   static const unsigned int s_unSignals = sizeof(s_anSignals) / sizeof(s_anSignals[0]);
+
+   //What each of s_anSignals did before we took it over, put back and called once we've dumped.
+   #ifdef _WIN32
+   static void (*s_apfnPrevious[s_unSignals])(int) = {};
+   #else
+   static struct sigaction s_asaPrevious[s_unSignals] = {};
+
+   //A thread's alternate signal stack, taken down and freed when the thread exits.
+   struct SATSignalStack
+   {
+      char* m_pStack = 0;
+      ~SATSignalStack()
+      {
+         if (!m_pStack)
+            return;
+
+         //Only take it down if it's still ours.
+         stack_t stCurrent = {};
+         if (sigaltstack(0, &stCurrent) == 0 && stCurrent.ss_sp == m_pStack)
+         {
+            stack_t stDisable = {};
+            stDisable.ss_flags = SS_DISABLE;
+            sigaltstack(&stDisable, 0);
+         }
+         delete[] m_pStack;
+      }
+   };
+
+   static thread_local SATSignalStack s_ssStack;
+   #endif
+
+   //Everything a dump needs that would normally live on the stack, kept here so a crash on a small (or blown) stack
+   //doesn't take the dump down with it.  Only one dump runs at a time.
+   static char          s_cDumpBuffer[16 * 1024];  //Bytes waiting to be written.
+   static unsigned int  s_unDumpUsed;  //Number of bytes in s_cDumpBuffer.
+   static bool          s_bDumpFailed;  //Did a write fail?
+   static SATLogRecord  s_DumpRecord;  //The record being copied out of the ring.
+   static unsigned char s_aucDefined[AT_LOG_MAX_FORMATS / 8];  //Bit per format id, set once it's been written.
+   static unsigned char s_aucChannels[(AT_LOG_MAX_CHANNELS + 7) / 8];  //Bit per channel, set once it's been written.
+   static std::atomic<bool> s_bDumpBusy(false);  //Held by whoever is using the buffers above.
+
+   //Writes out everything in s_cDumpBuffer, riding out partial writes and interruptions.
+   static void FlushDump(int nFile)
+   {
+      unsigned int unDone = 0;
+      while (unDone < s_unDumpUsed && !s_bDumpFailed)
+      {
+         long long llWritten = AT_WRITE(nFile, s_cDumpBuffer + unDone, s_unDumpUsed - unDone);
+         if (llWritten > 0)
+            unDone += static_cast<unsigned int>(llWritten);
+         #ifndef _WIN32
+         else if (llWritten < 0 && errno == EINTR)
+            continue;
+         #endif
+         else
+            s_bDumpFailed = true;
+      }
+      s_unDumpUsed = 0;
+   }
+
+   //Adds bytes to s_cDumpBuffer, writing it out when it fills up.
+   static void AppendDump(int nFile, const void* pData, unsigned int unLength)
+   {
+      const char* pBytes = static_cast<const char*>(pData);
+      while (unLength > 0)
+      {
+         if (s_unDumpUsed == sizeof(s_cDumpBuffer))
+            FlushDump(nFile);
+
+         unsigned int unCopy = sizeof(s_cDumpBuffer) - s_unDumpUsed;
+         if (unCopy > unLength)
+            unCopy = unLength;
+         memcpy(s_cDumpBuffer + s_unDumpUsed, pBytes, unCopy);
+         s_unDumpUsed += unCopy;
+         pBytes += unCopy;
+         unLength -= unCopy;
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  DumpTo
+   //
+   // Purpose:  Writes the ring out to an open file in the binary Log format, defining each format and channel before
+   //           the first record using it (the same as CATBinaryWriter, minus the CATFileWriter).  Only memcpy, strlen
+   //           and write are used.  Time stamps are turned into wall clock time if the clock has been calibrated.
+   //
+   // In:  nFile - The file descriptor.
+   //
+   // Out:  true if everything was written.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATFlightRecorder::DumpTo(int nFile)
+   {
+      //Someone else is already dumping, better to lose this one than have both write over each other.
+      if (s_bDumpBusy.exchange(true, std::memory_order_acquire))
+         return false;
+
+      s_unDumpUsed = 0;
+      s_bDumpFailed = false;
+      memset(s_aucDefined, 0, sizeof(s_aucDefined));
+      memset(s_aucChannels, 0, sizeof(s_aucChannels));
+
+      char cHeader[CATLogBinary::HEADER_SIZE];
+      unsigned short usFlags = static_cast<unsigned short>(CATLogBinary::FILE_TIMESTAMP | (m_ucTimestampDigits << CATLogBinary::FILE_DIGITS_SHIFT));
+      AppendDump(nFile, cHeader, CATLogBinary::WriteHeader(cHeader, usFlags));
+
+      bool bCalibrated = CATLogClock::IsCalibrated();
+      unsigned long long ullEnd = m_ullNext.load(std::memory_order_acquire);
+      unsigned long long ullStart = (ullEnd > AT_LOG_FLIGHT_RECORDS) ? ullEnd - AT_LOG_FLIGHT_RECORDS : 0;
+      for (unsigned long long ullIndex = ullStart; ullIndex < ullEnd; ullIndex++)
+      {
+         //Copy the record out, throwing it away if it was being written (or written over) while we copied.
+         SSlot& Slot = m_aSlots[ullIndex & (AT_LOG_FLIGHT_RECORDS - 1)];
+         unsigned long long ullSequence = Slot.m_ullSequence.load(std::memory_order_acquire);
+         if (ullSequence != ullIndex * 2 + 2)
+            continue;
+         memcpy(&s_DumpRecord, &Slot.m_Record, sizeof(s_DumpRecord));
+         std::atomic_thread_fence(std::memory_order_acquire);
+         if (Slot.m_ullSequence.load(std::memory_order_relaxed) != ullSequence || s_DumpRecord.m_usLength > sizeof(s_DumpRecord.m_cData))
+            continue;
+
+         unsigned int unChannel = s_DumpRecord.m_ucChannel;
+         if (unChannel < AT_LOG_MAX_CHANNELS && !(s_aucChannels[unChannel / 8] & (1 << (unChannel % 8))))
+         {
+            const char* pName = CATLogChannels::GetName(unChannel);
+            unsigned char ucLength = static_cast<unsigned char>(strlen(pName));
+
+            char cChannel[CATLogBinary::CHANNEL_HEADER_SIZE];
+            cChannel[0] = CATLogBinary::ENTRY_CHANNEL;
+            cChannel[1] = static_cast<char>(unChannel);
+            cChannel[2] = static_cast<char>(ucLength);
+            AppendDump(nFile, cChannel, sizeof(cChannel));
+            AppendDump(nFile, pName, ucLength);
+
+            s_aucChannels[unChannel / 8] |= static_cast<unsigned char>(1 << (unChannel % 8));
+         }
+
+         unsigned int unId = s_DumpRecord.m_unFormatId;
+         if (unId < AT_LOG_MAX_FORMATS && !(s_aucDefined[unId / 8] & (1 << (unId % 8))))
+         {
+            const char* pFormat = CATFormatRegistry::GetFormat(unId);
+            size_t unLength = strlen(pFormat);
+            unsigned short usLength = static_cast<unsigned short>((unLength < 0xFFFF) ? unLength : 0xFFFF);
+
+            char cFormat[CATLogBinary::FORMAT_HEADER_SIZE];
+            cFormat[0] = CATLogBinary::ENTRY_FORMAT;
+            memcpy(cFormat + 1, &unId, 4);
+            memcpy(cFormat + 5, &usLength, 2);
+            AppendDump(nFile, cFormat, sizeof(cFormat));
+            AppendDump(nFile, pFormat, usLength);
+
+            s_aucDefined[unId / 8] |= static_cast<unsigned char>(1 << (unId % 8));
+         }
+
+         if (bCalibrated)
+            s_DumpRecord.m_ullTimestamp = CATLogClock::ToNanosecondsFromSignal(s_DumpRecord.m_ullTimestamp);
+
+         char cRecord[CATLogBinary::RECORD_HEADER_SIZE];
+         AppendDump(nFile, cRecord, CATLogBinary::WriteRecordHeader(cRecord, s_DumpRecord));
+         AppendDump(nFile, s_DumpRecord.m_cData, s_DumpRecord.m_usLength);
+      }
+
+      FlushDump(nFile);
+      bool bResult = !s_bDumpFailed;
+      s_bDumpBusy.store(false, std::memory_order_release);
+      return bResult;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Dump
+   //
+   // Purpose:  Writes what's in the ring out as a BINARY Log file, oldest record first.  Records being written
+   //           while we read them are skipped.  Uses nothing but open and write, so it's safe from a signal handler.
+   //
+   // In:  pFilename - Name of the file to be created.
+   //
+   // Out:  true if the file was written, false otherwise.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATFlightRecorder::Dump(const char* pFilename)
+   {
+      if (!pFilename || !*pFilename)
+         return false;
+
+      int nFile = AT_OPEN(pFilename);
+      if (nFile < 0)
+         return false;
+
+      bool bResult = DumpTo(nFile);
+      AT_CLOSE(nFile);
+      return bResult;
+   }
+
+   //Dumps the ring, puts back whatever handled the signal before us and hands it over, as if we weren't here.
+   #ifdef _WIN32
+   void CATFlightRecorder::OnSignal(int nSignal)
+   #else
+   void CATFlightRecorder::OnSignal(int nSignal, siginfo_t* pInfo, void* pContext)
+   #endif
+   {
+      //Only the first crash gets dumped, e.g. std::terminate calling abort shouldn't dump twice.
+      if (!m_bDumping.exchange(true))
+         Dump(m_acCrashFile);
+
+      unsigned int unIndex = 0;
+      while (unIndex < s_unSignals && s_anSignals[unIndex] != nSignal)
+         unIndex++;
+
+      #ifdef _WIN32
+         void (*pfnPrevious)(int) = (unIndex < s_unSignals) ? s_apfnPrevious[unIndex] : SIG_DFL;
+         if (pfnPrevious && pfnPrevious != SIG_DFL && pfnPrevious != SIG_IGN && pfnPrevious != SIG_ERR)
+         {
+            signal(nSignal, pfnPrevious);
+            pfnPrevious(nSignal);
+            return;
+         }
+      #else
+         if (unIndex < s_unSignals)
+         {
+            const struct sigaction& saPrevious = s_asaPrevious[unIndex];
+            sigaction(nSignal, &saPrevious, 0);
+            if ((saPrevious.sa_flags & SA_SIGINFO) && saPrevious.sa_sigaction)
+            {
+               saPrevious.sa_sigaction(nSignal, pInfo, pContext);
+               return;
+            }
+            if (!(saPrevious.sa_flags & SA_SIGINFO) && saPrevious.sa_handler == SIG_IGN)
+               return;
+            if (!(saPrevious.sa_flags & SA_SIGINFO) && saPrevious.sa_handler != SIG_DFL)
+            {
+               saPrevious.sa_handler(nSignal);
+               return;
+            }
+         }
+      #endif
+
+      //Nobody else wanted it, do whatever would have happened without us.
+      signal(nSignal, SIG_DFL);
+      raise(nSignal);
+   }
+
+   //Dumps the ring and hands over to the terminate handler we replaced.
+   void CATFlightRecorder::OnTerminate()
+   {
+      if (!m_bDumping.exchange(true))
+         Dump(m_acCrashFile);
+
+      if (s_pfnPrevTerminate)
+         s_pfnPrevTerminate();
+      std::abort();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  InstallCrashHandler
+   //
+   // Purpose:  Dumps the ring to a file on SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS and std::terminate, then lets
+   //           the crash carry on as normal (core dump, debugger, ...).
+   //
+   // In:  pFilename - Where the ring gets dumped, copied so it doesn't need to stay around.
+   //      unDigits - Digits after the seconds when ATLogDecode prints the dump's time stamps.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFlightRecorder::InstallCrashHandler(const char* pFilename, unsigned int unDigits)
+   {
+      if (!pFilename)
+         return;
+
+      size_t unLength = strlen(pFilename);
+      if (unLength >= sizeof(m_acCrashFile))
+         unLength = sizeof(m_acCrashFile) - 1;
+      memcpy(m_acCrashFile, pFilename, unLength);
+      m_acCrashFile[unLength] = '\0';
+      m_ucTimestampDigits = static_cast<unsigned char>(unDigits);
+
+      InstallSignalStack();
+
+      //Installing again (e.g. a new file name) mustn't forget the handlers from before the first time.
+      for (unsigned int i = 0; i < s_unSignals; i++)
+      {
+         #ifdef _WIN32
+            void (*pfnPrevious)(int) = signal(s_anSignals[i], OnSignal);
+            if (pfnPrevious != OnSignal)
+               s_apfnPrevious[i] = pfnPrevious;
+         #else
+            //Reset to the default on the way in, so a crash inside the dump can't loop back into it.
+            struct sigaction saAction = {};
+            struct sigaction saPrevious = {};
+            saAction.sa_sigaction = OnSignal;
+            saAction.sa_flags = SA_SIGINFO | SA_RESETHAND | SA_ONSTACK;
+            sigemptyset(&saAction.sa_mask);
+            if (sigaction(s_anSignals[i], &saAction, &saPrevious) == 0 &&
+               (!(saPrevious.sa_flags & SA_SIGINFO) || saPrevious.sa_sigaction != OnSignal))
+               s_asaPrevious[i] = saPrevious;
+         #endif
+      }
+
+      std::terminate_handler pfnPrev = std::set_terminate(OnTerminate);
+      if (pfnPrev != OnTerminate)
+         s_pfnPrevTerminate = pfnPrev;
+   }
+
+   //Gives the calling thread an alternate signal stack, unless it already has one.
+   void CATFlightRecorder::InstallSignalStack()
+   {
+      #ifndef _WIN32
+         stack_t stCurrent = {};
+         if (s_ssStack.m_pStack || (sigaltstack(0, &stCurrent) == 0 && !(stCurrent.ss_flags & SS_DISABLE)))
+            return;
+
+         char* pStack = new char[AT_LOG_SIGNAL_STACK];
+         stack_t stStack = {};
+         stStack.ss_sp = pStack;
+         stStack.ss_size = AT_LOG_SIGNAL_STACK;
+         if (sigaltstack(&stStack, 0) == 0)
+            s_ssStack.m_pStack = pStack;
+         else
+            delete[] pStack;
+      #endif
+   }
+}
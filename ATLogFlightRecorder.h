@@ -0,0 +1,131 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogFlightRecorder.h
+//
+// Purpose: Ring of the last AT_LOG_FLIGHT_RECORDS Log records, so a crash still leaves behind the messages leading up
+//          to it.  Every record a sink takes goes in, which costs a counter increment and a memcpy of a record that's
+//          already built, no locks.  Levels the channels filter out can be kept too with
+//          CATLogger::SetFlightRecorderLevel, but those have to be built just for the ring (a FillRecord each, several
+//          times the cost of a filtered message).  On SIGSEGV, SIGABRT, std::terminate and friends the ring is dumped as a BINARY Log file using only
+//          async-signal-safe calls, ATLogDecode turns it into text like any other.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include "ATLogRecord.h"
+
+//Number of records the ring holds, has to be a power of two.
+#ifndef AT_LOG_FLIGHT_RECORDS
+#define AT_LOG_FLIGHT_RECORDS 1024
+#endif
+
+//Longest path the crash dump can be written to.
+#define AT_LOG_FLIGHT_PATH 260
+
+//Size of the alternate stack the crash handler runs on, so a thread that crashed by blowing its own stack still gets
+//dumped (see CATFlightRecorder::InstallSignalStack).
+#ifndef AT_LOG_SIGNAL_STACK
+#define AT_LOG_SIGNAL_STACK (64 * 1024)
+#endif
+
+namespace Atlas
+{
+   class CATFlightRecorder
+   {
+      private:
+         static_assert((AT_LOG_FLIGHT_RECORDS & (AT_LOG_FLIGHT_RECORDS - 1)) == 0, "AT_LOG_FLIGHT_RECORDS has to be a power of two");
+
+         //A record and the sequence number guarding it.  The sequence is odd while the record is being copied in and
+         //2 * (index + 1) once it's done, so a dump can tell a finished record from a torn one.
+         struct SSlot
+         {
+            std::atomic<unsigned long long>  m_ullSequence;
+            SATLogRecord                     m_Record;
+         };
+
+         static SSlot                        m_aSlots[AT_LOG_FLIGHT_RECORDS];  //The ring.
+         static std::atomic<unsigned long long> m_ullNext;  //Index of the next record, never wraps.
+         static std::atomic<unsigned char>   m_ucLevelMask;  //Levels recorded even when no sink takes them (CATLogger::LevelMask).
+         static std::atomic<bool>            m_bDumping;  //Set by the first dump after a crash so a second signal doesn't start another.
+         static char                         m_acCrashFile[AT_LOG_FLIGHT_PATH];  //Where a crash dumps the ring.
+         static unsigned char                m_ucTimestampDigits;  //Digits after the seconds in the dump's time stamps.
+
+         static bool DumpTo(int nFile);  //Writes the ring out to an open file descriptor, async-signal-safe.
+         #ifdef _WIN32
+         static void OnSignal(int nSignal);  //Dumps the ring and hands the signal to whoever had it before us.
+         #else
+         static void OnSignal(int nSignal, siginfo_t* pInfo, void* pContext);  //Dumps the ring and hands the signal to whoever had it before us.
+         #endif
+         static void OnTerminate();  //Dumps the ring and hands over to the terminate handler we replaced.
+
+      public:
+
+         //Does the ring keep messages of the given level bit when no sink takes them?
+         static bool Accepts(unsigned char ucLevelBit) { return (m_ucLevelMask.load(std::memory_order_relaxed) & ucLevelBit) != 0; }
+
+         //Levels that get recorded even when no sink takes them (CATLogger::LevelMask), none by default.
+         static void SetLevelMask(unsigned char ucMask) { m_ucLevelMask.store(ucMask, std::memory_order_relaxed); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Add
+         //
+         // Purpose:  Copies a record into the ring over the oldest one.  Lock-free, safe from any thread.
+         //
+         // In:  Record - The record, its time stamp still in CATLogClock ticks.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void Add(const SATLogRecord& Record)
+         {
+            unsigned long long ullIndex = m_ullNext.fetch_add(1, std::memory_order_relaxed);
+            SSlot& Slot = m_aSlots[ullIndex & (AT_LOG_FLIGHT_RECORDS - 1)];
+
+            Slot.m_ullSequence.store(ullIndex * 2 + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(&Slot.m_Record, &Record, offsetof(SATLogRecord, m_cData) + Record.m_usLength);
+            Slot.m_ullSequence.store(ullIndex * 2 + 2, std::memory_order_release);
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Dump
+         //
+         // Purpose:  Writes what's in the ring out as a BINARY Log file, oldest record first.  Records being written
+         //           while we read them are skipped.  Uses nothing but open and write, so it's safe from a signal handler.
+         //
+         // In:  pFilename - Name of the file to be created.
+         //
+         // Out:  true if the file was written, false otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static bool Dump(const char* pFilename);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  InstallCrashHandler
+         //
+         // Purpose:  Dumps the ring to a file on SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS and std::terminate, then
+         //           hands the crash to whatever handler was installed before (or lets it carry on as normal: core
+         //           dump, debugger, ...).  Also gives the calling thread an alternate signal stack, other threads
+         //           that could overflow their stack should call InstallSignalStack themselves.
+         //
+         // In:  pFilename - Where the ring gets dumped, copied so it doesn't need to stay around.
+         //      unDigits - Digits after the seconds when ATLogDecode prints the dump's time stamps.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void InstallCrashHandler(const char* pFilename, unsigned int unDigits);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  InstallSignalStack
+         //
+         // Purpose:  Gives the calling thread an AT_LOG_SIGNAL_STACK byte stack for signal handlers to run on, so a
+         //           stack overflow on that thread can still be dumped.  Freed when the thread exits.  Does nothing
+         //           if the thread already has one, or on Windows.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void InstallSignalStack();
+   };
+}
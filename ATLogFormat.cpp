@@ -0,0 +1,799 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogFormat.cpp
+//
+// Purpose: Type-safe formatting for the Logger.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogFormat.h"
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+//Longest a number written out by the Append functions can get, "-2.2250738585072014e-308" being the worst of them.
+#define NUMBER_SIZE 32
+
+namespace Atlas
+{
+   //Every pair of digits from "00" to "99", so numbers can be written out two digits at a time.
+   static const char s_cDigitPairs[] =
+      "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+      "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+   //Hex digits by value.
+   static const char s_cHexDigits[] = "0123456789abcdef";
+
+   SATTypeFormatter CATTypeFormatters::m_aFormatters[AT_LOG_MAX_FORMATTERS];
+   std::atomic<unsigned int> CATTypeFormatters::m_unCount(0);
+
+   //Held while registering a formatter.
+   static std::mutex s_mtxFormatters;
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Register
+   //
+   // Purpose:  Binds a placeholder tag to a formatter.  AT_LOG_FORMATTER types register themselves the first
+   //           time they're logged, tools decoding files written by a program (e.g. ATLogDecode) can register
+   //           that program's formatters by hand to get its values back out as text.  A tag that's already taken
+   //           keeps its first formatter.
+   //
+   // In:  pTag - Placeholder tag, letters and digits, shorter than AT_LOG_FORMATTER_TAG.
+   //      unSize - Size of the type's values.
+   //      pfnFormat - Writes a value out.
+   //
+   // Out:  The tag's id, 0 if the tag is no good or there's no room left.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned short CATTypeFormatters::Register(const char* pTag, unsigned int unSize, ATLogFormatFn pfnFormat)
+   {
+      unsigned int unLength = pTag ? static_cast<unsigned int>(strlen(pTag)) : 0;
+      if (unLength == 0 || unLength >= AT_LOG_FORMATTER_TAG || unSize > AT_LOG_USER_SIZE || !pfnFormat)
+         return 0;
+      for (unsigned int i = 0; i < unLength; i++)
+         if (!isalnum(static_cast<unsigned char>(pTag[i])))
+            return 0;
+
+      std::lock_guard<std::mutex> lgLock(s_mtxFormatters);
+      unsigned short usId = Find(pTag, unLength);
+      if (usId)
+         return usId;
+
+      unsigned int unCount = m_unCount.load(std::memory_order_relaxed);
+      if (unCount >= AT_LOG_MAX_FORMATTERS)
+         return 0;
+
+      SATTypeFormatter& Formatter = m_aFormatters[unCount];
+      memcpy(Formatter.m_cTag, pTag, unLength + 1);
+      Formatter.m_unTagLength = unLength;
+      Formatter.m_unSize = unSize;
+      Formatter.m_pfnFormat = pfnFormat;
+      m_unCount.store(unCount + 1, std::memory_order_release);
+      return static_cast<unsigned short>(unCount + 1);
+   }
+
+   //Id of a tag, 0 if it hasn't been registered.
+   unsigned short CATTypeFormatters::Find(const char* pTag, unsigned int unLength)
+   {
+      unsigned int unCount = m_unCount.load(std::memory_order_acquire);
+      for (unsigned int i = 0; i < unCount; i++)
+         if (m_aFormatters[i].m_unTagLength == unLength && memcmp(m_aFormatters[i].m_cTag, pTag, unLength) == 0)
+            return static_cast<unsigned short>(i + 1);
+      return 0;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  BuildMessage
+   //
+   // Purpose:  Presses the arguments into the format, writing the result straight into fbOut.  A placeholder with
+   //           no argument left for it is written out as is.  Fields are skipped, see AppendFields.
+   //
+   // In:  fbOut - Where the message is going.
+   //      pFormat - The message being outputted e.g. "Hello there {f}!"
+   //      pArgs - The values to press into pFormat.
+   //      unArgCount - Number of values in pArgs.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFormatter::BuildMessage(CATFormatBuffer& fbOut, const char* pFormat, const SATFormatArg* pArgs, unsigned int unArgCount)
+   {
+      unsigned int unArg = 0;  //Next argument to be used.
+      const char* pLiteral = pFormat;  //Start of the text since the last tag.
+      const char* pCurrent = pFormat;
+
+      while (*pCurrent != '\0')
+      {
+         if (*pCurrent != '{')
+         {
+            pCurrent++;
+            continue;
+         }
+
+         //Find end of tag, no end means the rest is just text.
+         const char* pEnd = strchr(pCurrent + 1, '}');
+         if (!pEnd)
+            break;
+
+         //Grab the text from last tag to new tag.
+         fbOut.Append(pLiteral, static_cast<unsigned int>(pCurrent - pLiteral));
+
+         //Fields don't fill placeholders.
+         while (unArg < unArgCount && pArgs[unArg].m_pKey)
+            unArg++;
+
+         //Out of arguments?  Then leave the tag as it is.
+         if (unArg < unArgCount)
+            ProcessToken(fbOut, pCurrent + 1, static_cast<unsigned int>(pEnd - pCurrent - 1), pArgs[unArg++]);
+         else
+            fbOut.Append(pCurrent, static_cast<unsigned int>(pEnd - pCurrent + 1));
+
+         pCurrent = pEnd + 1;
+         pLiteral = pCurrent;
+      }
+
+      //Whatever is left after the last tag.
+      fbOut.Append(pLiteral, static_cast<unsigned int>(strlen(pLiteral)));
+   }
+
+   //Same as above with a format compiled ahead of time, nothing gets scanned.
+   void CATFormatter::BuildMessage(CATFormatBuffer& fbOut, const SATFormatTemplate& Template, const SATFormatArg* pArgs, unsigned int unArgCount)
+   {
+      unsigned int unArg = 0;  //Next argument to be used.
+      for (unsigned int i = 0; i < Template.m_unSegments; i++)
+      {
+         const SATFormatSegment& Segment = Template.m_pSegments[i];
+         if (!Segment.m_bPlaceholder)
+         {
+            fbOut.Append(Segment.m_pText, Segment.m_unLength);
+            continue;
+         }
+
+         while (unArg < unArgCount && pArgs[unArg].m_pKey)
+            unArg++;
+
+         if (unArg >= unArgCount)
+            fbOut.Append(Segment.m_pText, Segment.m_unLength);
+         else if (Segment.m_bSpec)
+            AppendArg(fbOut, Segment.m_cKind, Segment.m_Spec, pArgs[unArg++]);
+         else
+            AppendArg(fbOut, Segment.m_cKind, pArgs[unArg++]);
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Compile
+   //
+   // Purpose:  Breaks a format up into literal text and placeholders the same way BuildMessage reads it, with
+   //           each placeholder's tag already worked out.  The template points into pFormat rather than copying it.
+   //
+   // In:  pFormat - The format, has to stay around as long as the template does.
+   //
+   // Out:  The template, to be freed with Free.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   SATFormatTemplate* CATFormatter::Compile(const char* pFormat)
+   {
+      //Count the placeholders first so the pieces can go in a single allocation.
+      unsigned int unPlaceholders = 0;
+      for (const char* pCurrent = strchr(pFormat, '{'); pCurrent; pCurrent = strchr(pCurrent, '{'))
+      {
+         const char* pEnd = strchr(pCurrent + 1, '}');
+         if (!pEnd)
+            break;
+         unPlaceholders++;
+         pCurrent = pEnd + 1;
+      }
+
+      SATFormatTemplate* pTemplate = new SATFormatTemplate();
+      pTemplate->m_pFormat = pFormat;
+      pTemplate->m_pSegments = new SATFormatSegment[unPlaceholders * 2 + 1];
+      pTemplate->m_unSegments = 0;
+      pTemplate->m_unPlaceholders = unPlaceholders;
+      pTemplate->m_unLiteralLength = 0;
+
+      const char* pLiteral = pFormat;  //Start of the text since the last tag.
+      for (unsigned int i = 0; i < unPlaceholders; i++)
+      {
+         const char* pCurrent = strchr(pLiteral, '{');
+         const char* pEnd = strchr(pCurrent + 1, '}');
+
+         if (pCurrent != pLiteral)
+         {
+            pTemplate->m_pSegments[pTemplate->m_unSegments++] = {pLiteral, static_cast<unsigned int>(pCurrent - pLiteral), false, 0, false, SATFormatSpec()};
+            pTemplate->m_unLiteralLength += static_cast<unsigned int>(pCurrent - pLiteral);
+         }
+
+         unsigned int unLength = static_cast<unsigned int>(pEnd - pCurrent + 1);
+         unsigned int unTag = TagLength(pCurrent + 1, unLength - 2);
+         SATFormatSegment& Segment = pTemplate->m_pSegments[pTemplate->m_unSegments++];
+         Segment = {pCurrent, unLength, true, TagKind(pCurrent + 1, unTag), false, SATFormatSpec()};
+         if (unTag < unLength - 2)
+            Segment.m_bSpec = ParseSpec(pCurrent + 2 + unTag, unLength - 3 - unTag, Segment.m_Spec);
+         pLiteral = pEnd + 1;
+      }
+
+      //Whatever is left after the last tag.
+      unsigned int unRest = static_cast<unsigned int>(strlen(pLiteral));
+      if (unRest > 0)
+      {
+         pTemplate->m_pSegments[pTemplate->m_unSegments++] = {pLiteral, unRest, false, 0, false, SATFormatSpec()};
+         pTemplate->m_unLiteralLength += unRest;
+      }
+      return pTemplate;
+   }
+
+   //Frees a template made by Compile.
+   void CATFormatter::Free(SATFormatTemplate* pTemplate)
+   {
+      if (pTemplate)
+      {
+         delete[] pTemplate->m_pSegments;
+         delete pTemplate;
+      }
+   }
+
+   //Writes out the fields among pArgs as " key=value", each value the way its own type prints.
+   void CATFormatter::AppendFields(CATFormatBuffer& fbOut, const SATFormatArg* pArgs, unsigned int unArgCount)
+   {
+      for (unsigned int i = 0; i < unArgCount; i++)
+      {
+         if (!pArgs[i].m_pKey)
+            continue;
+
+         fbOut.Append(' ');
+         fbOut.Append(pArgs[i].m_pKey, pArgs[i].m_ucKeyLength);
+         fbOut.Append('=');
+         ProcessToken(fbOut, "", 0, pArgs[i]);
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  ProcessToken
+   //
+   // Purpose:  String-afies a single argument the way its placeholder tag and options ask for.  Options that can't
+   //           be read are ignored.
+   //
+   // In:  fbOut - Where the text is going.
+   //      pToken - Everything between the braces e.g. "ll" or "f:.3".
+   //      unLength - Length of pToken.
+   //      Arg - The value to be written out.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFormatter::ProcessToken(CATFormatBuffer& fbOut, const char* pToken, unsigned int unLength, const SATFormatArg& Arg)
+   {
+      unsigned int unTag = TagLength(pToken, unLength);
+      SATFormatSpec Spec;
+      if (unTag < unLength && ParseSpec(pToken + unTag + 1, unLength - unTag - 1, Spec))
+         AppendArg(fbOut, TagKind(pToken, unTag), Spec, Arg);
+      else
+         AppendArg(fbOut, TagKind(pToken, unTag), Arg);
+   }
+
+   //What a placeholder tag asks for, 'i', 'u', 'f', 'c', 's', 'p' or 'b', 0 for a tag we don't know.
+   char CATFormatter::TagKind(const char* pToken, unsigned int unLength)
+   {
+      char cKind = 0;
+      if (unLength == 1)
+         cKind = pToken[0];
+      else if (unLength >= 2 && pToken[0] == 'l')  //ll, lu and llu.
+         cKind = (pToken[unLength - 1] == 'u') ? 'u' : 'i';
+
+      if (cKind == 'l')  //Long
+         cKind = 'i';
+      else if (cKind == 'd')  //Double
+         cKind = 'f';
+
+      switch (cKind)
+      {
+         case 'i': case 'u': case 'f': case 'c': case 's': case 'p': case 'b':
+            return cKind;
+      }
+      return 0;
+   }
+
+   //Writes out a value of a type with its own placeholder, or its bytes in hex if this program has no formatter for it.
+   static void AppendUser(CATFormatBuffer& fbOut, const SATFormatArg& Arg)
+   {
+      const SATTypeFormatter* pFormatter = CATTypeFormatters::Get(Arg.m_usFormatter);
+      if (pFormatter && pFormatter->m_unSize == Arg.m_unLength)
+      {
+         //The value may be sitting anywhere in an encoded record, the formatter gets an aligned copy.
+         alignas(std::max_align_t) unsigned char ucValue[AT_LOG_USER_SIZE];
+         memcpy(ucValue, Arg.m_pPointer, Arg.m_unLength);
+         pFormatter->m_pfnFormat(fbOut, ucValue);
+         return;
+      }
+
+      const unsigned char* pBytes = static_cast<const unsigned char*>(Arg.m_pPointer);
+      fbOut.Append('<');
+      for (unsigned int i = 0; i < Arg.m_unLength; i++)
+      {
+         fbOut.Append(s_cHexDigits[pBytes[i] >> 4]);
+         fbOut.Append(s_cHexDigits[pBytes[i] & 0x0F]);
+      }
+      fbOut.Append('>');
+   }
+
+   //Turns a float into the integers it prints as when a placeholder asks for one.  Out of range values stick at the
+   //nearest end instead of being undefined, NaN comes out as 0.
+   static void FloatToIntegers(double dValue, long long& llValue, unsigned long long& ullValue)
+   {
+      if (std::isnan(dValue))
+      {
+         llValue = 0;
+         ullValue = 0;
+         return;
+      }
+
+      if (dValue >= 9223372036854775808.0)  //2^63
+         llValue = LLONG_MAX;
+      else if (dValue < -9223372036854775808.0)
+         llValue = LLONG_MIN;
+      else
+         llValue = static_cast<long long>(dValue);
+
+      if (dValue >= 18446744073709551616.0)  //2^64
+         ullValue = ULLONG_MAX;
+      else if (dValue >= 0.0)
+         ullValue = static_cast<unsigned long long>(dValue);
+      else
+         ullValue = static_cast<unsigned long long>(llValue);  //Negatives wrap the same as a signed argument does.
+   }
+
+   //Works out what an argument will be written out as, cKind if it can be one, and gets its value as each kind of number.
+   static char ResolveKind(char cKind, const SATFormatArg& Arg, long long& llValue, unsigned long long& ullValue, double& dValue)
+   {
+      //Numbers can be asked for as any other kind of number.
+      llValue = 0;
+      ullValue = 0;
+      dValue = 0.0;
+      switch (Arg.m_ucType)
+      {
+         case ARG_SIGNED:    llValue = Arg.m_llValue; ullValue = static_cast<unsigned long long>(llValue); dValue = static_cast<double>(llValue); break;
+         case ARG_UNSIGNED:  ullValue = Arg.m_ullValue; llValue = static_cast<long long>(ullValue); dValue = static_cast<double>(ullValue); break;
+         case ARG_FLOAT:     dValue = Arg.m_dValue; break;  //Only made an integer below, if it's printed as one.
+         case ARG_CHAR:      llValue = Arg.m_cValue; ullValue = static_cast<unsigned char>(Arg.m_cValue); dValue = static_cast<double>(llValue); break;
+         case ARG_BOOL:      llValue = Arg.m_bValue ? 1 : 0; ullValue = llValue; dValue = static_cast<double>(llValue); break;
+      }
+
+      //Strings and pointers only print as themselves (or a pointer), same for anything the tag can't take.
+      if (Arg.m_ucType == ARG_STRING && cKind != 'p')
+         cKind = 's';
+      else if (Arg.m_ucType == ARG_POINTER || (Arg.m_ucType == ARG_STRING && cKind == 'p'))
+         cKind = 'p';
+      else if (cKind != 'i' && cKind != 'u' && cKind != 'f' && cKind != 'c' && cKind != 'b')
+      {
+         switch (Arg.m_ucType)
+         {
+            case ARG_SIGNED:    cKind = 'i'; break;
+            case ARG_UNSIGNED:  cKind = 'u'; break;
+            case ARG_FLOAT:     cKind = 'f'; break;
+            case ARG_CHAR:      cKind = 'c'; break;
+            case ARG_BOOL:      cKind = 'b'; break;
+         }
+      }
+
+      if (Arg.m_ucType == ARG_FLOAT && cKind != 'f')
+         FloatToIntegers(dValue, llValue, ullValue);
+      return cKind;
+   }
+
+   //Writes out an argument as cKind (from TagKind), or as whatever its own type is if it can't be one.
+   void CATFormatter::AppendArg(CATFormatBuffer& fbOut, char cKind, const SATFormatArg& Arg)
+   {
+      //Types with their own placeholder only ever write themselves out.
+      if (Arg.m_ucType == ARG_USER)
+      {
+         AppendUser(fbOut, Arg);
+         return;
+      }
+
+      long long llValue;
+      unsigned long long ullValue;
+      double dValue;
+      switch (ResolveKind(cKind, Arg, llValue, ullValue, dValue))
+      {
+         case 'i':  //int/short/long/long long
+         {
+            AppendSigned(fbOut, llValue);
+            break;
+         }
+         case 'u':  //Unsigned int/short/char/long/long long
+         {
+            AppendUnsigned(fbOut, ullValue);
+            break;
+         }
+         case 'f':  //Float/Double
+         {
+            AppendDouble(fbOut, dValue);
+            break;
+         }
+         case 'c':  //Single character
+         {
+            fbOut.Append(static_cast<char>(llValue));
+            break;
+         }
+         case 's':  //String
+         {
+            if (Arg.m_pString)
+               fbOut.Append(Arg.m_pString, Arg.m_unLength);
+            else
+               fbOut.Append("(null)", 6);
+            break;
+         }
+         case 'p':  //Printing out pointer address.
+         {
+            AppendHex(fbOut, reinterpret_cast<uintptr_t>(Arg.m_pPointer), true);
+            break;
+         }
+         case 'b':  //Boolean
+         {
+            if (llValue)
+               fbOut.Append("True", 4);
+            else
+               fbOut.Append("False", 5);
+            break;
+         }
+      }
+   }
+
+   //Writes out the sign a number asked for with cSign (from SATFormatSpec) gets.  Returns the number of characters written.
+   static unsigned int AppendSign(CATFormatBuffer& fbOut, bool bNegative, char cSign)
+   {
+      if (bNegative)
+         cSign = '-';
+      if (!cSign)
+         return 0;
+      fbOut.Append(cSign);
+      return 1;
+   }
+
+   //Writes out a number in hex, octal or binary, cType being 'x', 'X', 'o' or 'b'.
+   static void AppendRadix(CATFormatBuffer& fbOut, unsigned long long ullValue, char cType)
+   {
+      static const char s_cUpperHexDigits[] = "0123456789ABCDEF";
+      const char* pDigits = (cType == 'X') ? s_cUpperHexDigits : s_cHexDigits;
+      unsigned int unBits = (cType == 'x' || cType == 'X') ? 4 : ((cType == 'o') ? 3 : 1);
+      unsigned long long ullMask = (1ULL << unBits) - 1;
+
+      char cBuffer[64];
+      char* pFirst = cBuffer + sizeof(cBuffer);
+      do
+      {
+         *--pFirst = pDigits[ullValue & ullMask];
+         ullValue >>= unBits;
+      } while (ullValue);
+      fbOut.Append(pFirst, static_cast<unsigned int>(cBuffer + sizeof(cBuffer) - pFirst));
+   }
+
+   //Writes out a floating point number the way Spec asks for.  Returns the number of characters ahead of the digits (the sign).
+   static unsigned int AppendFloat(CATFormatBuffer& fbOut, double dValue, const SATFormatSpec& Spec)
+   {
+      unsigned int unSign = AppendSign(fbOut, std::signbit(dValue), Spec.m_cSign);
+      dValue = std::fabs(dValue);
+
+      char cType = static_cast<char>(tolower(static_cast<unsigned char>(Spec.m_cType)));
+      std::chars_format Format = std::chars_format::general;
+      if (cType == 'e')
+         Format = std::chars_format::scientific;
+      else if (cType == 'f' || (cType != 'g' && Spec.m_sPrecision >= 0))
+         Format = std::chars_format::fixed;
+
+      //Biggest there is, 1.8e308 written out in full, plus the most decimals that can be asked for.
+      char cBuffer[320 + AT_LOG_MAX_PRECISION];
+      std::to_chars_result Result;
+      if (Spec.m_sPrecision >= 0)
+         Result = std::to_chars(cBuffer, cBuffer + sizeof(cBuffer), dValue, Format, Spec.m_sPrecision);
+      else if (cType)
+         Result = std::to_chars(cBuffer, cBuffer + sizeof(cBuffer), dValue, Format);
+      else
+         Result = std::to_chars(cBuffer, cBuffer + sizeof(cBuffer), dValue);
+      if (Result.ec != std::errc())
+         return unSign;
+
+      unsigned int unLength = static_cast<unsigned int>(Result.ptr - cBuffer);
+      if (Spec.m_cType >= 'A' && Spec.m_cType <= 'Z')
+         for (unsigned int i = 0; i < unLength; i++)
+            cBuffer[i] = static_cast<char>(toupper(static_cast<unsigned char>(cBuffer[i])));
+      fbOut.Append(cBuffer, unLength);
+      return unSign;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  AppendArg
+   //
+   // Purpose:  Same as above, applying a placeholder's options.  Everything is still written straight into
+   //           fbOut and then padded in place, types with their own placeholder get padded the same way.
+   //
+   // In:  fbOut - Where the text is going.
+   //      cKind - What the placeholder asks for, see TagKind.
+   //      Spec - The placeholder's options.
+   //      Arg - The value to be written out.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFormatter::AppendArg(CATFormatBuffer& fbOut, char cKind, const SATFormatSpec& Spec, const SATFormatArg& Arg)
+   {
+      unsigned int unStart = fbOut.Length();
+      unsigned int unPrefix = 0;  //Sign and radix prefix written ahead of a number, zero padding goes after them.
+      bool bNumber = false;
+
+      if (Arg.m_ucType == ARG_USER)
+         AppendUser(fbOut, Arg);
+      else
+      {
+         long long llValue;
+         unsigned long long ullValue;
+         double dValue;
+         cKind = ResolveKind(cKind, Arg, llValue, ullValue, dValue);
+
+         //Characters and booleans asked for in another radix are written out as numbers.
+         bool bRadix = (Spec.m_cType == 'x' || Spec.m_cType == 'X' || Spec.m_cType == 'o' || Spec.m_cType == 'b');
+         if (bRadix && (cKind == 'c' || cKind == 'b'))
+            cKind = 'u';
+
+         switch (cKind)
+         {
+            case 'i':
+            case 'u':
+            {
+               bNumber = true;
+               bool bNegative = (cKind == 'i' && llValue < 0);
+               unPrefix = AppendSign(fbOut, bNegative, Spec.m_cSign);
+               if (bNegative)
+                  ullValue = 0ULL - ullValue;
+
+               if (!bRadix)
+               {
+                  AppendUnsigned(fbOut, ullValue);
+                  break;
+               }
+               if (Spec.m_bAlternate)
+               {
+                  fbOut.Append('0');
+                  unPrefix++;
+                  if (Spec.m_cType != 'o')
+                  {
+                     fbOut.Append(Spec.m_cType);
+                     unPrefix++;
+                  }
+               }
+               AppendRadix(fbOut, ullValue, Spec.m_cType);
+               break;
+            }
+            case 'f':
+            {
+               bNumber = true;
+               unPrefix = AppendFloat(fbOut, dValue, Spec);
+               break;
+            }
+            case 's':  //Precision is the most characters written.
+            {
+               if (!Arg.m_pString)
+                  fbOut.Append("(null)", 6);
+               else if (Spec.m_sPrecision >= 0 && static_cast<unsigned int>(Spec.m_sPrecision) < Arg.m_unLength)
+                  fbOut.Append(Arg.m_pString, static_cast<unsigned int>(Spec.m_sPrecision));
+               else
+                  fbOut.Append(Arg.m_pString, Arg.m_unLength);
+               break;
+            }
+            case 'p':
+            {
+               bNumber = true;
+               fbOut.Append("0x", 2);
+               unPrefix = 2;
+               AppendRadix(fbOut, reinterpret_cast<uintptr_t>(Arg.m_pPointer), (Spec.m_cType == 'X') ? 'X' : 'x');
+               break;
+            }
+            default:  //Characters and booleans have no options of their own.
+               AppendArg(fbOut, cKind, Arg);
+               break;
+         }
+      }
+
+      if (Spec.m_usWidth == 0)
+         return;
+      if (bNumber && Spec.m_bZero && !Spec.m_cAlign)
+      {
+         if (Spec.m_usWidth > unPrefix)
+            fbOut.Pad(unStart + unPrefix, Spec.m_usWidth - unPrefix, '0', '>');
+      }
+      else
+         fbOut.Pad(unStart, Spec.m_usWidth, Spec.m_cFill, Spec.m_cAlign ? Spec.m_cAlign : (bNumber ? '>' : '<'));
+   }
+
+   //Writes ullValue out in decimal so that it ends just before pEnd.
+   static void WriteDigits(char* pEnd, unsigned long long ullValue)
+   {
+      while (ullValue >= 100)
+      {
+         unsigned int unPair = static_cast<unsigned int>(ullValue % 100) * 2;
+         ullValue /= 100;
+         *--pEnd = s_cDigitPairs[unPair + 1];
+         *--pEnd = s_cDigitPairs[unPair];
+      }
+
+      if (ullValue >= 10)
+      {
+         unsigned int unPair = static_cast<unsigned int>(ullValue) * 2;
+         *--pEnd = s_cDigitPairs[unPair + 1];
+         *--pEnd = s_cDigitPairs[unPair];
+      }
+      else
+         *--pEnd = static_cast<char>('0' + ullValue);
+   }
+
+   //Number of decimal digits in ullValue.
+   static unsigned int CountDigits(unsigned long long ullValue)
+   {
+      unsigned int unDigits = 1;
+      for (;;)
+      {
+         if (ullValue < 10)
+            return unDigits;
+         if (ullValue < 100)
+            return unDigits + 1;
+         if (ullValue < 1000)
+            return unDigits + 2;
+         if (ullValue < 10000)
+            return unDigits + 3;
+         ullValue /= 10000;
+         unDigits += 4;
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  AppendSigned
+   //
+   // Purpose:  Writes out an integer in decimal.  The digits go straight into fbOut two at a time, no printf and
+   //           no temporaries unless fbOut is too full to take the longest possible number.
+   //
+   // In:  fbOut - Where the text is going.
+   //      llValue - The number.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFormatter::AppendSigned(CATFormatBuffer& fbOut, long long llValue)
+   {
+      if (llValue < 0)
+      {
+         fbOut.Append('-');
+         AppendUnsigned(fbOut, 0ULL - static_cast<unsigned long long>(llValue));
+      }
+      else
+         AppendUnsigned(fbOut, static_cast<unsigned long long>(llValue));
+   }
+
+   //Same as AppendSigned, for unsigned.
+   void CATFormatter::AppendUnsigned(CATFormatBuffer& fbOut, unsigned long long ullValue)
+   {
+      unsigned int unDigits = CountDigits(ullValue);
+      char* pOut = fbOut.Reserve(unDigits);
+      if (pOut)
+      {
+         WriteDigits(pOut + unDigits, ullValue);
+         fbOut.Commit(unDigits);
+         return;
+      }
+
+      //Not enough room for all of it, build it off to the side and write out what fits.
+      char cBuffer[NUMBER_SIZE];
+      WriteDigits(cBuffer + unDigits, ullValue);
+      fbOut.Append(cBuffer, unDigits);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  AppendDouble
+   //
+   // Purpose:  Writes out a floating point number with the fewest digits that still read back as the same
+   //           value, e.g. 0.1 is "0.1" and 1e20 is "1e+20" rather than "0.100000" and 21 digits.
+   //
+   // In:  fbOut - Where the text is going.
+   //      dValue - The number.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFormatter::AppendDouble(CATFormatBuffer& fbOut, double dValue)
+   {
+      char cBuffer[NUMBER_SIZE];
+      char* pOut = fbOut.Reserve(NUMBER_SIZE);
+      char* pFirst = pOut ? pOut : cBuffer;
+
+      std::to_chars_result Result = std::to_chars(pFirst, pFirst + NUMBER_SIZE, dValue);
+      unsigned int unLength = (Result.ec == std::errc()) ? static_cast<unsigned int>(Result.ptr - pFirst) : 0;
+      if (pOut)
+         fbOut.Commit(unLength);
+      else
+         fbOut.Append(cBuffer, unLength);
+   }
+
+   //Writes out a number in lower case hex, e.g. "0x7ffd1c2a" with bPrefix.
+   void CATFormatter::AppendHex(CATFormatBuffer& fbOut, unsigned long long ullValue, bool bPrefix)
+   {
+      unsigned int unDigits = 1;
+      for (unsigned long long ullRest = ullValue >> 4; ullRest; ullRest >>= 4)
+         unDigits++;
+
+      unsigned int unLength = unDigits + (bPrefix ? 2 : 0);
+      char cBuffer[NUMBER_SIZE];
+      char* pOut = fbOut.Reserve(unLength);
+      char* pFirst = pOut ? pOut : cBuffer;
+
+      if (bPrefix)
+      {
+         pFirst[0] = '0';
+         pFirst[1] = 'x';
+      }
+      for (char* pDigit = pFirst + unLength; pDigit != pFirst + unLength - unDigits; ullValue >>= 4)
+         *--pDigit = s_cHexDigits[ullValue & 0x0F];
+
+      if (pOut)
+         fbOut.Commit(unLength);
+      else
+         fbOut.Append(cBuffer, unLength);
+   }
+
+   //The date and time down to the second, kept around since most messages land in the same second as the last one.
+   struct SATTimestampCache
+   {
+      unsigned long long   m_ullSecond = ~0ULL;  //Second the prefix was built for.
+      char                 m_cPrefix[32] = {};  //"[MM/DD/YY HH:MM:SS"
+      unsigned int         m_unLength = 0;  //Length of m_cPrefix.
+   };
+
+   static thread_local SATTimestampCache s_tcCache;  //Each thread that outputs messages gets its own.
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  AppendTimestamp
+   //
+   // Purpose:  Writes out a time stamp as "[MM/DD/YY HH:MM:SS.ffffff] " in local time.  The date and time are only
+   //           rebuilt when the second changes, the fraction is written out every time.
+   //
+   // In:  fbOut - Where the text is going.
+   //      ullTimestamp - The time, nanoseconds since the epoch.
+   //      unDigits - Digits after the seconds (CATLogClock::ePrecision), 0 leaves the fraction off.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATFormatter::AppendTimestamp(CATFormatBuffer& fbOut, unsigned long long ullTimestamp, unsigned int unDigits)
+   {
+      unsigned long long ullSecond = ullTimestamp / 1000000000ULL;
+      if (ullSecond != s_tcCache.m_ullSecond)
+      {
+         time_t ttTime = static_cast<time_t>(ullSecond);
+         tm now_time = {};
+
+         #ifdef _WIN32
+            localtime_s(&now_time, &ttTime);
+         #else
+            localtime_r(&ttTime, &now_time);
+         #endif
+
+         s_tcCache.m_unLength = static_cast<unsigned int>(strftime(s_tcCache.m_cPrefix, sizeof(s_tcCache.m_cPrefix), "[%D %T", &now_time));
+         s_tcCache.m_ullSecond = ullSecond;
+      }
+      fbOut.Append(s_tcCache.m_cPrefix, s_tcCache.m_unLength);
+
+      if (unDigits > 9)
+         unDigits = 9;
+
+      //Write the fraction right to left, dropping the digits we aren't showing.
+      if (unDigits > 0)
+      {
+         char cFraction[10];
+         unsigned long long ullFraction = ullTimestamp % 1000000000ULL;
+         for (unsigned int i = unDigits; i < 9; i++)
+            ullFraction /= 10;
+
+         cFraction[0] = '.';
+         for (unsigned int i = unDigits; i > 0; i--)
+         {
+            cFraction[i] = static_cast<char>('0' + ullFraction % 10);
+            ullFraction /= 10;
+         }
+         fbOut.Append(cFraction, unDigits + 1);
+      }
+
+      fbOut.Append("] ", 2);
+   }
+}
@@ -0,0 +1,845 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogFormat.h
+//
+// Purpose: Type-safe formatting for the Logger.  Arguments are captured as tagged values whose types are known at compile
+//          time, string literal formats are checked against those types when the call is compiled, and messages are
+//          formatted straight into a caller supplied buffer.  Placeholders use the same {i}, {s}, {f}, ... tags as before.
+//          Named fields, kv("ms", dt), can follow the arguments.  They ride along with the message as typed values for
+//          structured outputs (see ATLogJson.h) and are tacked onto the end of the text as " ms=16.6".
+//          Numbers are written without printf or allocations, {f} with the fewest digits that read back the same value
+//          and {p} in lower case hex.
+//          A placeholder can take options after a colon, std::format style: [[fill]align][sign][#][0][width][.precision]
+//          [type].  {f:.3} gives three decimals, {i:08x} eight hex digits padded with zeros, {s:<20} a string padded out to
+//          20 characters, {s:.8} at most 8 of its characters.  Types are d, x, X, o and b for integers and e, f and g (or
+//          upper case) for floating point, types that don't apply to the value are ignored.
+//          Engine types can be given a placeholder of their own that writes them straight into the message, no string
+//          temporaries needed:
+//
+//             static void FormatVec3(Atlas::CATFormatBuffer& fbOut, const Vec3& vPos) { ... }
+//             AT_LOG_FORMATTER(Vec3, "v3", FormatVec3)
+//
+//             AT_LOG_INFO("Player moved to {v3}", vPos);
+//
+//          The value is copied along with the message (it has to be trivially copyable and at most AT_LOG_USER_SIZE
+//          bytes) and only formatted when the message is written out.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "CString.h"
+
+//Size a thread's line buffer (see CATLineBuffer) starts out at, message and time stamp included.  Lines that don't fit
+//grow it, up to AT_LOG_LINE_MAX.
+#ifndef AT_LOG_LINE_SIZE
+#define AT_LOG_LINE_SIZE 1024
+#endif
+
+//Longest line a thread's line buffer will grow to, anything longer is truncated.
+#ifndef AT_LOG_LINE_MAX
+#define AT_LOG_LINE_MAX 65536
+#endif
+
+//What the end of a message or string argument that had to be cut short is replaced with.
+#ifndef AT_LOG_TRUNCATED
+#define AT_LOG_TRUNCATED "...[truncated]"
+#endif
+
+//Most arguments a single message can take.
+#ifndef AT_LOG_MAX_ARGS
+#define AT_LOG_MAX_ARGS 32
+#endif
+
+//Most types that can be given their own placeholder, see AT_LOG_FORMATTER.
+#ifndef AT_LOG_MAX_FORMATTERS
+#define AT_LOG_MAX_FORMATTERS 64
+#endif
+
+//Biggest type that can be given its own placeholder, its value is copied into the message.
+#ifndef AT_LOG_USER_SIZE
+#define AT_LOG_USER_SIZE 128
+#endif
+
+//Longest placeholder tag a type can be given.
+#define AT_LOG_FORMATTER_TAG 16
+
+//Widest a placeholder can be padded out to, e.g. {s:<20}.
+#define AT_LOG_MAX_WIDTH 255
+
+//Most digits a placeholder's precision can ask for, e.g. {f:.3}.
+#define AT_LOG_MAX_PRECISION 99
+
+namespace Atlas
+{
+   //The kinds of values a placeholder can be filled with.
+   //ARG_KEY is never a value, it marks the name of a field in encoded arguments (see CATLogBinary::EncodeArgs).
+   //ARG_USER is a type with its own formatter (see AT_LOG_FORMATTER), kept as its raw bytes.
+   enum eArgType {ARG_NONE = 0, ARG_SIGNED, ARG_UNSIGNED, ARG_FLOAT, ARG_CHAR, ARG_BOOL, ARG_STRING, ARG_POINTER, ARG_KEY, ARG_USER};
+
+   //A single argument captured for formatting.
+   struct SATFormatArg
+   {
+      unsigned char           m_ucType;  //eArgType of the value.
+      unsigned char           m_ucKeyLength;  //Length of m_pKey.
+      unsigned short          m_usFormatter;  //CATTypeFormatters id, ARG_USER only.  0 if it has none in this program.
+      unsigned int            m_unLength;  //Length of m_pString, or of the bytes m_pPointer points at for ARG_USER.
+      union
+      {
+         long long            m_llValue;
+         unsigned long long   m_ullValue;
+         double               m_dValue;
+         char                 m_cValue;
+         bool                 m_bValue;
+         const char*          m_pString;
+         const void*          m_pPointer;
+      };
+      const char*             m_pKey;  //Name of the field, 0 for a plain argument.  Not null terminated.
+   };
+
+   //A named value logged alongside a message, see kv.
+   template <typename T>
+   struct CATLogField
+   {
+      const char*    m_pKey;  //Name of the field, at most 255 characters are kept.
+      const T&       m_Value;  //Only has to live as long as the call it's passed to.
+   };
+
+   //Names a value to be logged as a field, e.g. info("frame done", kv("ms", dt), kv("entities", n)).
+   template <typename T>
+   inline CATLogField<T> kv(const char* pKey, const T& Value) { return CATLogField<T>{pKey, Value}; }
+
+   class CATFormatBuffer;
+
+   //Writes out a value of a type with its own placeholder.  pValue points at a copy of the value, suitably aligned.
+   typedef void (*ATLogFormatFn)(CATFormatBuffer& fbOut, const void* pValue);
+
+   //A type's placeholder and how to write it out.
+   struct SATTypeFormatter
+   {
+      char           m_cTag[AT_LOG_FORMATTER_TAG];  //Placeholder tag e.g. "v3", null terminated.
+      unsigned int   m_unTagLength;  //Length of m_cTag.
+      unsigned int   m_unSize;  //Size of the type's values.
+      ATLogFormatFn  m_pfnFormat;
+   };
+
+   //Keeps the formatters for types with their own placeholder.  Lookups are lock-free, only registering takes a lock.
+   //Ids start at 1, 0 means no formatter.
+   class CATTypeFormatters
+   {
+      private:
+         static SATTypeFormatter          m_aFormatters[AT_LOG_MAX_FORMATTERS];  //Id n lives at n - 1.
+         static std::atomic<unsigned int> m_unCount;  //Number of formatters registered.
+
+      public:
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Register
+         //
+         // Purpose:  Binds a placeholder tag to a formatter.  AT_LOG_FORMATTER types register themselves the first
+         //           time they're logged, tools decoding files written by a program (e.g. ATLogDecode) can register
+         //           that program's formatters by hand to get its values back out as text.  A tag that's already taken
+         //           keeps its first formatter.
+         //
+         // In:  pTag - Placeholder tag, letters and digits, shorter than AT_LOG_FORMATTER_TAG.
+         //      unSize - Size of the type's values.
+         //      pfnFormat - Writes a value out.
+         //
+         // Out:  The tag's id, 0 if the tag is no good or there's no room left.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned short Register(const char* pTag, unsigned int unSize, ATLogFormatFn pfnFormat);
+
+         static unsigned short Find(const char* pTag, unsigned int unLength);  //Id of a tag, 0 if it hasn't been registered.
+
+         //The formatter with id usId, 0 if there isn't one.
+         static const SATTypeFormatter* Get(unsigned short usId)
+         {
+            return (usId > 0 && usId <= m_unCount.load(std::memory_order_acquire)) ? &m_aFormatters[usId - 1] : 0;
+         }
+   };
+
+   //Gives a type its own placeholder, specialized by AT_LOG_FORMATTER.  Types without one have no tag.
+   template <typename T>
+   struct CATLogFormatter
+   {
+      static constexpr const char* m_pTag = 0;
+   };
+
+   //Maps a C++ type onto the eArgType it's captured as, ARG_NONE means it can't be logged.
+   template <typename T>
+   struct CATArgType
+   {
+      static constexpr unsigned char value =
+         CATLogFormatter<T>::m_pTag ? ARG_USER :
+         std::is_same<T, bool>::value ? ARG_BOOL :
+         std::is_same<T, char>::value ? ARG_CHAR :
+         (std::is_integral<T>::value && std::is_signed<T>::value) ? ARG_SIGNED :
+         std::is_integral<T>::value ? ARG_UNSIGNED :
+         std::is_enum<T>::value ? ARG_SIGNED :
+         std::is_floating_point<T>::value ? ARG_FLOAT :
+         (std::is_same<T, const char*>::value || std::is_same<T, char*>::value) ? ARG_STRING :
+         (std::is_same<T, CString>::value || std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value) ? ARG_STRING :
+         (std::is_pointer<T>::value || std::is_null_pointer<T>::value) ? ARG_POINTER :
+         ARG_NONE;
+   };
+
+   //Fields are ARG_KEY as far as format checking goes, as long as their value can be logged.
+   template <typename T>
+   struct CATArgType<CATLogField<T>>
+   {
+      static constexpr unsigned char value = (CATArgType<typename std::decay<T>::type>::value != ARG_NONE) ? ARG_KEY : ARG_NONE;
+   };
+
+   //The placeholder tag of a type with its own formatter, 0 for everything else.
+   template <typename T>
+   struct CATArgTag
+   {
+      static constexpr const char* value = CATLogFormatter<T>::m_pTag;
+   };
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  MakeFormatArg
+   //
+   // Purpose:  Captures a value so it can be pressed into a message.  Strings are referenced, not copied.
+   //
+   // In:  Value - The value to capture.
+   //
+   // Out:  The captured argument.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   template <typename T>
+   inline SATFormatArg MakeFormatArg(const T& Value)
+   {
+      typedef typename std::decay<T>::type tType;
+      constexpr unsigned char ucType = CATArgType<tType>::value;
+      static_assert(ucType != ARG_NONE, "This type can't be logged, see CATArgType in ATLogFormat.h.");
+
+      SATFormatArg Arg;
+      Arg.m_ucType = ucType;
+      Arg.m_ucKeyLength = 0;
+      Arg.m_usFormatter = 0;
+      Arg.m_unLength = 0;
+      Arg.m_pKey = 0;
+
+      if constexpr (ucType == ARG_USER)
+      {
+         static_assert(std::is_trivially_copyable<tType>::value, "Types with their own placeholder have to be trivially copyable.");
+         static_assert(sizeof(tType) <= AT_LOG_USER_SIZE, "Type is too big for its own placeholder, see AT_LOG_USER_SIZE.");
+
+         static const unsigned short s_usFormatter = CATTypeFormatters::Register(CATLogFormatter<tType>::m_pTag, sizeof(tType),
+            CATLogFormatter<tType>::Format);
+         Arg.m_usFormatter = s_usFormatter;
+         Arg.m_pPointer = &Value;
+         Arg.m_unLength = sizeof(tType);
+      }
+      else if constexpr (ucType == ARG_SIGNED)
+         Arg.m_llValue = static_cast<long long>(Value);
+      else if constexpr (ucType == ARG_UNSIGNED)
+         Arg.m_ullValue = static_cast<unsigned long long>(Value);
+      else if constexpr (ucType == ARG_FLOAT)
+         Arg.m_dValue = static_cast<double>(Value);
+      else if constexpr (ucType == ARG_CHAR)
+         Arg.m_cValue = Value;
+      else if constexpr (ucType == ARG_BOOL)
+         Arg.m_bValue = Value;
+      else if constexpr (std::is_same<tType, CString>::value)
+      {
+         Arg.m_pString = Value.getCstr();
+         Arg.m_unLength = static_cast<unsigned int>(Value.Length());
+      }
+      else if constexpr (std::is_same<tType, std::string>::value || std::is_same<tType, std::string_view>::value)
+      {
+         Arg.m_pString = Value.data();
+         Arg.m_unLength = static_cast<unsigned int>(Value.size());
+      }
+      else if constexpr (ucType == ARG_STRING)
+      {
+         const char* pValue = Value;
+         Arg.m_pString = pValue;
+         Arg.m_unLength = pValue ? static_cast<unsigned int>(strlen(pValue)) : 0;
+      }
+      else
+         Arg.m_pPointer = Value;
+
+      return Arg;
+   }
+
+   //Captures a field, its value the same as any other argument.
+   template <typename T>
+   inline SATFormatArg MakeFormatArg(const CATLogField<T>& Field)
+   {
+      SATFormatArg Arg = MakeFormatArg(Field.m_Value);
+      if (Field.m_pKey)
+      {
+         size_t unLength = strlen(Field.m_pKey);
+         Arg.m_pKey = Field.m_pKey;
+         Arg.m_ucKeyLength = static_cast<unsigned char>((unLength < 255) ? unLength : 255);
+      }
+      return Arg;
+   }
+
+   //A fixed size, truncating output buffer that messages get formatted into.
+   class CATFormatBuffer
+   {
+      private:
+         char*          m_pData;  //Where the message is going.
+         unsigned int   m_unCapacity;  //Size of m_pData, one byte is always kept back for the null terminator.
+         unsigned int   m_unLength;  //Number of characters written so far.
+         bool           m_bTruncated;  //Has anything been left out for lack of room?
+
+      public:
+         CATFormatBuffer(char* pData, unsigned int unCapacity) : m_pData(pData), m_unCapacity(unCapacity), m_unLength(0), m_bTruncated(false) {}
+
+         //Appends as much of pText as will fit.
+         void Append(const char* pText, unsigned int unLength)
+         {
+            unsigned int unRoom = m_unCapacity - 1 - m_unLength;
+            if (unLength > unRoom)
+            {
+               unLength = unRoom;
+               m_bTruncated = true;
+            }
+            memcpy(m_pData + m_unLength, pText, unLength);
+            m_unLength += unLength;
+         }
+
+         //Appends a single character if there's room.
+         void Append(char cValue)
+         {
+            if (m_unLength + 1 < m_unCapacity)
+               m_pData[m_unLength++] = cValue;
+            else
+               m_bTruncated = true;
+         }
+
+         //Where the next unLength characters go if they all fit, 0 if they don't.  Follow up with Commit.
+         char* Reserve(unsigned int unLength) { return (unLength <= m_unCapacity - 1 - m_unLength) ? m_pData + m_unLength : 0; }
+
+         //Counts unLength characters written to the space handed out by Reserve.
+         void Commit(unsigned int unLength) { m_unLength += unLength; }
+
+         //Null terminates the message and returns it.
+         const char* Terminate() { m_pData[m_unLength] = '\0'; return m_pData; }
+
+         char* Data() { return m_pData; }
+         unsigned int Length() const { return m_unLength; }
+         unsigned int Remaining() const { return m_unCapacity - 1 - m_unLength; }
+
+         //Pads what's been written since unStart out to unWidth characters with cFill, cAlign ('<', '>' or '^') saying
+         //which side of the padding the text goes on.
+         void Pad(unsigned int unStart, unsigned int unWidth, char cFill, char cAlign)
+         {
+            unsigned int unWritten = m_unLength - unStart;
+            if (unWritten >= unWidth)
+               return;
+
+            unsigned int unPad = unWidth - unWritten;
+            if (unPad > Remaining())
+            {
+               unPad = Remaining();
+               m_bTruncated = true;
+            }
+
+            unsigned int unBefore = (cAlign == '>') ? unPad : ((cAlign == '^') ? unPad / 2 : 0);
+            memmove(m_pData + unStart + unBefore, m_pData + unStart, unWritten);
+            memset(m_pData + unStart, cFill, unBefore);
+            memset(m_pData + unStart + unBefore + unWritten, cFill, unPad - unBefore);
+            m_unLength += unPad;
+         }
+
+         //Was anything left out for lack of room?  Writers that stop short on their own (e.g. CATLogJson) call SetTruncated.
+         bool IsTruncated() const { return m_bTruncated; }
+         void SetTruncated() { m_bTruncated = true; }
+
+         //Ends the text with AT_LOG_TRUNCATED, writing over the end of it if there's no room left.
+         void MarkTruncated()
+         {
+            const unsigned int unMarker = sizeof(AT_LOG_TRUNCATED) - 1;
+            if (m_unCapacity <= unMarker)
+               return;
+            if (Remaining() < unMarker)
+               m_unLength = m_unCapacity - 1 - unMarker;
+            memcpy(m_pData + m_unLength, AT_LOG_TRUNCATED, unMarker);
+            m_unLength += unMarker;
+            m_bTruncated = true;
+         }
+   };
+
+   //A buffer a thread builds its lines in.  It's kept from one line to the next and only grows when a line doesn't fit,
+   //so once it's big enough for the longest line the thread writes, building a line allocates nothing.  Keep one as a
+   //static thread_local and build each line with (Reserve being optional, it just saves building a long line twice):
+   //
+   //   s_lbLine.Reserve(unExpected);
+   //   CATFormatBuffer fbLine = s_lbLine.Begin();
+   //   BuildLine(fbLine);
+   //   while (s_lbLine.Grow(fbLine))
+   //   {
+   //      fbLine = s_lbLine.Begin();
+   //      BuildLine(fbLine);
+   //   }
+   class CATLineBuffer
+   {
+      private:
+         char*          m_pData;  //The buffer, 0 until the first line.
+         unsigned int   m_unCapacity;  //Size of m_pData.
+
+         CATLineBuffer(const CATLineBuffer&);  //Copy Constructor
+         CATLineBuffer& operator=(const CATLineBuffer&);  //Assignment Operator
+
+      public:
+         CATLineBuffer() : m_pData(0), m_unCapacity(0) {}  //Constructor
+         ~CATLineBuffer() { delete[] m_pData; }  //Destructor
+
+         //Starts a new line with the whole buffer to write it in.
+         CATFormatBuffer Begin()
+         {
+            if (!m_pData)
+            {
+               m_unCapacity = AT_LOG_LINE_SIZE;
+               m_pData = new char[m_unCapacity];
+            }
+            return CATFormatBuffer(m_pData, m_unCapacity);
+         }
+
+         //Makes sure the next Begin has room for at least unLength characters (up to AT_LOG_LINE_MAX), doubling
+         //the buffer until it does.
+         void Reserve(unsigned int unLength)
+         {
+            if (unLength <= m_unCapacity || (m_pData && m_unCapacity >= AT_LOG_LINE_MAX))
+               return;
+
+            unsigned int unCapacity = m_unCapacity ? m_unCapacity : AT_LOG_LINE_SIZE;
+            while (unCapacity < unLength && unCapacity < AT_LOG_LINE_MAX)
+               unCapacity = (unCapacity * 2 < AT_LOG_LINE_MAX) ? unCapacity * 2 : AT_LOG_LINE_MAX;
+            if (unCapacity <= m_unCapacity)
+               return;
+
+            char* pData = new char[unCapacity];
+            delete[] m_pData;
+            m_pData = pData;
+            m_unCapacity = unCapacity;
+         }
+
+         //Doubles the buffer if fbLine (from Begin) was cut short, up to AT_LOG_LINE_MAX.  Returns true if it grew
+         //and the line should be built again.
+         bool Grow(const CATFormatBuffer& fbLine)
+         {
+            if (!fbLine.IsTruncated() || m_unCapacity >= AT_LOG_LINE_MAX)
+               return false;
+
+            unsigned int unCapacity = (m_unCapacity * 2 < AT_LOG_LINE_MAX) ? m_unCapacity * 2 : AT_LOG_LINE_MAX;
+            char* pData = new char[unCapacity];
+            delete[] m_pData;
+            m_pData = pData;
+            m_unCapacity = unCapacity;
+            return true;
+         }
+   };
+
+   //Never defined, calling one from Validate is how a bad string literal format turns into a compile error.
+   void AT_FORMAT_ERROR_too_few_arguments();
+   void AT_FORMAT_ERROR_too_many_arguments();
+   void AT_FORMAT_ERROR_argument_does_not_match_placeholder();
+   void AT_FORMAT_ERROR_unknown_placeholder();
+   void AT_FORMAT_ERROR_unterminated_placeholder();
+   void AT_FORMAT_ERROR_argument_after_field();
+   void AT_FORMAT_ERROR_bad_format_spec();
+
+   //The options after the colon in a placeholder, e.g. {f:.3}.  See CATFormatter::ParseSpec.
+   struct SATFormatSpec
+   {
+      unsigned short m_usWidth = 0;  //Least characters written, 0 for no padding.
+      short          m_sPrecision = -1;  //Digits after the point for floating point, most characters for strings, -1 for none.
+      char           m_cFill = ' ';  //What the padding is made of.
+      char           m_cAlign = 0;  //'<', '>' or '^', 0 for the default (numbers on the right, everything else on the left).
+      char           m_cSign = 0;  //'+' or ' ' to put that in front of positive numbers, 0 for nothing.
+      char           m_cType = 0;  //'x', 'X', 'o' or 'b' for integers, 'e', 'f', 'g' (or upper case) for floating point, 0 for none.
+      bool           m_bAlternate = false;  //Put 0x, 0b or 0 in front of integers written in another radix?
+      bool           m_bZero = false;  //Pad numbers with zeros after their sign, unless there's an alignment.
+   };
+
+   //A piece of a compiled format, either literal text or a placeholder.
+   struct SATFormatSegment
+   {
+      const char*    m_pText;  //The literal text, or the whole placeholder braces and all.
+      unsigned int   m_unLength;  //Length of m_pText.
+      bool           m_bPlaceholder;  //Is it a placeholder?
+      char           m_cKind;  //What the placeholder asks for, see CATFormatter::TagKind.
+      bool           m_bSpec;  //Does the placeholder have options?
+      SATFormatSpec  m_Spec;  //The options, parsed.
+   };
+
+   //A format broken up once into literal text and placeholders, so formatting it again is just copying the text and
+   //writing out the arguments.  See CATFormatter::Compile.
+   struct SATFormatTemplate
+   {
+      const char*          m_pFormat;  //The format it was compiled from.
+      SATFormatSegment*    m_pSegments;  //The pieces, in order.
+      unsigned int         m_unSegments;  //Number of pieces.
+      unsigned int         m_unPlaceholders;  //Number of those that are placeholders.
+      unsigned int         m_unLiteralLength;  //Length of all the literal text put together, the least the message takes.
+   };
+
+   class CATFormatter
+   {
+      public:
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  TokenAccepts
+         //
+         // Purpose:  Checks whether a placeholder tag can be filled with a given type of value.
+         //
+         // In:  pToken - The tag between the braces e.g. "ll".
+         //      unLength - Length of the tag.
+         //      ucType - eArgType of the value.
+         //      bKnown - Set to false if the tag isn't one we know about.
+         //
+         // Out:  true if the value can be used for the tag.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static constexpr bool TokenAccepts(const char* pToken, unsigned int unLength, unsigned char ucType, bool& bKnown)
+         {
+            bool bInteger = (ucType == ARG_SIGNED || ucType == ARG_UNSIGNED);
+            bKnown = true;
+
+            if (unLength == 1)
+            {
+               switch (pToken[0])
+               {
+                  case 'i': case 'u': case 'l': return bInteger || ucType == ARG_CHAR;
+                  case 'f': case 'd': return bInteger || ucType == ARG_FLOAT;
+                  case 'c': return bInteger || ucType == ARG_CHAR;
+                  case 's': return ucType == ARG_STRING;
+                  case 'p': return ucType == ARG_POINTER || ucType == ARG_STRING;
+                  case 'b': return bInteger || ucType == ARG_BOOL;
+               }
+            }
+            else if (pToken[0] == 'l' && ((unLength == 2 && (pToken[1] == 'l' || pToken[1] == 'u'))
+               || (unLength == 3 && pToken[1] == 'l' && pToken[2] == 'u')))
+               return bInteger || ucType == ARG_CHAR;
+
+            bKnown = false;
+            return false;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  ParseSpec
+         //
+         // Purpose:  Reads the options after the colon in a placeholder, [[fill]align][sign][#][0][width][.precision]
+         //           [type].  Runs at compile time for string literal formats and once per format when it's compiled.
+         //
+         // In:  pSpec - The options e.g. "08x".
+         //      unLength - Length of the options.
+         //      Spec - Receives the options.
+         //
+         // Out:  false if the options can't be read.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static constexpr bool ParseSpec(const char* pSpec, unsigned int unLength, SATFormatSpec& Spec)
+         {
+            Spec = SATFormatSpec();
+            unsigned int i = 0;
+
+            if (unLength >= 2 && (pSpec[1] == '<' || pSpec[1] == '>' || pSpec[1] == '^'))
+            {
+               Spec.m_cFill = pSpec[0];
+               Spec.m_cAlign = pSpec[1];
+               i = 2;
+            }
+            else if (unLength >= 1 && (pSpec[0] == '<' || pSpec[0] == '>' || pSpec[0] == '^'))
+               Spec.m_cAlign = pSpec[i++];
+
+            if (i < unLength && (pSpec[i] == '+' || pSpec[i] == ' ' || pSpec[i] == '-'))
+            {
+               Spec.m_cSign = (pSpec[i] == '-') ? 0 : pSpec[i];
+               i++;
+            }
+            if (i < unLength && pSpec[i] == '#')
+            {
+               Spec.m_bAlternate = true;
+               i++;
+            }
+            if (i < unLength && pSpec[i] == '0')
+            {
+               Spec.m_bZero = true;
+               i++;
+            }
+
+            for (; i < unLength && pSpec[i] >= '0' && pSpec[i] <= '9'; i++)
+            {
+               Spec.m_usWidth = static_cast<unsigned short>(Spec.m_usWidth * 10 + (pSpec[i] - '0'));
+               if (Spec.m_usWidth > AT_LOG_MAX_WIDTH)
+                  return false;
+            }
+
+            if (i < unLength && pSpec[i] == '.')
+            {
+               if (++i == unLength || pSpec[i] < '0' || pSpec[i] > '9')
+                  return false;
+               for (Spec.m_sPrecision = 0; i < unLength && pSpec[i] >= '0' && pSpec[i] <= '9'; i++)
+               {
+                  Spec.m_sPrecision = static_cast<short>(Spec.m_sPrecision * 10 + (pSpec[i] - '0'));
+                  if (Spec.m_sPrecision > AT_LOG_MAX_PRECISION)
+                     return false;
+               }
+            }
+
+            if (i < unLength)
+            {
+               switch (pSpec[i])
+               {
+                  case 'd':  //Decimal, same as no type at all.
+                     i++;
+                     break;
+                  case 'x': case 'X': case 'o': case 'b':
+                  case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+                     Spec.m_cType = pSpec[i++];
+                     break;
+               }
+            }
+            return i == unLength;
+         }
+
+         //Length of the tag part of a placeholder, everything before the colon.
+         static constexpr unsigned int TagLength(const char* pToken, unsigned int unLength)
+         {
+            unsigned int i = 0;
+            while (i < unLength && pToken[i] != ':')
+               i++;
+            return i;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Validate
+         //
+         // Purpose:  Walks a string literal format at compile time making sure every placeholder has an argument of a
+         //           type it can use, and that every argument has a placeholder.  Fields don't fill placeholders and
+         //           have to come after the arguments.  Types with their own placeholder only fill their own tag.
+         //
+         // In:  pFormat - The format e.g. "There are {i} items in array."
+         //      pTypes - eArgType of each argument.
+         //      pTags - Placeholder tag of each ARG_USER argument (see CATArgTag).
+         //      unArgCount - Number of arguments.
+         //
+         // Out:  None, a mismatch fails to compile.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static constexpr void Validate(const char* pFormat, const unsigned char* pTypes, const char* const* pTags, unsigned int unArgCount)
+         {
+            //Everything from the first field on has to be a field.
+            for (unsigned int i = 0; i < unArgCount; i++)
+            {
+               if (pTypes[i] != ARG_KEY)
+                  continue;
+               for (unsigned int j = i + 1; j < unArgCount; j++)
+                  if (pTypes[j] != ARG_KEY)
+                     AT_FORMAT_ERROR_argument_after_field();
+               unArgCount = i;
+               break;
+            }
+
+            unsigned int unArg = 0;
+            for (unsigned int i = 0; pFormat[i] != '\0'; i++)
+            {
+               if (pFormat[i] != '{')
+                  continue;
+
+               //Find end of tag.
+               unsigned int j = i + 1;
+               while (pFormat[j] != '}' && pFormat[j] != '\0')
+                  j++;
+               if (pFormat[j] == '\0')
+                  AT_FORMAT_ERROR_unterminated_placeholder();
+
+               if (unArg >= unArgCount)
+                  AT_FORMAT_ERROR_too_few_arguments();
+
+               //Options after the colon, if any.
+               unsigned int unTag = TagLength(pFormat + i + 1, j - i - 1);
+               SATFormatSpec Spec;
+               if (unTag < j - i - 1 && !ParseSpec(pFormat + i + 2 + unTag, j - i - 2 - unTag, Spec))
+                  AT_FORMAT_ERROR_bad_format_spec();
+
+               bool bKnown = true;
+               if (pTypes[unArg] == ARG_USER)
+               {
+                  const char* pTag = pTags[unArg];
+                  unsigned int k = 0;
+                  while (k < unTag && pTag[k] == pFormat[i + 1 + k])
+                     k++;
+                  if (k != unTag || pTag[k] != '\0')
+                     AT_FORMAT_ERROR_argument_does_not_match_placeholder();
+               }
+               else if (!TokenAccepts(pFormat + i + 1, unTag, pTypes[unArg], bKnown))
+               {
+                  if (!bKnown)
+                     AT_FORMAT_ERROR_unknown_placeholder();
+                  AT_FORMAT_ERROR_argument_does_not_match_placeholder();
+               }
+
+               unArg++;
+               i = j;
+            }
+
+            if (unArg != unArgCount)
+               AT_FORMAT_ERROR_too_many_arguments();
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  BuildMessage
+         //
+         // Purpose:  Presses the arguments into the format, writing the result straight into fbOut.  A placeholder with
+         //           no argument left for it is written out as is.  Fields are skipped, see AppendFields.
+         //
+         // In:  fbOut - Where the message is going.
+         //      pFormat - The message being outputted e.g. "Hello there {f}!"
+         //      pArgs - The values to press into pFormat.
+         //      unArgCount - Number of values in pArgs.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void BuildMessage(CATFormatBuffer& fbOut, const char* pFormat, const SATFormatArg* pArgs, unsigned int unArgCount);
+
+         //Same as above with a format compiled ahead of time, nothing gets scanned.
+         static void BuildMessage(CATFormatBuffer& fbOut, const SATFormatTemplate& Template, const SATFormatArg* pArgs, unsigned int unArgCount);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Compile
+         //
+         // Purpose:  Breaks a format up into literal text and placeholders the same way BuildMessage reads it, with
+         //           each placeholder's tag already worked out.  The template points into pFormat rather than copying it.
+         //
+         // In:  pFormat - The format, has to stay around as long as the template does.
+         //
+         // Out:  The template, to be freed with Free.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static SATFormatTemplate* Compile(const char* pFormat);
+
+         static void Free(SATFormatTemplate* pTemplate);  //Frees a template made by Compile.
+
+         //Writes out the fields among pArgs as " key=value", each value the way its own type prints.
+         static void AppendFields(CATFormatBuffer& fbOut, const SATFormatArg* pArgs, unsigned int unArgCount);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  ProcessToken
+         //
+         // Purpose:  String-afies a single argument the way its placeholder tag and options ask for.  Options that can't
+         //           be read are ignored.
+         //
+         // In:  fbOut - Where the text is going.
+         //      pToken - Everything between the braces e.g. "ll" or "f:.3".
+         //      unLength - Length of pToken.
+         //      Arg - The value to be written out.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void ProcessToken(CATFormatBuffer& fbOut, const char* pToken, unsigned int unLength, const SATFormatArg& Arg);
+
+         //What a placeholder tag asks for, 'i', 'u', 'f', 'c', 's', 'p' or 'b', 0 for a tag we don't know.
+         static char TagKind(const char* pToken, unsigned int unLength);
+
+         //Writes out an argument as cKind (from TagKind), or as whatever its own type is if it can't be one.
+         static void AppendArg(CATFormatBuffer& fbOut, char cKind, const SATFormatArg& Arg);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  AppendArg
+         //
+         // Purpose:  Same as above, applying a placeholder's options.  Everything is still written straight into
+         //           fbOut and then padded in place, types with their own placeholder get padded the same way.
+         //
+         // In:  fbOut - Where the text is going.
+         //      cKind - What the placeholder asks for, see TagKind.
+         //      Spec - The placeholder's options.
+         //      Arg - The value to be written out.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void AppendArg(CATFormatBuffer& fbOut, char cKind, const SATFormatSpec& Spec, const SATFormatArg& Arg);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  AppendSigned
+         //
+         // Purpose:  Writes out an integer in decimal.  The digits go straight into fbOut two at a time, no printf and
+         //           no temporaries unless fbOut is too full to take the longest possible number.
+         //
+         // In:  fbOut - Where the text is going.
+         //      llValue - The number.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void AppendSigned(CATFormatBuffer& fbOut, long long llValue);
+
+         static void AppendUnsigned(CATFormatBuffer& fbOut, unsigned long long ullValue);  //Same as AppendSigned, for unsigned.
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  AppendDouble
+         //
+         // Purpose:  Writes out a floating point number with the fewest digits that still read back as the same
+         //           value, e.g. 0.1 is "0.1" and 1e20 is "1e+20" rather than "0.100000" and 21 digits.
+         //
+         // In:  fbOut - Where the text is going.
+         //      dValue - The number.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void AppendDouble(CATFormatBuffer& fbOut, double dValue);
+
+         //Writes out a number in lower case hex, e.g. "0x7ffd1c2a" with bPrefix.
+         static void AppendHex(CATFormatBuffer& fbOut, unsigned long long ullValue, bool bPrefix);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  AppendTimestamp
+         //
+         // Purpose:  Writes out a time stamp as "[MM/DD/YY HH:MM:SS.ffffff] " in local time.  The date and time are only
+         //           rebuilt when the second changes, the fraction is written out every time.
+         //
+         // In:  fbOut - Where the text is going.
+         //      ullTimestamp - The time, nanoseconds since the epoch.
+         //      unDigits - Digits after the seconds (CATLogClock::ePrecision), 0 leaves the fraction off.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void AppendTimestamp(CATFormatBuffer& fbOut, unsigned long long ullTimestamp, unsigned int unDigits);
+   };
+
+   //A format string along with the types of the arguments going into it.  String literals are checked when the call is
+   //compiled, a CString or char pointer format is taken as is and checked as it's formatted.
+   template <typename... Args>
+   class CATFormatString
+   {
+      private:
+         const char*    m_pFormat;
+         bool           m_bLiteral;  //Is m_pFormat a string literal that will be around for the life of the program?
+
+      public:
+         template <size_t N>
+         consteval CATFormatString(const char (&szFormat)[N]) : m_pFormat(szFormat), m_bLiteral(true)
+         {
+            static_assert(sizeof...(Args) <= AT_LOG_MAX_ARGS, "Too many arguments for a single message, see AT_LOG_MAX_ARGS.");
+
+            constexpr unsigned char aTypes[] = {CATArgType<typename std::decay<Args>::type>::value..., ARG_NONE};
+            constexpr const char* aTags[] = {CATArgTag<typename std::decay<Args>::type>::value..., 0};
+            CATFormatter::Validate(szFormat, aTypes, aTags, sizeof...(Args));
+         }
+
+         CATFormatString(const CString& sFormat) : m_pFormat(sFormat.getCstr()), m_bLiteral(false) {}
+
+         //A format only known at run time, e.g. a const char* variable or a char buffer.  Literals still take the
+         //checked constructor above.
+         template <typename T>
+            requires (std::is_same_v<std::remove_cvref_t<T>, const char*> || std::is_same_v<std::decay_t<T>, char*>)
+         CATFormatString(T&& pFormat) : m_pFormat(pFormat), m_bLiteral(false) {}
+
+         const char* Get() const { return m_pFormat ? m_pFormat : ""; }
+         bool IsLiteral() const { return m_bLiteral; }
+   };
+}
+
+//Gives type its own placeholder, {tag}, written out by function (void function(Atlas::CATFormatBuffer&, const type&)).
+//Use at global scope after type and function have been declared, e.g. AT_LOG_FORMATTER(Vec3, "v3", FormatVec3).
+#define AT_LOG_FORMATTER(type, tag, function) \
+   template <> \
+   struct Atlas::CATLogFormatter<type> \
+   { \
+      static constexpr const char* m_pTag = tag; \
+      static void Format(::Atlas::CATFormatBuffer& fbOut, const void* pValue) { function(fbOut, *static_cast<const type*>(pValue)); } \
+   };
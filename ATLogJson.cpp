@@ -0,0 +1,308 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogJson.cpp
+//
+// Purpose: Writes records out as JSON Lines.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogJson.h"
+#include "ATLogBinary.h"
+#include "ATLogChannel.h"
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+
+//Bytes kept back at the end of the line for closing off the string and object being written.
+#define JSON_RESERVE 4
+
+namespace Atlas
+{
+   //Names the levels go by in the "level" member, indexed by eLevel.
+   static const char* const s_apLevelNames[] = {"error", "warn", "trace", "info"};
+
+   //The UTC date and time down to the second, kept around since most messages land in the same second as the last one.
+   struct SATJsonTimeCache
+   {
+      unsigned long long   m_ullSecond = ~0ULL;  //Second the prefix was built for.
+      char                 m_cPrefix[32] = {};  //"YYYY-MM-DDTHH:MM:SS"
+      unsigned int         m_unLength = 0;  //Length of m_cPrefix.
+   };
+
+   static thread_local SATJsonTimeCache s_jtcCache;  //Each thread that outputs messages gets its own.
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Formatter
+   //
+   // Purpose:  A sink formatter (see CATLogSink::SetFormatter) that turns a record into a JSON object.  Set it on
+   //           a file sink to get a JSON Lines file, or pass JSON to CATLogger::Init.
+   //
+   // In:  fbOut - Where the text is going.
+   //      Record - The record, its time stamp already in nanoseconds since the epoch.
+   //      bTimestamp - Put the time stamp in the object?
+   //      unDigits - Digits after the seconds in the time stamp.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogJson::Formatter(CATFormatBuffer& fbOut, const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits)
+   {
+      FormatObject(fbOut, &CATFormatRegistry::GetTemplate(Record.m_unFormatId), 0, CATLogChannels::GetName(Record.m_ucChannel),
+         Record, bTimestamp, unDigits);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  FormatRecord
+   //
+   // Purpose:  Same as Formatter but with the record's format and channel name handed in, for when they don't
+   //           come from this process (e.g. ATLogDecode).
+   //
+   // In:  fbOut - Where the text is going.
+   //      pFormat - The record's format.
+   //      pChannel - Name of the record's channel.
+   //      Record - The record.
+   //      bTimestamp - Put the time stamp in the object?
+   //      unDigits - Digits after the seconds in the time stamp.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogJson::FormatRecord(CATFormatBuffer& fbOut, const char* pFormat, const char* pChannel, const SATLogRecord& Record,
+      bool bTimestamp, unsigned int unDigits)
+   {
+      FormatObject(fbOut, 0, pFormat, pChannel, Record, bTimestamp, unDigits);
+   }
+
+   //Same as above with the record's format already compiled (see CATFormatRegistry::GetTemplate).
+   void CATLogJson::FormatRecord(CATFormatBuffer& fbOut, const SATFormatTemplate& Template, const char* pChannel, const SATLogRecord& Record,
+      bool bTimestamp, unsigned int unDigits)
+   {
+      FormatObject(fbOut, &Template, 0, pChannel, Record, bTimestamp, unDigits);
+   }
+
+   //Builds the object with the message built from pTemplate, or pFormat when there's no template.
+   void CATLogJson::FormatObject(CATFormatBuffer& fbOut, const SATFormatTemplate* pTemplate, const char* pFormat, const char* pChannel,
+      const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits)
+   {
+      SATFormatArg aArgs[AT_LOG_MAX_ARGS];
+      unsigned int unArgCount = CATLogBinary::DecodeArgs(Record.m_cData, Record.m_usLength, aArgs, AT_LOG_MAX_ARGS);
+
+      fbOut.Append('{');
+      if (bTimestamp)
+      {
+         fbOut.Append("\"ts\":\"", 6);
+         AppendTimestamp(fbOut, Record.m_ullTimestamp, unDigits);
+         fbOut.Append("\",", 2);
+      }
+
+      const char* pLevel = (Record.m_ucLevel < 4) ? s_apLevelNames[Record.m_ucLevel] : "info";
+      fbOut.Append("\"level\":\"", 9);
+      fbOut.Append(pLevel, static_cast<unsigned int>(strlen(pLevel)));
+      fbOut.Append("\",\"channel\":\"", 13);
+      AppendString(fbOut, pChannel, pChannel ? static_cast<unsigned int>(strlen(pChannel)) : 0, JSON_RESERVE);
+
+      //The text is built on its own first since it has to be escaped on the way in.
+      static thread_local CATLineBuffer s_lbMessage;
+      CATFormatBuffer fbMessage = s_lbMessage.Begin();
+      for (;;)
+      {
+         if (pTemplate)
+            CATFormatter::BuildMessage(fbMessage, *pTemplate, aArgs, unArgCount);
+         else
+            CATFormatter::BuildMessage(fbMessage, pFormat, aArgs, unArgCount);
+         if (!s_lbMessage.Grow(fbMessage))
+            break;
+         fbMessage = s_lbMessage.Begin();
+      }
+      if (fbMessage.IsTruncated())
+         fbOut.SetTruncated();
+      fbOut.Append("\",\"msg\":\"", 9);
+      AppendString(fbOut, fbMessage.Terminate(), fbMessage.Length(), JSON_RESERVE);
+      fbOut.Append('"');
+
+      //Fields go in as long as there's room for the whole thing, a half written one would break the line.
+      for (unsigned int i = 0; i < unArgCount; i++)
+      {
+         const SATFormatArg& Arg = aArgs[i];
+         if (!Arg.m_pKey)
+            continue;
+         if (fbOut.Remaining() < 6u * Arg.m_ucKeyLength + 48 + JSON_RESERVE)
+         {
+            fbOut.SetTruncated();
+            break;
+         }
+
+         fbOut.Append(",\"", 2);
+         AppendString(fbOut, Arg.m_pKey, Arg.m_ucKeyLength, 0);
+         fbOut.Append("\":", 2);
+         AppendValue(fbOut, Arg, JSON_RESERVE);
+      }
+
+      fbOut.Append('}');
+   }
+
+   //Writes pText out as the inside of a JSON string, escaping as needed.  Stops early rather than run into the last
+   //unReserve bytes of fbOut.
+   void CATLogJson::AppendString(CATFormatBuffer& fbOut, const char* pText, unsigned int unLength, unsigned int unReserve)
+   {
+      static const char s_cHex[] = "0123456789abcdef";
+
+      //Runs of characters that don't need escaping go in a piece at a time.
+      unsigned int unRun = 0;
+      for (unsigned int i = 0; i < unLength; i++)
+      {
+         unsigned char ucChar = static_cast<unsigned char>(pText[i]);
+         if (ucChar >= 0x20 && ucChar != '"' && ucChar != '\\')
+            continue;
+
+         if (fbOut.Remaining() < (i - unRun) + 6 + unReserve)
+         {
+            unLength = i;
+            fbOut.SetTruncated();
+            break;
+         }
+         fbOut.Append(pText + unRun, i - unRun);
+         unRun = i + 1;
+
+         char cEscape[6] = {'\\', 0};
+         unsigned int unEscape = 2;
+         switch (ucChar)
+         {
+            case '"':  cEscape[1] = '"'; break;
+            case '\\': cEscape[1] = '\\'; break;
+            case '\n': cEscape[1] = 'n'; break;
+            case '\r': cEscape[1] = 'r'; break;
+            case '\t': cEscape[1] = 't'; break;
+            case '\b': cEscape[1] = 'b'; break;
+            case '\f': cEscape[1] = 'f'; break;
+            default:
+               cEscape[1] = 'u';
+               cEscape[2] = '0';
+               cEscape[3] = '0';
+               cEscape[4] = s_cHex[ucChar >> 4];
+               cEscape[5] = s_cHex[ucChar & 0x0F];
+               unEscape = 6;
+               break;
+         }
+         fbOut.Append(cEscape, unEscape);
+      }
+
+      //Whatever is left, as much of it as fits.
+      unsigned int unRest = unLength - unRun;
+      unsigned int unRoom = (fbOut.Remaining() > unReserve) ? fbOut.Remaining() - unReserve : 0;
+      if (unRest > unRoom)
+      {
+         unRest = unRoom;
+         fbOut.SetTruncated();
+      }
+      fbOut.Append(pText + unRun, unRest);
+   }
+
+   //Writes a field's value out as a JSON number, true/false, null or string depending on its type.
+   void CATLogJson::AppendValue(CATFormatBuffer& fbOut, const SATFormatArg& Arg, unsigned int unReserve)
+   {
+      switch (Arg.m_ucType)
+      {
+         case ARG_SIGNED:
+            CATFormatter::AppendSigned(fbOut, Arg.m_llValue);
+            break;
+         case ARG_UNSIGNED:
+            CATFormatter::AppendUnsigned(fbOut, Arg.m_ullValue);
+            break;
+         case ARG_FLOAT:
+         {
+            //JSON has no NaN or infinity.  The shortest text that reads back the same is what JSON readers want anyway.
+            if (std::isfinite(Arg.m_dValue))
+               CATFormatter::AppendDouble(fbOut, Arg.m_dValue);
+            else
+               fbOut.Append("null", 4);
+            break;
+         }
+         case ARG_BOOL:
+         {
+            if (Arg.m_bValue)
+               fbOut.Append("true", 4);
+            else
+               fbOut.Append("false", 5);
+            break;
+         }
+         case ARG_CHAR:
+         {
+            fbOut.Append('"');
+            AppendString(fbOut, &Arg.m_cValue, 1, unReserve);
+            fbOut.Append('"');
+            break;
+         }
+         case ARG_STRING:
+         {
+            if (!Arg.m_pString)
+            {
+               fbOut.Append("null", 4);
+               break;
+            }
+            fbOut.Append('"');
+            AppendString(fbOut, Arg.m_pString, Arg.m_unLength, unReserve);
+            fbOut.Append('"');
+            break;
+         }
+         case ARG_POINTER:
+         {
+            fbOut.Append('"');
+            CATFormatter::AppendHex(fbOut, reinterpret_cast<uintptr_t>(Arg.m_pPointer), true);
+            fbOut.Append('"');
+            break;
+         }
+         case ARG_USER:  //Whatever its formatter writes, as a string.
+         {
+            char cText[512];
+            CATFormatBuffer fbText(cText, sizeof(cText));
+            CATFormatter::AppendArg(fbText, 0, Arg);
+            fbOut.Append('"');
+            AppendString(fbOut, cText, fbText.Length(), unReserve);
+            fbOut.Append('"');
+            break;
+         }
+         default:
+            fbOut.Append("null", 4);
+            break;
+      }
+   }
+
+   //Writes a time stamp out as an ISO 8601 UTC time, "2026-10-18T03:05:34.374096Z".
+   void CATLogJson::AppendTimestamp(CATFormatBuffer& fbOut, unsigned long long ullTimestamp, unsigned int unDigits)
+   {
+      unsigned long long ullSecond = ullTimestamp / 1000000000ULL;
+      if (ullSecond != s_jtcCache.m_ullSecond)
+      {
+         time_t ttTime = static_cast<time_t>(ullSecond);
+         tm utc_time = {};
+
+         #ifdef _WIN32
+            gmtime_s(&utc_time, &ttTime);
+         #else
+            gmtime_r(&ttTime, &utc_time);
+         #endif
+
+         s_jtcCache.m_unLength = static_cast<unsigned int>(strftime(s_jtcCache.m_cPrefix, sizeof(s_jtcCache.m_cPrefix), "%Y-%m-%dT%H:%M:%S", &utc_time));
+         s_jtcCache.m_ullSecond = ullSecond;
+      }
+      fbOut.Append(s_jtcCache.m_cPrefix, s_jtcCache.m_unLength);
+
+      if (unDigits > 9)
+         unDigits = 9;
+
+      //Write the fraction right to left, dropping the digits we aren't showing.
+      if (unDigits > 0)
+      {
+         char cFraction[10];
+         unsigned long long ullFraction = ullTimestamp % 1000000000ULL;
+         for (unsigned int i = unDigits; i < 9; i++)
+            ullFraction /= 10;
+
+         cFraction[0] = '.';
+         for (unsigned int i = unDigits; i > 0; i--)
+         {
+            cFraction[i] = static_cast<char>('0' + ullFraction % 10);
+            ullFraction /= 10;
+         }
+         fbOut.Append(cFraction, unDigits + 1);
+      }
+
+      fbOut.Append('Z');
+   }
+}
@@ -0,0 +1,76 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogJson.h
+//
+// Purpose: Writes records out as JSON Lines, one object per message, so whatever reads the Log gets the message's fields
+//          as typed values instead of pulling them back out of the text:
+//
+//             {"ts":"2026-10-18T03:05:34.374096Z","level":"info","channel":"general","msg":"frame done","ms":16.6,"entities":3}
+//
+//          "ts" is UTC and only there when the sink has time stamps on.  Everything is built straight into the sink's
+//          line buffer, nothing is allocated once the thread's buffers are big enough.  A line too long for
+//          AT_LOG_LINE_MAX loses the end of its message and its last fields but is always closed off, so it still parses.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "ATLogFormat.h"
+#include "ATLogRecord.h"
+
+namespace Atlas
+{
+   class CATLogJson
+   {
+      private:
+         //Builds the object with the message built from pTemplate, or pFormat when there's no template.
+         static void FormatObject(CATFormatBuffer& fbOut, const SATFormatTemplate* pTemplate, const char* pFormat, const char* pChannel,
+            const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits);
+
+      public:
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Formatter
+         //
+         // Purpose:  A sink formatter (see CATLogSink::SetFormatter) that turns a record into a JSON object.  Set it on
+         //           a file sink to get a JSON Lines file, or pass JSON to CATLogger::Init.
+         //
+         // In:  fbOut - Where the text is going.
+         //      Record - The record, its time stamp already in nanoseconds since the epoch.
+         //      bTimestamp - Put the time stamp in the object?
+         //      unDigits - Digits after the seconds in the time stamp.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void Formatter(CATFormatBuffer& fbOut, const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  FormatRecord
+         //
+         // Purpose:  Same as Formatter but with the record's format and channel name handed in, for when they don't
+         //           come from this process (e.g. ATLogDecode).
+         //
+         // In:  fbOut - Where the text is going.
+         //      pFormat - The record's format.
+         //      pChannel - Name of the record's channel.
+         //      Record - The record.
+         //      bTimestamp - Put the time stamp in the object?
+         //      unDigits - Digits after the seconds in the time stamp.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void FormatRecord(CATFormatBuffer& fbOut, const char* pFormat, const char* pChannel, const SATLogRecord& Record,
+            bool bTimestamp, unsigned int unDigits);
+
+         //Same as above with the record's format already compiled (see CATFormatRegistry::GetTemplate).
+         static void FormatRecord(CATFormatBuffer& fbOut, const SATFormatTemplate& Template, const char* pChannel, const SATLogRecord& Record,
+            bool bTimestamp, unsigned int unDigits);
+
+         //Writes pText out as the inside of a JSON string, escaping as needed.  Stops early rather than run into the
+         //last unReserve bytes of fbOut.
+         static void AppendString(CATFormatBuffer& fbOut, const char* pText, unsigned int unLength, unsigned int unReserve);
+
+         //Writes a field's value out as a JSON number, true/false, null or string depending on its type.
+         static void AppendValue(CATFormatBuffer& fbOut, const SATFormatArg& Arg, unsigned int unReserve);
+
+         //Writes a time stamp out as an ISO 8601 UTC time, "2026-10-18T03:05:34.374096Z".
+         static void AppendTimestamp(CATFormatBuffer& fbOut, unsigned long long ullTimestamp, unsigned int unDigits);
+   };
+}
@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogMemorySink.cpp
+//
+// Purpose: Sink that keeps the most recent messages in a fixed size ring in memory.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogMemorySink.h"
+#include <cstring>
+
+namespace Atlas
+{
+   //Constructor
+   CATMemorySink::CATMemorySink(unsigned int unCapacity)
+   {
+      m_unCapacity = (unCapacity > 1) ? unCapacity : 2;
+      m_pRing = new char[m_unCapacity];
+      m_unStart = 0;
+      m_unUsed = 0;
+   }
+
+   //Destructor
+   CATMemorySink::~CATMemorySink()
+   {
+      delete[] m_pRing;
+   }
+
+   //Throws away the oldest message, everything up to and including its newline.
+   void CATMemorySink::DropOldest()
+   {
+      while (m_unUsed > 0)
+      {
+         char cByte = m_pRing[m_unStart];
+         m_unStart = (m_unStart + 1) % m_unCapacity;
+         m_unUsed--;
+         if (cByte == '\n')
+            break;
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  WriteText
+   //
+   // Purpose:  Adds a message to the ring, dropping the oldest messages until there's room.  A message bigger than the
+   //           whole ring is cut short.
+   //
+   // In:  ucLevel - The eLevel of the message.
+   //      pText - The completed, null terminated message.
+   //      unLength - Number of characters in pText.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATMemorySink::WriteText(unsigned char /*ucLevel*/, const char* pText, unsigned int unLength)
+   {
+      if (unLength > m_unCapacity - 1)
+         unLength = m_unCapacity - 1;
+
+      std::lock_guard<std::mutex> lgRing(m_mtxRing);
+      while (m_unUsed + unLength + 1 > m_unCapacity)
+         this->DropOldest();
+
+      //Copy it in, wrapping around the end of the ring if we have to.
+      unsigned int unEnd = (m_unStart + m_unUsed) % m_unCapacity;
+      unsigned int unFirst = (unLength < m_unCapacity - unEnd) ? unLength : m_unCapacity - unEnd;
+      memcpy(m_pRing + unEnd, pText, unFirst);
+      memcpy(m_pRing, pText + unFirst, unLength - unFirst);
+      m_pRing[(unEnd + unLength) % m_unCapacity] = '\n';
+      m_unUsed += unLength + 1;
+      this->AddBytesWritten(unLength + 1);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  GetText
+   //
+   // Purpose:  Copies out the messages currently in the ring, oldest first, one per line.  Safe to call from any
+   //           thread while messages are coming in.
+   //
+   // In:  pOut - Where the text is going, null terminated.
+   //      unSize - Size of pOut, the newest messages are cut off if it's too small.
+   //
+   // Out:  Number of characters copied, not counting the null.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned int CATMemorySink::GetText(char* pOut, unsigned int unSize) const
+   {
+      if (!pOut || unSize == 0)
+         return 0;
+
+      std::lock_guard<std::mutex> lgRing(m_mtxRing);
+      unsigned int unCopy = (m_unUsed < unSize - 1) ? m_unUsed : unSize - 1;
+      unsigned int unFirst = (unCopy < m_unCapacity - m_unStart) ? unCopy : m_unCapacity - m_unStart;
+      memcpy(pOut, m_pRing + m_unStart, unFirst);
+      memcpy(pOut + unFirst, m_pRing, unCopy - unFirst);
+      pOut[unCopy] = '\0';
+      return unCopy;
+   }
+
+   //Throws away every message.
+   void CATMemorySink::Clear()
+   {
+      std::lock_guard<std::mutex> lgRing(m_mtxRing);
+      m_unStart = 0;
+      m_unUsed = 0;
+   }
+
+   //Number of bytes GetText needs, not counting the null.
+   unsigned int CATMemorySink::GetSize() const
+   {
+      std::lock_guard<std::mutex> lgRing(m_mtxRing);
+      return m_unUsed;
+   }
+}
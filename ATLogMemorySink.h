@@ -0,0 +1,56 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogMemorySink.h
+//
+// Purpose: Sink that keeps the most recent messages in a fixed size ring in memory, oldest messages fall off the end as
+//          new ones come in.  Handy for an in game console or for dumping the last few seconds of Log after a problem.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <mutex>
+#include "ATLogSink.h"
+
+//Default size of the ring in bytes.
+#ifndef AT_LOG_MEMORY_SINK_SIZE
+#define AT_LOG_MEMORY_SINK_SIZE (64 * 1024)
+#endif
+
+namespace Atlas
+{
+   class CATMemorySink : public CATLogSink
+   {
+      private:
+         char*                   m_pRing;  //The messages, each ending in a newline.
+         unsigned int            m_unCapacity;  //Size of m_pRing.
+         unsigned int            m_unStart;  //Where the oldest message starts.
+         unsigned int            m_unUsed;  //Number of bytes in use.
+         mutable std::mutex      m_mtxRing;  //Held while the ring is being written or read.
+
+         void DropOldest();  //Throws away the oldest message.
+
+         CATMemorySink(const CATMemorySink&);  //Copy Constructor
+         CATMemorySink& operator=(const CATMemorySink&);  //Assignment Operator
+
+      protected:
+         virtual void WriteText(unsigned char ucLevel, const char* pText, unsigned int unLength) override;  //Adds a message, dropping old ones to make room.
+
+      public:
+         CATMemorySink(unsigned int unCapacity = AT_LOG_MEMORY_SINK_SIZE);  //Constructor
+         ~CATMemorySink();  //Destructor
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  GetText
+         //
+         // Purpose:  Copies out the messages currently in the ring, oldest first, one per line.  Safe to call from any
+         //           thread while messages are coming in.
+         //
+         // In:  pOut - Where the text is going, null terminated.
+         //      unSize - Size of pOut, the newest messages are cut off if it's too small.
+         //
+         // Out:  Number of characters copied, not counting the null.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         unsigned int GetText(char* pOut, unsigned int unSize) const;
+
+         void Clear();  //Throws away every message.
+         unsigned int GetSize() const;  //Number of bytes GetText needs, not counting the null.
+   };
+}
@@ -0,0 +1,191 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogQueue.h
+//
+// Purpose: A bounded, lock-free ring buffer that hands Log records from any number of calling threads over to a Log sink's
+//          background thread.  Producers claim a slot, fill it in place and publish it, so nothing is ever
+//          allocated or locked on the calling thread.  When it's full a producer can Discard the oldest record to
+//          make room, the consumer and the producer race for it on the tail so a record is only ever taken once.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+//Size of a cache line, keeps the producer and consumer cursors from false sharing.
+#define AT_CACHE_LINE 64
+
+namespace Atlas
+{
+   template <typename T>
+   class CATLogQueue
+   {
+      private:
+         //A single slot in the ring, the sequence number tells producers and the consumer who owns the slot.
+         struct SCell
+         {
+            std::atomic<size_t>  m_unSequence;
+            T                    m_Data;
+         };
+
+         SCell*                  m_pCells;  //The ring itself.
+         size_t                  m_unMask;  //Capacity - 1, capacity is always a power of two.
+
+         alignas(AT_CACHE_LINE) std::atomic<size_t> m_unHead;  //Next position a producer will claim.
+         alignas(AT_CACHE_LINE) std::atomic<size_t> m_unTail;  //Next position the consumer will read.
+
+         CATLogQueue(const CATLogQueue&);  //Copy Constructor
+         CATLogQueue& operator=(const CATLogQueue&);  //Assignment Operator
+
+      public:
+
+         //Handle to a claimed slot, filled in by the producer then handed back to Publish.
+         struct STicket
+         {
+            T*       m_pData;
+            size_t   m_unPosition;
+         };
+
+         //Constructor, unCapacity is rounded up to the next power of two.
+         explicit CATLogQueue(size_t unCapacity)
+         {
+            size_t unSize = 2;
+            while (unSize < unCapacity)
+               unSize <<= 1;
+
+            m_pCells = new SCell[unSize];
+            m_unMask = unSize - 1;
+
+            for (size_t i = 0; i < unSize; i++)
+               m_pCells[i].m_unSequence.store(i, std::memory_order_relaxed);
+
+            m_unHead.store(0, std::memory_order_relaxed);
+            m_unTail.store(0, std::memory_order_relaxed);
+         }
+
+         //Destructor
+         ~CATLogQueue() { delete[] m_pCells; }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Claim
+         //
+         // Purpose:  Reserves the next free slot for a producer.  Safe to call from any number of threads.
+         //
+         // In:  tTicket - Receives the slot to be filled in.
+         //
+         // Out:  true if a slot was claimed, false if the queue is full.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Claim(STicket& tTicket)
+         {
+            size_t unPosition = m_unHead.load(std::memory_order_relaxed);
+            for (;;)
+            {
+               SCell* pCell = &m_pCells[unPosition & m_unMask];
+               size_t unSequence = pCell->m_unSequence.load(std::memory_order_acquire);
+               ptrdiff_t nDiff = static_cast<ptrdiff_t>(unSequence) - static_cast<ptrdiff_t>(unPosition);
+
+               if (nDiff == 0)  //Slot is free, try and take it.
+               {
+                  if (m_unHead.compare_exchange_weak(unPosition, unPosition + 1, std::memory_order_relaxed))
+                  {
+                     tTicket.m_pData = &pCell->m_Data;
+                     tTicket.m_unPosition = unPosition;
+                     return true;
+                  }
+               }
+               else if (nDiff < 0)  //Consumer hasn't caught up yet, we're full.
+                  return false;
+               else  //Another producer beat us to it, try again.
+                  unPosition = m_unHead.load(std::memory_order_relaxed);
+            }
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Publish
+         //
+         // Purpose:  Hands a claimed and filled in slot over to the consumer.
+         //
+         // In:  tTicket - The ticket returned from Claim.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Publish(const STicket& tTicket)
+         {
+            m_pCells[tTicket.m_unPosition & m_unMask].m_unSequence.store(tTicket.m_unPosition + 1, std::memory_order_release);
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Front
+         //
+         // Purpose:  Returns the oldest published record without removing it, for a look before calling Take.
+         //           Consumer thread only.  A producer calling Discard can reuse the slot out from under it.
+         //
+         // In:  None
+         //
+         // Out:  Pointer to the record, 0 if the queue is empty.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         T* Front()
+         {
+            size_t unPosition = m_unTail.load(std::memory_order_relaxed);
+            SCell* pCell = &m_pCells[unPosition & m_unMask];
+            if (pCell->m_unSequence.load(std::memory_order_acquire) != unPosition + 1)
+               return 0;
+            return &pCell->m_Data;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Take
+         //
+         // Purpose:  Removes the oldest published record, handing it to fnCopy before its slot goes back to the
+         //           producers.  Consumer thread only, but safe against a producer calling Discard at the same time.
+         //
+         // In:  fnCopy - Called with the record while the slot is still ours, copies out what's needed.
+         //
+         // Out:  true if a record was taken, false if the queue is empty or a producer discarded it first.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         template <typename F>
+         bool Take(F fnCopy)
+         {
+            size_t unPosition = m_unTail.load(std::memory_order_relaxed);
+            SCell* pCell = &m_pCells[unPosition & m_unMask];
+            if (pCell->m_unSequence.load(std::memory_order_acquire) != unPosition + 1 ||
+               !m_unTail.compare_exchange_strong(unPosition, unPosition + 1, std::memory_order_acquire, std::memory_order_relaxed))
+               return false;
+
+            fnCopy(pCell->m_Data);
+            pCell->m_unSequence.store(unPosition + m_unMask + 1, std::memory_order_release);
+            return true;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Discard
+         //
+         // Purpose:  Throws away the oldest published record to make room for a new one.  Safe to call from a
+         //           producer while the consumer is taking records, whichever gets to the record first wins it.
+         //
+         // In:  None
+         //
+         // Out:  true if a record was thrown away.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Discard()
+         {
+            size_t unPosition = m_unTail.load(std::memory_order_relaxed);
+            SCell* pCell = &m_pCells[unPosition & m_unMask];
+            if (pCell->m_unSequence.load(std::memory_order_acquire) != unPosition + 1 ||
+               !m_unTail.compare_exchange_strong(unPosition, unPosition + 1, std::memory_order_acquire, std::memory_order_relaxed))
+               return false;
+
+            pCell->m_unSequence.store(unPosition + m_unMask + 1, std::memory_order_release);
+            return true;
+         }
+
+         //Approximate number of records waiting, exact only on the consumer thread.
+         size_t Size() const
+         {
+            size_t unTail = m_unTail.load(std::memory_order_relaxed);  //Tail first so we never read it past a stale head.
+            return m_unHead.load(std::memory_order_relaxed) - unTail;
+         }
+
+         //Total number of slots in the ring.
+         size_t Capacity() const { return m_unMask + 1; }
+   };
+}
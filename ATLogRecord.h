@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogRecord.h
+//
+// Purpose: The fixed size record that carries a single Log message from the calling thread to the Logger's outputs.
+//          Records hold the message's format id and raw argument bytes, turning them into text is left to whoever
+//          outputs the record.
+//
+//          How much of a message survives depends on where it's going:
+//
+//          - Sinks without a thread of their own (the default, not ASYNC) get a SATLogLargeRecord, so only arguments
+//            past AT_LOG_LARGE_RECORD_SIZE bytes are lost.
+//          - ASYNC sinks' queues, the flight recorder, BINARY and INDEXED files and CATSocketSink all hold records of
+//            AT_LOG_RECORD_SIZE bytes.
+//
+//          A string cut short to fit ends in AT_LOG_TRUNCATED (see ATLogFormat.h), and so does a line cut short at
+//          AT_LOG_LINE_MAX.  Arguments that don't fit at all are left out and their placeholders printed as they are.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>
+
+//Total size of a single record, arguments that don't fit are truncated.
+#ifndef AT_LOG_RECORD_SIZE
+#define AT_LOG_RECORD_SIZE 512
+#endif
+
+//Total size of the record sinks without a thread get when a message doesn't fit in AT_LOG_RECORD_SIZE.  Has to stay
+//under 64K, record lengths are 16 bits.
+#ifndef AT_LOG_LARGE_RECORD_SIZE
+#define AT_LOG_LARGE_RECORD_SIZE 32768
+#endif
+
+namespace Atlas
+{
+   struct SATLogRecord
+   {
+      unsigned long long   m_ullTimestamp;  //When the message was logged, CATLogClock ticks until it's output then nanoseconds since the epoch.
+      unsigned int         m_unFormatId;  //CATFormatRegistry id of the message's format.
+      unsigned short       m_usLength;  //Number of bytes used in m_cData.
+      unsigned char        m_ucLevel;  //eLevel of the message.
+      unsigned char        m_ucArgCount;  //Number of arguments encoded in m_cData.
+      unsigned char        m_ucChannel;  //CATLogChannels id the message was logged on.
+      char                 m_cData[AT_LOG_RECORD_SIZE - 17];  //The arguments, encoded by CATLogBinary::EncodeArgs.
+   };
+
+   //A record with room for AT_LOG_LARGE_RECORD_SIZE bytes, its arguments running on from m_Record.m_cData into
+   //m_cMore.  Passed around as m_Record, m_usLength says how far the arguments go.
+   struct SATLogLargeRecord
+   {
+      SATLogRecord   m_Record;
+      char           m_cMore[AT_LOG_LARGE_RECORD_SIZE - AT_LOG_RECORD_SIZE];
+   };
+
+   static_assert(sizeof(SATLogRecord) == AT_LOG_RECORD_SIZE, "SATLogRecord can't have any padding");
+   static_assert(offsetof(SATLogLargeRecord, m_cMore) == sizeof(SATLogRecord), "m_cMore has to follow m_Record.m_cData");
+   static_assert(AT_LOG_LARGE_RECORD_SIZE > AT_LOG_RECORD_SIZE && AT_LOG_LARGE_RECORD_SIZE <= 65535,
+      "AT_LOG_LARGE_RECORD_SIZE has to be bigger than AT_LOG_RECORD_SIZE and fit in a record's length");
+}
@@ -0,0 +1,311 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogRollingFileSink.cpp
+//
+// Purpose: File sink that rolls over by size and age, compressing and pruning the closed segments in the background.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogRollingFileSink.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <vector>
+
+#ifdef AT_LOG_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Atlas
+{
+   //Constructor
+   CATRollingFileSink::CATRollingFileSink(bool bBinary, bool bIndexed) : CATFileSink(bBinary, bIndexed)
+   {
+      m_ullMaxBytes = 0;  //Never roll over until SetRollPolicy says to.
+      m_unMaxSeconds = 0;
+      m_unKeep = AT_LOG_ROLL_KEEP;
+      m_bCompress = true;
+      m_bCompressorRunning = false;
+   }
+
+   //Destructor
+   CATRollingFileSink::~CATRollingFileSink()
+   {
+      //Let the compressor finish off whatever segments are still waiting.
+      {
+         std::lock_guard<std::mutex> lgSegments(m_mtxSegments);
+         m_bCompressorRunning = false;
+      }
+      m_cvSegments.notify_one();
+      if (m_tCompressor.joinable())
+         m_tCompressor.join();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  SetRollPolicy
+   //
+   // Purpose:  Sets when the file rolls over and what happens to the old ones.  Call before adding the sink.
+   //
+   // In:  ullMaxBytes - Roll over once the file gets this big, 0 for never.
+   //      unMaxSeconds - Roll over once the file is this many seconds old, 0 for never.
+   //      unKeep - Number of closed segments to keep, older ones are deleted.
+   //      bCompress - Compress closed segments (needs AT_LOG_ZLIB, ignored otherwise).
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATRollingFileSink::SetRollPolicy(unsigned long long ullMaxBytes, unsigned int unMaxSeconds, unsigned int unKeep, bool bCompress)
+   {
+      m_ullMaxBytes = ullMaxBytes;
+      m_unMaxSeconds = unMaxSeconds;
+      m_unKeep = unKeep;
+      m_bCompress = bCompress;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Open
+   //
+   // Purpose:  Opens (and truncates) the file and starts up the compressor thread.
+   //
+   // In:  sFilename - Name of the file to be created, this stays the name of the file being written.
+   //
+   // Out:  true if the file was opened, false otherwise.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATRollingFileSink::Open(const CString& sFilename)
+   {
+      if (!CATFileSink::Open(sFilename))
+         return false;
+
+      m_sFilename = sFilename;
+      m_tpOpened = std::chrono::steady_clock::now();
+
+      std::lock_guard<std::mutex> lgSegments(m_mtxSegments);
+      if (!m_bCompressorRunning)
+      {
+         m_bCompressorRunning = true;
+         m_tCompressor = std::thread(&CATRollingFileSink::CompressorThread, this);
+      }
+      return true;
+   }
+
+   //Writes out the file buffer and rolls over if the file has gotten too big or too old.
+   void CATRollingFileSink::EndBatch(bool bFlush)
+   {
+      CATFileSink::EndBatch(bFlush);
+
+      if (!this->IsOpen() || this->GetSize() == 0)
+         return;
+
+      bool bRoll = (m_ullMaxBytes > 0 && this->GetSize() >= m_ullMaxBytes);
+      if (!bRoll && m_unMaxSeconds > 0)
+         bRoll = (std::chrono::steady_clock::now() - m_tpOpened >= std::chrono::seconds(m_unMaxSeconds));
+
+      if (bRoll && std::chrono::steady_clock::now() >= m_tpRetry)
+         this->Roll();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Roll
+   //
+   // Purpose:  Closes the current file, renames it after the time it was closed and opens a fresh one under the
+   //           same name.  The closed segment is handed to the compressor, nothing slow happens here.  If the
+   //           rename fails the file is reopened where it left off, nothing in it is lost, and the roll over is
+   //           tried again after AT_LOG_ROLL_RETRY seconds.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATRollingFileSink::Roll()
+   {
+      std::filesystem::path pthActive(m_sFilename.getCstr());
+
+      //Build "<name>.<YYYYMMDD-HHMMSS><extension>", adding a count if a segment already has that name.
+      time_t ttNow = time(0);
+      tm now_time = {};
+      #ifdef _WIN32
+         localtime_s(&now_time, &ttNow);
+      #else
+         localtime_r(&ttNow, &now_time);
+      #endif
+
+      char cStamp[32] = {};
+      strftime(cStamp, sizeof(cStamp), "%Y%m%d-%H%M%S", &now_time);
+
+      std::filesystem::path pthStem = pthActive;
+      pthStem.replace_extension();
+      std::string sExtension = pthActive.extension().string();
+
+      std::string sSegment = pthStem.string() + "." + cStamp + sExtension;
+      std::error_code ecError;
+      for (unsigned int i = 1; std::filesystem::exists(sSegment, ecError) || std::filesystem::exists(sSegment + ".gz", ecError); i++)
+         sSegment = pthStem.string() + "." + cStamp + "-" + std::to_string(i) + sExtension;
+
+      //Appending either starts a fresh file once the old one has been moved out of the way, or carries on with the
+      //old one if it couldn't be, never truncating a segment we failed to keep.
+      this->Close();
+      std::filesystem::rename(pthActive, sSegment, ecError);
+      CATFileSink::Open(m_sFilename, true);
+      if (ecError)
+      {
+         m_tpRetry = std::chrono::steady_clock::now() + std::chrono::seconds(AT_LOG_ROLL_RETRY);
+         return;
+      }
+
+      m_tpOpened = std::chrono::steady_clock::now();
+      {
+         std::lock_guard<std::mutex> lgSegments(m_mtxSegments);
+         m_dqSegments.push_back(sSegment);
+      }
+      m_cvSegments.notify_one();
+   }
+
+   //Gzips a closed segment next to itself and deletes the original.
+   static void CompressSegment(const std::string& sSegment)
+   {
+      #ifdef AT_LOG_ZLIB
+         FILE* pIn = fopen(sSegment.c_str(), "rb");
+         if (!pIn)
+            return;
+
+         std::string sCompressed = sSegment + ".gz";
+         gzFile gzOut = gzopen(sCompressed.c_str(), "wb6");
+         if (!gzOut)
+         {
+            fclose(pIn);
+            return;
+         }
+
+         char cBuffer[64 * 1024];
+         bool bFailed = false;
+         size_t unRead = 0;
+         while ((unRead = fread(cBuffer, 1, sizeof(cBuffer), pIn)) > 0)
+         {
+            if (gzwrite(gzOut, cBuffer, static_cast<unsigned int>(unRead)) != static_cast<int>(unRead))
+            {
+               bFailed = true;
+               break;
+            }
+         }
+
+         fclose(pIn);
+         if (gzclose(gzOut) != Z_OK)
+            bFailed = true;
+
+         //Only get rid of the original once the compressed copy is safely written.
+         std::error_code ecError;
+         std::filesystem::remove(bFailed ? sCompressed : sSegment, ecError);
+      #else
+         (void)sSegment;  //Without zlib segments are left as they are.
+      #endif
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  CompressorThread
+   //
+   // Purpose:  Runs at the lowest priority the OS gives us, compressing closed segments as Roll hands them over and
+   //           pruning old ones.  Finishes whatever is waiting before it exits.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATRollingFileSink::CompressorThread()
+   {
+      #ifdef _WIN32
+         SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+      #elif defined(__linux__)
+         sched_param spParam = {};
+         pthread_setschedparam(pthread_self(), SCHED_IDLE, &spParam);
+      #endif
+
+      std::unique_lock<std::mutex> ulSegments(m_mtxSegments);
+      for (;;)
+      {
+         m_cvSegments.wait(ulSegments, [this]() { return !m_dqSegments.empty() || !m_bCompressorRunning; });
+         if (m_dqSegments.empty())
+            break;
+
+         std::string sSegment = m_dqSegments.front();
+         m_dqSegments.pop_front();
+         bool bCompress = m_bCompress;
+
+         //Don't hold up Roll while we work.
+         ulSegments.unlock();
+         if (bCompress)
+            CompressSegment(sSegment);
+         this->PruneSegments();
+         ulSegments.lock();
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  PruneSegments
+   //
+   // Purpose:  Deletes all but the newest m_unKeep closed segments, compressed or not.  Segments are ordered by
+   //           the time stamp in their name, then by the count Roll adds when a name is already taken (none counts
+   //           as 0), so "-HHMMSS.log" comes before "-HHMMSS-1.log" and "-2" before "-10".
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATRollingFileSink::PruneSegments()
+   {
+      std::filesystem::path pthActive(m_sFilename.getCstr());
+      std::filesystem::path pthDirectory = pthActive.parent_path();
+      if (pthDirectory.empty())
+         pthDirectory = ".";
+
+      std::string sPrefix = pthActive.stem().string() + ".";
+      std::string sExtension = pthActive.extension().string();
+
+      //A segment and what it's ordered by.
+      struct SSegment
+      {
+         std::filesystem::path   m_pthPath;
+         std::string             m_sStamp;  //"YYYYMMDD-HHMMSS".
+         unsigned long long      m_ullCount;  //Count after the time stamp, 0 for none.
+      };
+
+      std::vector<SSegment> vSegments;
+      std::error_code ecError;
+      for (std::filesystem::directory_iterator diEntry(pthDirectory, ecError), diEnd; !ecError && diEntry != diEnd; diEntry.increment(ecError))
+      {
+         std::string sName = diEntry->path().filename().string();
+         if (sName.size() < sPrefix.size() + 15 || sName.compare(0, sPrefix.size(), sPrefix) != 0)
+            continue;
+
+         //Has to be one of ours, "<name>.<YYYYMMDD-HHMMSS>...".
+         if (sName[sPrefix.size() + 8] != '-' || !std::all_of(sName.begin() + sPrefix.size(), sName.begin() + sPrefix.size() + 8, ::isdigit))
+            continue;
+
+         bool bSegment = (sName.size() >= sExtension.size() && sName.compare(sName.size() - sExtension.size(), sExtension.size(), sExtension) == 0);
+         bool bCompressed = (sName.size() >= sExtension.size() + 3 && sName.compare(sName.size() - sExtension.size() - 3, sExtension.size() + 3, sExtension + ".gz") == 0);
+         if (!bSegment && !bCompressed)
+            continue;
+
+         SSegment Segment = {diEntry->path(), sName.substr(sPrefix.size(), 15), 0};
+         size_t unCount = sPrefix.size() + 15;
+         if (sName[unCount] == '-')
+         {
+            for (unCount++; unCount < sName.size() && isdigit(static_cast<unsigned char>(sName[unCount])); unCount++)
+               Segment.m_ullCount = Segment.m_ullCount * 10 + (sName[unCount] - '0');
+         }
+         vSegments.push_back(Segment);
+      }
+
+      if (vSegments.size() <= m_unKeep)
+         return;
+
+      std::sort(vSegments.begin(), vSegments.end(), [](const SSegment& Left, const SSegment& Right)
+         { return Left.m_sStamp != Right.m_sStamp ? Left.m_sStamp < Right.m_sStamp : Left.m_ullCount < Right.m_ullCount; });
+      for (size_t i = 0; i < vSegments.size() - m_unKeep; i++)
+         std::filesystem::remove(vSegments[i].m_pthPath, ecError);
+   }
+}
@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogRollingFileSink.h
+//
+// Purpose: File sink that rolls over to a fresh file once the current one gets too big or too old.  The file being
+//          written always keeps the name it was opened with (so it can be tailed), closed segments are renamed to
+//          "<name>.<YYYYMMDD-HHMMSS><extension>", compressed to .gz on a low priority thread when built with
+//          AT_LOG_ZLIB, and only the newest few are kept around.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include "ATLogFileSink.h"
+
+//Number of closed segments kept around by default, older ones are deleted.
+#ifndef AT_LOG_ROLL_KEEP
+#define AT_LOG_ROLL_KEEP 10
+#endif
+
+//Seconds to wait before trying to roll over again when the current file couldn't be renamed.
+#ifndef AT_LOG_ROLL_RETRY
+#define AT_LOG_ROLL_RETRY 5
+#endif
+
+namespace Atlas
+{
+   class CATRollingFileSink : public CATFileSink
+   {
+      private:
+         CString                 m_sFilename;  //Name of the file being written, never changes.
+         unsigned long long      m_ullMaxBytes;  //Roll over once the file gets this big, 0 for never.
+         unsigned int            m_unMaxSeconds;  //Roll over once the file is this old, 0 for never.
+         unsigned int            m_unKeep;  //Number of closed segments to keep.
+         bool                    m_bCompress;  //Compress closed segments?
+         std::chrono::steady_clock::time_point m_tpOpened;  //When the current file was opened.
+         std::chrono::steady_clock::time_point m_tpRetry;  //The last roll over failed, don't try again before this.
+
+         std::thread                m_tCompressor;  //Compresses closed segments and deletes old ones.
+         std::mutex                 m_mtxSegments;  //Guards m_dqSegments and m_bCompressorRunning.
+         std::condition_variable    m_cvSegments;  //Wakes the compressor up when there's work.
+         std::deque<std::string>    m_dqSegments;  //Closed segments waiting on the compressor.
+         bool                       m_bCompressorRunning;  //Tells the compressor to keep going.
+
+         void Roll();  //Closes the current file, renames it and starts a new one.
+         void CompressorThread();  //Works through m_dqSegments.
+         void PruneSegments();  //Deletes all but the newest m_unKeep segments.
+
+      protected:
+         virtual void EndBatch(bool bFlush) override;  //Writes out the file buffer and rolls over if it's time.
+
+      public:
+         CATRollingFileSink(bool bBinary = false, bool bIndexed = false);  //Constructor, bBinary writes raw records instead of text, bIndexed in blocks.
+         ~CATRollingFileSink();  //Destructor
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Open
+         //
+         // Purpose:  Opens (and truncates) the file and starts up the compressor thread.
+         //
+         // In:  sFilename - Name of the file to be created, this stays the name of the file being written.
+         //
+         // Out:  true if the file was opened, false otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Open(const CString& sFilename);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetRollPolicy
+         //
+         // Purpose:  Sets when the file rolls over and what happens to the old ones.  Call before adding the sink.
+         //
+         // In:  ullMaxBytes - Roll over once the file gets this big, 0 for never.
+         //      unMaxSeconds - Roll over once the file is this many seconds old, 0 for never.
+         //      unKeep - Number of closed segments to keep, older ones are deleted.
+         //      bCompress - Compress closed segments (needs AT_LOG_ZLIB, ignored otherwise).
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetRollPolicy(unsigned long long ullMaxBytes, unsigned int unMaxSeconds, unsigned int unKeep = AT_LOG_ROLL_KEEP, bool bCompress = true);
+   };
+}
@@ -0,0 +1,460 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogSink.cpp
+//
+// Purpose: Base class for everywhere the Logger's messages can go.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogSink.h"
+#include "ATLogBinary.h"
+#include "ATLogClock.h"
+#include "ATLogStats.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+namespace Atlas
+{
+   //The stages the calling thread has open, so finding its own takes a few compares rather than walking a sink's list.
+   //Letting go of them when the thread exits is what lets the sink thread clean them up.
+   struct SATStageCache
+   {
+      unsigned long long   m_aullSinks[AT_LOG_STAGE_CACHE] = {};  //Id of the sink each stage belongs to, 0 for an empty entry.
+      SATLogStage*         m_apStages[AT_LOG_STAGE_CACHE] = {};
+      unsigned int         m_unNext = 0;  //Entry given up next once they're all taken.
+
+      ~SATStageCache()
+      {
+         for (unsigned int i = 0; i < AT_LOG_STAGE_CACHE; i++)
+         {
+            if (m_apStages[i])
+               m_apStages[i]->Release();
+         }
+      }
+   };
+
+   static thread_local SATStageCache s_scStages;
+   static std::atomic<unsigned long long> s_ullNextSinkId(1);  //Id handed to the next sink made.
+
+   //Constructor
+   CATLogSink::CATLogSink()
+   {
+      m_pStages = 0;
+      m_ullId = s_ullNextSinkId.fetch_add(1, std::memory_order_relaxed);
+      m_bThreaded = false;  //No thread until Start asks for one.
+      m_bRunning = false;
+      m_ucLevelMask = 0x0F;  //Every level.
+      m_bTimestamp = false;
+      m_ucTimestampDigits = 0;
+      m_pfnFormatter = DefaultFormatter;
+      m_unBatchSize = AT_LOG_SINK_BATCH;
+      m_ucBackpressure = DROP_NEWEST;
+      m_ucKeepLevel = 0;
+      m_ullDropped = 0;
+      m_ullOverwritten = 0;
+      m_ullBlocked = 0;
+      m_ullBytesWritten = 0;
+      m_ullQueueHighWater = 0;
+      m_ullFlushRequested = 0;
+      m_ullFlushCompleted = 0;
+   }
+
+   //Destructor
+   CATLogSink::~CATLogSink()
+   {
+      //Stop should already have been called, all that's left to do is make sure the thread isn't left hanging.
+      m_bRunning.store(false, std::memory_order_release);
+      if (m_tThread.joinable())
+         m_tThread.join();
+      ReleaseStages(true);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  DefaultFormatter
+   //
+   // Purpose:  The formatter sinks start out with, builds the same "[time stamp] [channel] message" text the
+   //           Logger always has.
+   //
+   // In:  fbOut - Where the text is going.
+   //      Record - The record, its time stamp already in nanoseconds since the epoch.
+   //      bTimestamp - Start the message off with its time stamp?
+   //      unDigits - Digits after the seconds in the time stamp.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::DefaultFormatter(CATFormatBuffer& fbOut, const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits)
+   {
+      CATLogBinary::FormatRecord(fbOut, CATFormatRegistry::GetTemplate(Record.m_unFormatId), CATLogChannels::GetName(Record.m_ucChannel),
+         Record, bTimestamp, unDigits);
+   }
+
+   //Builds a record's text with this sink's formatter.
+   void CATLogSink::FormatRecord(CATFormatBuffer& fbOut, const SATLogRecord& Record)
+   {
+      m_pfnFormatter(fbOut, Record, m_bTimestamp.load(std::memory_order_relaxed), m_ucTimestampDigits.load(std::memory_order_relaxed));
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  WriteRecord
+   //
+   // Purpose:  Outputs a single record.  By default this builds the text with the sink's formatter and hands it
+   //           to WriteText, sinks that want the raw record (e.g. BINARY files) override this instead.
+   //
+   // In:  Record - The record, its time stamp already in nanoseconds since the epoch.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::WriteRecord(const SATLogRecord& Record)
+   {
+      static thread_local CATLineBuffer s_lbLine;
+      unsigned long long ullStart = CATLogClock::Now();
+
+      //Size the buffer up front, so a long line is built once rather than cut short and built again.
+      s_lbLine.Reserve(CATLogBinary::EstimateLength(CATFormatRegistry::GetTemplate(Record.m_unFormatId), Record));
+      CATFormatBuffer fbMessage = s_lbLine.Begin();
+      this->FormatRecord(fbMessage, Record);
+      while (s_lbLine.Grow(fbMessage))
+      {
+         fbMessage = s_lbLine.Begin();
+         this->FormatRecord(fbMessage, Record);
+      }
+      CATLogStats::AddFormat(CATLogClock::ElapsedNanoseconds(CATLogClock::Now() - ullStart), fbMessage.Length());
+      this->WriteText(Record.m_ucLevel, fbMessage.Terminate(), fbMessage.Length());
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Start
+   //
+   // Purpose:  Gets the sink ready to take records, spinning up its thread if asked to.  Called by the Logger
+   //           when the sink is added.
+   //
+   // In:  bThreaded - Give the sink its own thread (ASYNC)?
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::Start(bool bThreaded)
+   {
+      if (!bThreaded || m_bThreaded)
+         return;
+
+      m_bThreaded = true;
+      m_bRunning.store(true, std::memory_order_release);
+      m_tThread = std::thread(&CATLogSink::SinkThread, this);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Stop
+   //
+   // Purpose:  Drains whatever is still queued, stops the sink thread and flushes.  Has to be called before the
+   //           sink is deleted, the Logger does this at Shutdown.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::Stop()
+   {
+      //The sink thread drains the stages before it exits.
+      if (m_bThreaded)
+      {
+         m_bRunning.store(false, std::memory_order_release);
+         if (m_tThread.joinable())
+            m_tThread.join();
+         m_bThreaded = false;
+      }
+
+      std::lock_guard<std::mutex> lgWrite(m_mtxWrite);
+      this->EndBatch(true);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Claim
+   //
+   // Purpose:  Reserves a slot in the calling thread's stage for it to fill in.  A full stage is dealt with
+   //           according to the sink's eBackpressure, drops being counted.  Threaded sinks only.
+   //
+   // In:  tTicket - Receives the slot.
+   //      ucLevel - eLevel of the message, for DROP_BELOW_LEVEL.
+   //
+   // Out:  true if a slot was claimed.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATLogSink::Claim(STicket& tTicket, unsigned char ucLevel)
+   {
+      tTicket.m_pStage = GetStage();
+      CATLogQueue<SATLogRecord>& Queue = tTicket.m_pStage->m_Queue;
+      unsigned char ucPolicy = m_ucBackpressure.load(std::memory_order_relaxed);
+      bool bLow = (ucPolicy == DROP_BELOW_LEVEL && ucLevel > m_ucKeepLevel.load(std::memory_order_relaxed));
+
+      //Less important messages give up early, leaving the rest of the stage for the ones that matter.
+      if (!(bLow && Queue.Size() * 4 >= Queue.Capacity() * AT_LOG_STAGE_LOW_SHARE) && Queue.Claim(tTicket.m_tSlot))
+         return true;
+
+      //Waiting on the sink thread from the sink thread would never end, and neither would waiting on one that's
+      //stopping.
+      if (ucPolicy == DROP_NEWEST || bLow || std::this_thread::get_id() == m_tThread.get_id() ||
+         !m_bRunning.load(std::memory_order_acquire))
+      {
+         m_ullDropped.fetch_add(1, std::memory_order_relaxed);
+         return false;
+      }
+
+      if (ucPolicy != OVERWRITE_OLDEST)
+         m_ullBlocked.fetch_add(1, std::memory_order_relaxed);
+
+      unsigned int unTries = 0;
+      for (;;)
+      {
+         //Only throw a record away while the stage really is full.  Otherwise the sink thread is just finishing
+         //up with the oldest slot and it'll be free in a moment.
+         if (ucPolicy == OVERWRITE_OLDEST && Queue.Size() >= Queue.Capacity() && Queue.Discard())
+            m_ullOverwritten.fetch_add(1, std::memory_order_relaxed);
+
+         if (Queue.Claim(tTicket.m_tSlot))
+            return true;
+
+         if (++unTries < 64 || ucPolicy == OVERWRITE_OLDEST)
+            std::this_thread::yield();
+         else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  GetStage
+   //
+   // Purpose:  Returns the calling thread's stage, making one and pushing it on the front of the sink's list the
+   //           first time the thread logs to this sink.  A thread with more than AT_LOG_STAGE_CACHE stages open
+   //           lets go of one, which then drains and is cleaned up by the sink thread like that of a thread that
+   //           exited.
+   //
+   // In:  None
+   //
+   // Out:  The stage.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   SATLogStage* CATLogSink::GetStage()
+   {
+      SATStageCache& Cache = s_scStages;
+      for (unsigned int i = 0; i < AT_LOG_STAGE_CACHE; i++)
+      {
+         if (Cache.m_aullSinks[i] == m_ullId)
+            return Cache.m_apStages[i];
+      }
+
+      SATLogStage* pStage = new SATLogStage(AT_LOG_SINK_QUEUE_SIZE);
+      SATLogStage* pHead = m_pStages.load(std::memory_order_relaxed);
+      do
+         pStage->m_pNext = pHead;
+      while (!m_pStages.compare_exchange_weak(pHead, pStage, std::memory_order_release, std::memory_order_relaxed));
+
+      //Take an empty entry if there is one, otherwise give one up.
+      unsigned int unEntry = AT_LOG_STAGE_CACHE;
+      for (unsigned int i = 0; i < AT_LOG_STAGE_CACHE && unEntry == AT_LOG_STAGE_CACHE; i++)
+      {
+         if (!Cache.m_apStages[i])
+            unEntry = i;
+      }
+      if (unEntry == AT_LOG_STAGE_CACHE)
+      {
+         unEntry = Cache.m_unNext++ % AT_LOG_STAGE_CACHE;
+         Cache.m_apStages[unEntry]->Release();
+      }
+
+      Cache.m_aullSinks[unEntry] = m_ullId;
+      Cache.m_apStages[unEntry] = pStage;
+      return pStage;
+   }
+
+   //The stage whose next record was logged first, so the sink thread writes the stages back out in time stamp order.
+   //Under OVERWRITE_OLDEST a time stamp can change as it's read, which only means Take may find a different record.
+   SATLogStage* CATLogSink::OldestStage(unsigned long long& ullOldest)
+   {
+      SATLogStage* pOldest = 0;
+      ullOldest = 0;
+      for (SATLogStage* pStage = m_pStages.load(std::memory_order_acquire); pStage; pStage = pStage->m_pNext)
+      {
+         SATLogRecord* pRecord = pStage->m_Queue.Front();
+         if (pRecord && (!pOldest || pRecord->m_ullTimestamp < ullOldest))
+         {
+            pOldest = pStage;
+            ullOldest = pRecord->m_ullTimestamp;
+         }
+      }
+      return pOldest;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  ReleaseStages
+   //
+   // Purpose:  Lets go of the stages whose thread is done with them and that have nothing left in them, or every
+   //           stage if bAll.  Only the sink thread (or the destructor once it's gone) walks the list and new stages
+   //           only ever go on the front, so anything past the first can be unlinked without a lock.
+   //
+   // In:  bAll - Let go of every stage, the sink is being deleted.
+   //
+   // Out:  Number of records waiting in the stages that are left.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned long long CATLogSink::ReleaseStages(bool bAll)
+   {
+      SATLogStage* pPrevious = m_pStages.load(std::memory_order_acquire);
+      if (bAll)
+      {
+         m_pStages.store(0, std::memory_order_relaxed);
+         while (pPrevious)
+         {
+            SATLogStage* pNext = pPrevious->m_pNext;
+            pPrevious->Release();
+            pPrevious = pNext;
+         }
+         return 0;
+      }
+
+      if (!pPrevious)
+         return 0;
+
+      //A slot claimed but not yet published still counts in Size, so a stage is never let go of mid write.
+      unsigned long long ullDepth = pPrevious->m_Queue.Size();
+      SATLogStage* pStage = pPrevious->m_pNext;
+      while (pStage)
+      {
+         SATLogStage* pNext = pStage->m_pNext;
+         if (pStage->m_unRefs.load(std::memory_order_acquire) == 1 && pStage->m_Queue.Size() == 0)
+         {
+            pPrevious->m_pNext = pNext;
+            pStage->Release();
+         }
+         else
+         {
+            ullDepth += pStage->m_Queue.Size();
+            pPrevious = pStage;
+         }
+         pStage = pNext;
+      }
+      return ullDepth;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Write
+   //
+   // Purpose:  Outputs a record straight from the calling thread, for sinks without a thread of their own.
+   //
+   // In:  Record - The record, its time stamp already in nanoseconds since the epoch.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::Write(const SATLogRecord& Record)
+   {
+      std::lock_guard<std::mutex> lgWrite(m_mtxWrite);
+      this->WriteRecord(Record);
+      this->EndBatch(false);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Flush
+   //
+   // Purpose:  Makes sure every record handed to the sink before this call has been written out.  Waits on the
+   //           sink thread if there is one.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::Flush()
+   {
+      //Sink thread owns the output, ask it to flush and wait for it to get to our request.
+      if (m_bThreaded && std::this_thread::get_id() != m_tThread.get_id())
+      {
+         unsigned long long ullTicket = m_ullFlushRequested.fetch_add(1, std::memory_order_acq_rel) + 1;
+         while (m_ullFlushCompleted.load(std::memory_order_acquire) < ullTicket)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+         return;
+      }
+
+      std::lock_guard<std::mutex> lgWrite(m_mtxWrite);
+      this->EndBatch(true);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Tick
+   //
+   // Purpose:  Ends an empty batch so time based output still happens while nothing is being written.  Skipped if
+   //           a calling thread is writing to the sink right now, it ends its own batch.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::Tick()
+   {
+      std::unique_lock<std::mutex> ulWrite(m_mtxWrite, std::try_to_lock);
+      if (ulWrite.owns_lock())
+         this->EndBatch(false);
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  SinkThread
+   //
+   // Purpose:  Drains the sink's stages in batches of up to m_unBatchSize records, always taking the oldest record
+   //           waiting across all of them, and turns each record's time stamp into wall clock time on the way.
+   //           Backs off to short sleeps while idle and exits once Stop clears m_bRunning and the stages are empty.
+   //
+   // In:  None
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogSink::SinkThread()
+   {
+      unsigned int unIdle = 0;  //Number of passes in a row that found nothing to do.
+      SATLogRecord Record;  //The record being written.
+      for (;;)
+      {
+         //Grab the flags before draining so nothing published before Stop or Flush gets left behind.
+         bool bRunning = m_bRunning.load(std::memory_order_acquire);
+         unsigned long long ullFlush = m_ullFlushRequested.load(std::memory_order_acquire);
+         bool bFlush = (ullFlush != m_ullFlushCompleted.load(std::memory_order_relaxed));
+
+         //Only this thread writes the high water mark, so there's nothing to race.
+         unsigned long long ullDepth = ReleaseStages(false);
+         if (ullDepth > m_ullQueueHighWater.load(std::memory_order_relaxed))
+            m_ullQueueHighWater.store(ullDepth, std::memory_order_relaxed);
+
+         //A flush has to see everything published before it was asked for, so it drains every stage up to the
+         //moment it was picked up.  Records logged after that wait for the next batch, otherwise threads that keep
+         //logging would keep the flush from ever finishing.
+         //Each record is copied out before it's written, so its slot goes straight back to the calling thread and
+         //OVERWRITE_OLDEST can't reuse it while it's being formatted.
+         unsigned long long ullCutoff = bFlush ? CATLogClock::Now() : 0;
+         unsigned long long ullOldest = 0;
+         unsigned int unCount = 0;
+         SATLogStage* pStage = OldestStage(ullOldest);
+         while (pStage && (!bRunning || unCount < m_unBatchSize || (bFlush && ullOldest <= ullCutoff)))
+         {
+            bool bTaken = pStage->m_Queue.Take([&Record](const SATLogRecord& Queued)
+               { memcpy(&Record, &Queued, offsetof(SATLogRecord, m_cData) + Queued.m_usLength); });
+            if (bTaken)
+            {
+               Record.m_ullTimestamp = CATLogClock::ToNanoseconds(Record.m_ullTimestamp);
+               this->WriteRecord(Record);
+               unCount++;
+            }
+            pStage = OldestStage(ullOldest);
+         }
+
+         this->EndBatch(bFlush);
+         if (bFlush)
+            m_ullFlushCompleted.store(ullFlush, std::memory_order_release);
+
+         if (unCount > 0)
+         {
+            unIdle = 0;
+            continue;
+         }
+
+         if (!bRunning)
+            break;
+
+         //Nothing to do, spin for a bit then fall back to sleeping.
+         if (++unIdle < 64)
+            std::this_thread::yield();
+         else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+   }
+}
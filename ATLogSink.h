@@ -0,0 +1,277 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogSink.h
+//
+// Purpose: Base class for everywhere the Logger's messages can go (Console, file, memory, ...).  Every sink has its own
+//          level mask, formatter and batching, and when the Logger runs ASYNC its own thread, so a slow sink drains on
+//          its own schedule without holding back the others.  Each calling thread gets its own queue into a threaded
+//          sink (a stage), so threads logging at once never fight over a shared cursor, and the sink thread merges the
+//          stages back together in time stamp order.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "ATLogQueue.h"
+#include "ATLogRecord.h"
+#include "ATLogFormat.h"
+
+//Number of records each calling thread can have waiting on a threaded sink before its messages to that sink start
+//getting dropped.
+#ifndef AT_LOG_SINK_QUEUE_SIZE
+#define AT_LOG_SINK_QUEUE_SIZE 2048
+#endif
+
+//Fraction of a stage, out of 4, low level messages may fill under DROP_BELOW_LEVEL.  The rest is kept for the
+//levels that are never dropped.
+#ifndef AT_LOG_STAGE_LOW_SHARE
+#define AT_LOG_STAGE_LOW_SHARE 3
+#endif
+
+//Number of stages each thread keeps handy before it has to let go of one (see CATLogSink::GetStage).
+#ifndef AT_LOG_STAGE_CACHE
+#define AT_LOG_STAGE_CACHE 16
+#endif
+
+//Most records a sink thread writes before ending the batch (see CATLogSink::EndBatch).
+#ifndef AT_LOG_SINK_BATCH
+#define AT_LOG_SINK_BATCH 256
+#endif
+
+namespace Atlas
+{
+   //Builds the text of a record.
+   //In:  fbOut - Where the text is going.
+   //     Record - The record, its time stamp already in nanoseconds since the epoch.
+   //     bTimestamp - Start the message off with its time stamp?
+   //     unDigits - Digits after the seconds in the time stamp.
+   typedef void (*ATLogFormatter)(CATFormatBuffer& fbOut, const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits);
+
+   //A calling thread's own queue into a threaded sink.  Held by both the thread and the sink, whichever lets go last
+   //deletes it.
+   struct SATLogStage
+   {
+      CATLogQueue<SATLogRecord>  m_Queue;  //Records waiting on the sink thread, only the owning thread fills it in.
+      std::atomic<unsigned int>  m_unRefs;  //2 while both the thread and the sink hold it.
+      SATLogStage*               m_pNext;  //Next stage of the same sink.
+
+      explicit SATLogStage(size_t unCapacity) : m_Queue(unCapacity), m_unRefs(2), m_pNext(0) {}
+
+      //Lets go of one hold on the stage, deleting it if that was the last.
+      void Release()
+      {
+         if (m_unRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+      }
+   };
+
+   class CATLogSink
+   {
+      private:
+         std::atomic<SATLogStage*>     m_pStages;  //Every calling thread's queue into this sink, newest first.
+         unsigned long long            m_ullId;  //Tells the sinks apart in each thread's stage cache, never reused.
+         bool                          m_bThreaded;  //Does the sink have its own thread?
+         std::thread                   m_tThread;  //The sink's thread.
+         std::atomic<bool>             m_bRunning;  //Tells the sink thread to keep going.
+         std::mutex                    m_mtxWrite;  //Held while writing from the calling thread when there's no sink thread.
+
+         std::atomic<unsigned char>    m_ucLevelMask;  //Levels this sink outputs (CATLogger::LevelMask).
+         std::atomic<bool>             m_bTimestamp;  //Start messages off with a time stamp?
+         std::atomic<unsigned char>    m_ucTimestampDigits;  //Digits after the seconds in time stamps.
+         ATLogFormatter                m_pfnFormatter;  //Builds the text of a record.
+         unsigned int                  m_unBatchSize;  //Most records written before ending a batch.
+
+         std::atomic<unsigned char>    m_ucBackpressure;  //What a calling thread does when its stage is full (eBackpressure).
+         std::atomic<unsigned char>    m_ucKeepLevel;  //Least important level DROP_BELOW_LEVEL never drops.
+
+         std::atomic<unsigned long long> m_ullDropped;  //Number of records dropped because a stage was full (or the sink said so).
+         std::atomic<unsigned long long> m_ullOverwritten;  //Number of waiting records thrown away by OVERWRITE_OLDEST.
+         std::atomic<unsigned long long> m_ullBlocked;  //Number of records a calling thread had to wait on room for.
+         std::atomic<unsigned long long> m_ullBytesWritten;  //Bytes output by the sink, see AddBytesWritten.
+         std::atomic<unsigned long long> m_ullQueueHighWater;  //Most records the stages have held at once.
+         std::atomic<unsigned long long> m_ullFlushRequested;  //Number of times Flush has asked the sink thread to flush.
+         std::atomic<unsigned long long> m_ullFlushCompleted;  //Number of those requests the sink thread has finished.
+
+         void SinkThread();  //Drains the stages.
+         SATLogStage* GetStage();  //The calling thread's stage, made the first time it's asked for.
+         SATLogStage* OldestStage(unsigned long long& ullOldest);  //The stage whose next record was logged first (and when), 0 if they're all empty.
+         unsigned long long ReleaseStages(bool bAll);  //Lets go of stages, returns how many records the rest hold.
+
+         CATLogSink(const CATLogSink&);  //Copy Constructor
+         CATLogSink& operator=(const CATLogSink&);  //Assignment Operator
+
+      protected:
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  WriteRecord
+         //
+         // Purpose:  Outputs a single record.  By default this builds the text with the sink's formatter and hands it
+         //           to WriteText, sinks that want the raw record (e.g. BINARY files) override this instead.
+         //
+         // In:  Record - The record, its time stamp already in nanoseconds since the epoch.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         virtual void WriteRecord(const SATLogRecord& Record);
+
+         //Outputs a completed message, pText is null terminated.
+         virtual void WriteText(unsigned char /*ucLevel*/, const char* /*pText*/, unsigned int /*unLength*/) {}
+
+         //Called after every batch of records, bFlush is set when everything written so far has to go out now.
+         virtual void EndBatch(bool /*bFlush*/) {}
+
+         void FormatRecord(CATFormatBuffer& fbOut, const SATLogRecord& Record);  //Builds a record's text with this sink's formatter.
+
+         //Counts bytes the sink has output, for the Logger's stats.  Sinks call this as they write.
+         void AddBytesWritten(unsigned long long ullBytes) { m_ullBytesWritten.fetch_add(ullBytes, std::memory_order_relaxed); }
+
+         //Counts records the sink had to throw away on its own, e.g. because whatever it outputs to went away.
+         void AddDropped(unsigned long long ullRecords) { m_ullDropped.fetch_add(ullRecords, std::memory_order_relaxed); }
+
+      public:
+
+         //What a calling thread does with a message when its stage of the sink is full.
+         //BLOCK - Wait on the sink thread to make room.  Nothing is lost, but the caller is held up.
+         //DROP_NEWEST - Drop the new message (the default).
+         //OVERWRITE_OLDEST - Throw away the oldest message waiting to make room, keeping the most recent ones.
+         //DROP_BELOW_LEVEL - Drop messages less important than the keep level, starting once the stage is
+         //                   AT_LOG_STAGE_LOW_SHARE quarters full, and wait for room for the rest like BLOCK.
+         enum eBackpressure {BLOCK = 0, DROP_NEWEST, OVERWRITE_OLDEST, DROP_BELOW_LEVEL};
+
+         //Handle to a slot claimed in one of the sink's stages, filled in by the calling thread then handed to Publish.
+         struct STicket
+         {
+            CATLogQueue<SATLogRecord>::STicket  m_tSlot;  //The slot, m_tSlot.m_pData is the record to fill in.
+            SATLogStage*                        m_pStage;  //Stage the slot belongs to.
+         };
+
+         CATLogSink();  //Constructor
+         virtual ~CATLogSink();  //Destructor
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  DefaultFormatter
+         //
+         // Purpose:  The formatter sinks start out with, builds the same "[time stamp] [channel] message" text the
+         //           Logger always has.
+         //
+         // In:  fbOut - Where the text is going.
+         //      Record - The record, its time stamp already in nanoseconds since the epoch.
+         //      bTimestamp - Start the message off with its time stamp?
+         //      unDigits - Digits after the seconds in the time stamp.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void DefaultFormatter(CATFormatBuffer& fbOut, const SATLogRecord& Record, bool bTimestamp, unsigned int unDigits);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Start
+         //
+         // Purpose:  Gets the sink ready to take records, spinning up its thread if asked to.  Called by the Logger
+         //           when the sink is added.
+         //
+         // In:  bThreaded - Give the sink its own thread (ASYNC)?
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Start(bool bThreaded);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Stop
+         //
+         // Purpose:  Drains whatever is still queued, stops the sink thread and flushes.  Has to be called before the
+         //           sink is deleted, the Logger does this at Shutdown.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Stop();
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Claim
+         //
+         // Purpose:  Reserves a slot in the calling thread's stage for it to fill in.  A full stage is dealt with
+         //           according to the sink's eBackpressure, drops being counted.  Threaded sinks only.
+         //
+         // In:  tTicket - Receives the slot.
+         //      ucLevel - eLevel of the message, for DROP_BELOW_LEVEL.
+         //
+         // Out:  true if a slot was claimed.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Claim(STicket& tTicket, unsigned char ucLevel);
+
+         //Hands a slot filled in after Claim over to the sink thread.
+         void Publish(const STicket& tTicket) { tTicket.m_pStage->m_Queue.Publish(tTicket.m_tSlot); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Write
+         //
+         // Purpose:  Outputs a record straight from the calling thread, for sinks without a thread of their own.
+         //
+         // In:  Record - The record, its time stamp already in nanoseconds since the epoch.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Write(const SATLogRecord& Record);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Flush
+         //
+         // Purpose:  Makes sure every record handed to the sink before this call has been written out.  Waits on the
+         //           sink thread if there is one.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Flush();
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Tick
+         //
+         // Purpose:  Ends an empty batch so time based output (flushing after the interval, rolling over, ...) still
+         //           happens while nothing is being written.  For sinks without a thread of their own, the Logger's
+         //           tick thread calls it.  Skipped if a calling thread is writing to the sink right now.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Tick();
+
+         //Does this sink output messages of the given level bit?
+         bool Accepts(unsigned char ucLevelBit) const { return (m_ucLevelMask.load(std::memory_order_relaxed) & ucLevelBit) != 0; }
+
+         bool IsThreaded() const { return m_bThreaded; }  //Does the sink have its own thread?
+         void SetLevelMask(unsigned char ucMask) { m_ucLevelMask.store(ucMask, std::memory_order_relaxed); }  //Levels this sink outputs (CATLogger::LevelMask).
+         void SetTimestamp(bool bTimestamp) { m_bTimestamp.store(bTimestamp, std::memory_order_relaxed); }  //Start messages off with a time stamp?
+         void SetTimestampDigits(unsigned int unDigits) { m_ucTimestampDigits.store(static_cast<unsigned char>(unDigits), std::memory_order_relaxed); }  //Digits after the seconds.
+         void SetFormatter(ATLogFormatter pfnFormatter) { m_pfnFormatter = pfnFormatter ? pfnFormatter : DefaultFormatter; }  //Call before the sink is added.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetBackpressure
+         //
+         // Purpose:  Sets what a calling thread does when its stage of this sink is full, see eBackpressure.  Only
+         //           matters for threaded sinks, the others write on the calling thread and never fill up.
+         //
+         // In:  ePolicy - The policy.
+         //      ucKeepLevel - For DROP_BELOW_LEVEL, the least important eLevel that is never dropped (ERR, WARN,
+         //                    TRACE or INFO).  ERR keeps only errors.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetBackpressure(eBackpressure ePolicy, unsigned char ucKeepLevel = 0)
+         {
+            m_ucKeepLevel.store(ucKeepLevel, std::memory_order_relaxed);
+            m_ucBackpressure.store(static_cast<unsigned char>(ePolicy), std::memory_order_relaxed);
+         }
+
+         void SetBatchSize(unsigned int unBatchSize) { m_unBatchSize = unBatchSize ? unBatchSize : 1; }  //Call before the sink is added.
+         bool HasTimestamp() const { return m_bTimestamp.load(std::memory_order_relaxed); }
+         unsigned int GetTimestampDigits() const { return m_ucTimestampDigits.load(std::memory_order_relaxed); }
+         unsigned long long GetDroppedCount() const { return m_ullDropped.load(std::memory_order_relaxed); }
+         unsigned long long GetOverwrittenCount() const { return m_ullOverwritten.load(std::memory_order_relaxed); }
+         unsigned long long GetBlockedCount() const { return m_ullBlocked.load(std::memory_order_relaxed); }
+         unsigned long long GetBytesWritten() const { return m_ullBytesWritten.load(std::memory_order_relaxed); }
+         unsigned long long GetQueueHighWater() const { return m_ullQueueHighWater.load(std::memory_order_relaxed); }
+   };
+}
@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogSite.h
+//
+// Purpose: State kept by a single Log call site for the sampling macros (AT_LOG_*_EVERY_N, AT_LOG_*_RATE and
+//          AT_LOG_*_ONCE, plus their _C versions on a channel), so a message firing every frame from a hot loop can be
+//          thinned out before any of its arguments are evaluated.  Each macro keeps one of these as a function level
+//          static, checking it is a relaxed atomic or two.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace Atlas
+{
+   class CATLogSite
+   {
+      private:
+         std::atomic<unsigned int>  m_unCount;  //Calls made (EveryN), or calls made this second (Rate).
+         std::atomic<long long>     m_llSecond;  //Second m_unCount is counting for (Rate).
+         std::atomic<bool>          m_bDone;  //Has the message gone out (Once)?
+
+      public:
+         constexpr CATLogSite() : m_unCount(0), m_llSecond(0), m_bDone(false) {}  //Constructor, constexpr so a static one needs no guard.
+
+         //Lets the 1st, (n + 1)th, (2n + 1)th, ... call through.
+         bool EveryN(unsigned int unN)
+         {
+            return unN <= 1 || (m_unCount.fetch_add(1, std::memory_order_relaxed) % unN) == 0;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Rate
+         //
+         // Purpose:  Lets up to unPerSecond calls through each second, counting in whole seconds of the steady clock.
+         //           Threads racing over a new second may let a call or two more through, never fewer.
+         //
+         // In:  unPerSecond - Most calls let through in one second.
+         //
+         // Out:  true if this call gets through.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Rate(unsigned int unPerSecond)
+         {
+            long long llNow = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            long long llSecond = m_llSecond.load(std::memory_order_relaxed);
+            if (llNow != llSecond && m_llSecond.compare_exchange_strong(llSecond, llNow, std::memory_order_relaxed))
+               m_unCount.store(0, std::memory_order_relaxed);
+            return m_unCount.fetch_add(1, std::memory_order_relaxed) < unPerSecond;
+         }
+
+         //Lets only the first call through.
+         bool Once()
+         {
+            return !m_bDone.load(std::memory_order_relaxed) && !m_bDone.exchange(true, std::memory_order_relaxed);
+         }
+   };
+}
@@ -0,0 +1,370 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogSocketSink.cpp
+//
+// Purpose: Sink that ships raw records over a Unix domain socket to ATLogCollector.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogSocketSink.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <process.h>
+#define AT_GETPID _getpid
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define AT_GETPID getpid
+#endif
+
+//Writing to a collector that's gone shouldn't kill the process with SIGPIPE.
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace Atlas
+{
+   //Constructor
+   CATSocketWriter::CATSocketWriter()
+   {
+      m_nSocket = -1;
+      m_pBuffer = new char[AT_LOG_SOCKET_BUFFER];
+      m_unUsed = 0;
+      m_unSent = 0;
+      m_unWait = 0;
+      m_ullBytesSent = 0;
+      m_ullBytesQueued = 0;
+   }
+
+   //Destructor
+   CATSocketWriter::~CATSocketWriter()
+   {
+      this->Close();
+      delete[] m_pBuffer;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Connect
+   //
+   // Purpose:  Connects to a Unix domain socket, hanging up on any connection that was already open.  Never
+   //           waits, a listener with a full backlog counts as not being there.
+   //
+   // In:  pPath - Path of the socket.
+   //
+   // Out:  true if connected, false otherwise (always on Windows).
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATSocketWriter::Connect(const char* pPath)
+   {
+      this->Close();
+
+#ifdef _WIN32
+      return false;
+#else
+      sockaddr_un saAddress;
+      memset(&saAddress, 0, sizeof(saAddress));
+      saAddress.sun_family = AF_UNIX;
+      if (!pPath || strlen(pPath) >= sizeof(saAddress.sun_path))
+         return false;
+      strcpy(saAddress.sun_path, pPath);
+
+      m_nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (m_nSocket < 0)
+         return false;
+
+      fcntl(m_nSocket, F_SETFD, FD_CLOEXEC);
+      fcntl(m_nSocket, F_SETFL, fcntl(m_nSocket, F_GETFL, 0) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+      int nOn = 1;
+      setsockopt(m_nSocket, SOL_SOCKET, SO_NOSIGPIPE, &nOn, sizeof(nOn));
+#endif
+
+      if (connect(m_nSocket, reinterpret_cast<sockaddr*>(&saAddress), sizeof(saAddress)) != 0)
+      {
+         this->Close();
+         return false;
+      }
+      return true;
+#endif
+   }
+
+   //Hangs up, throwing away anything that wasn't sent.
+   void CATSocketWriter::Close()
+   {
+#ifndef _WIN32
+      if (m_nSocket >= 0)
+         close(m_nSocket);
+#endif
+      m_nSocket = -1;
+      m_unUsed = 0;
+      m_unSent = 0;
+      m_ullBytesQueued = m_ullBytesSent;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Write
+   //
+   // Purpose:  Adds bytes to the buffer, sending what's already there first if they won't fit.  Each Write is
+   //           all or nothing, so a stream made of whole writes (e.g. indexed blocks) is never cut mid entry.
+   //           Without a stall timeout bytes that don't fit are thrown away.  With one, an other end that takes
+   //           nothing for that long is hung up on.  Bytes written while there's no connection go nowhere.
+   //
+   // In:  pData - The bytes.
+   //      unLength - Number of bytes in pData.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATSocketWriter::Write(const char* pData, unsigned int unLength)
+   {
+      if (m_nSocket < 0)
+         return;
+
+      if (m_unUsed + unLength > AT_LOG_SOCKET_BUFFER)
+      {
+         if (!this->Send(m_unWait))
+            return;
+
+         //Slide what's left to the front so the room freed up by the send can be used.
+         memmove(m_pBuffer, m_pBuffer + m_unSent, m_unUsed - m_unSent);
+         m_unUsed -= m_unSent;
+         m_unSent = 0;
+
+         //Send only gives up waiting once the other end has stopped taking anything, so hang up on it.
+         if (m_unUsed + unLength > AT_LOG_SOCKET_BUFFER)
+         {
+            if (m_unWait > 0)
+               this->Close();
+            return;
+         }
+      }
+
+      memcpy(m_pBuffer + m_unUsed, pData, unLength);
+      m_unUsed += unLength;
+      m_ullBytesQueued += unLength;
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Send
+   //
+   // Purpose:  Sends as much of the buffer as the other end will take.  With unWait it keeps going until the
+   //           buffer is empty or nothing has gone out for unWait milliseconds.
+   //
+   // In:  unWait - Milliseconds to wait on the other end between sends, 0 to only send what goes right away.
+   //
+   // Out:  false if the connection was lost (or there wasn't one), true otherwise.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATSocketWriter::Send(unsigned int unWait)
+   {
+#ifdef _WIN32
+      return false;
+#else
+      if (m_nSocket < 0)
+         return false;
+
+      while (m_unSent < m_unUsed)
+      {
+         ssize_t nSent = send(m_nSocket, m_pBuffer + m_unSent, m_unUsed - m_unSent, MSG_NOSIGNAL);
+         if (nSent > 0)
+         {
+            m_unSent += static_cast<unsigned int>(nSent);
+            m_ullBytesSent += static_cast<unsigned long long>(nSent);
+            continue;
+         }
+
+         if (nSent < 0 && errno == EINTR)
+            continue;
+
+         if (nSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+         {
+            if (unWait == 0)
+               break;
+
+            pollfd pfSocket;
+            pfSocket.fd = m_nSocket;
+            pfSocket.events = POLLOUT;
+            pfSocket.revents = 0;
+            int nReady = poll(&pfSocket, 1, static_cast<int>(unWait));
+            if (nReady == 0)
+               break;
+            if (nReady > 0 || errno == EINTR)
+               continue;
+         }
+
+         //The other end hung up (or something worse), everything it hadn't taken is gone.
+         this->Close();
+         return false;
+      }
+
+      if (m_unSent == m_unUsed)
+      {
+         m_unUsed = 0;
+         m_unSent = 0;
+      }
+      return true;
+#endif
+   }
+
+   //Constructor
+   CATSocketSink::CATSocketSink(const char* pSource) : m_Binary(&m_Socket)
+   {
+      if (pSource && *pSource)
+         snprintf(m_cSource, sizeof(m_cSource), "%s", pSource);
+      else
+         snprintf(m_cSource, sizeof(m_cSource), "%d", static_cast<int>(AT_GETPID()));
+
+      //Braces would turn the collector's "[source] " prefix into a placeholder.
+      for (char* pChar = m_cSource; *pChar; pChar++)
+      {
+         if (*pChar == '{' || *pChar == '}')
+            *pChar = '_';
+      }
+
+      m_tpRetry = std::chrono::steady_clock::now();
+   }
+
+   //Destructor
+   CATSocketSink::~CATSocketSink()
+   {
+      this->Close();
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Open
+   //
+   // Purpose:  Sets the collector's socket and tries to connect.  The stream's header is written with the
+   //           sink's current time stamp settings, so set those first.  A collector that isn't up yet is tried
+   //           again every AT_LOG_SOCKET_RETRY, messages logged in the meantime are counted as dropped.
+   //
+   // In:  sPath - Path of the socket ATLogCollector is listening on.
+   //
+   // Out:  true if the collector was reached.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATSocketSink::Open(const CString& sPath)
+   {
+      m_sPath = sPath;
+      m_tpRetry = std::chrono::steady_clock::now();
+      return this->Reconnect();
+   }
+
+   //Sends whatever is left and hangs up for good.
+   void CATSocketSink::Close()
+   {
+      if (m_Socket.IsConnected())
+      {
+         unsigned long long ullQueued = m_Socket.GetBytesQueued();
+         unsigned int unCount = m_Binary.GetBlockCount();
+         m_Binary.EndBlock();
+         if (unCount > 0)
+            this->BlockEnded(unCount, ullQueued);
+         m_Socket.Send(AT_LOG_SOCKET_STALL);
+
+         //Whatever the collector didn't take in time is lost with the connection.
+         m_Socket.Close();
+         this->CheckSent();
+      }
+      m_sPath = "";
+   }
+
+   //Connects and starts a new stream, the header then our name, if it's time to try.  Each connection is a fresh
+   //stream, so the collector never sees half a block from a connection that was dropped.
+   bool CATSocketSink::Reconnect()
+   {
+      std::chrono::steady_clock::time_point tpNow = std::chrono::steady_clock::now();
+      if (m_sPath.Empty() || tpNow < m_tpRetry)
+         return false;
+
+      m_tpRetry = tpNow + std::chrono::milliseconds(AT_LOG_SOCKET_RETRY);
+      if (!m_Socket.Connect(m_sPath.getCstr()))
+         return false;
+
+      unsigned short usFlags = static_cast<unsigned short>(CATLogBinary::FILE_INDEXED | (this->GetTimestampDigits() << CATLogBinary::FILE_DIGITS_SHIFT));
+      if (this->HasTimestamp())
+         usFlags |= CATLogBinary::FILE_TIMESTAMP;
+      m_Binary.Begin(usFlags);
+
+      char cSource[CATLogBinary::SOURCE_HEADER_SIZE];
+      unsigned int unLength = static_cast<unsigned int>(strlen(m_cSource));
+      cSource[0] = CATLogBinary::ENTRY_SOURCE;
+      cSource[1] = static_cast<char>(unLength);
+      m_Socket.Write(cSource, sizeof(cSource));
+      m_Socket.Write(m_cSource, unLength);
+      return true;
+   }
+
+   //Tracks a block just handed to the socket, ullQueued being CATSocketWriter::GetBytesQueued from before.  If the
+   //socket had no room for it, or the connection went down writing it, its records are counted as dropped.
+   void CATSocketSink::BlockEnded(unsigned int unCount, unsigned long long ullQueued)
+   {
+      if (m_Socket.IsConnected() && m_Socket.GetBytesQueued() != ullQueued)
+         m_dqSent.push_back(SSentBlock{m_Socket.GetBytesQueued(), unCount});
+      else
+         this->AddDropped(unCount);
+   }
+
+   //Lets go of the blocks the collector has all of.  If the connection was lost, every record it didn't get (the
+   //blocks it only got part of and the block being gathered up, which starts over on reconnect) is counted as dropped.
+   void CATSocketSink::CheckSent()
+   {
+      if (!m_Socket.IsConnected())
+      {
+         unsigned long long ullLost = m_Binary.GetBlockCount();
+         for (const SSentBlock& Block : m_dqSent)
+         {
+            if (Block.m_ullEnd > m_Socket.GetBytesSent())
+               ullLost += Block.m_unCount;
+         }
+         m_dqSent.clear();
+         this->AddDropped(ullLost);
+         return;
+      }
+
+      while (!m_dqSent.empty() && m_dqSent.front().m_ullEnd <= m_Socket.GetBytesSent())
+         m_dqSent.pop_front();
+   }
+
+   //Adds the raw record to the current block, or drops it if the collector can't be reached.
+   void CATSocketSink::WriteRecord(const SATLogRecord& Record)
+   {
+      if (!m_Socket.IsConnected() && !this->Reconnect())
+      {
+         this->AddDropped(1);
+         return;
+      }
+
+      //Only the sink thread is allowed to wait on the collector, and then only so long.
+      m_Socket.SetStallTimeout(this->IsThreaded() ? AT_LOG_SOCKET_STALL : 0);
+
+      //A record that doesn't fit sends the full block out ahead of it.
+      unsigned long long ullSent = m_Socket.GetBytesSent();
+      unsigned long long ullQueued = m_Socket.GetBytesQueued();
+      unsigned int unCount = m_Binary.GetBlockCount();
+      m_Binary.Write(Record);
+      if (m_Binary.GetBlockCount() <= unCount)
+         this->BlockEnded(unCount, ullQueued);
+      this->AddBytesWritten(m_Socket.GetBytesSent() - ullSent);
+      this->CheckSent();
+   }
+
+   //Sends the block if it's due, or right now if asked to.  A flush waits on the collector up to AT_LOG_SOCKET_STALL,
+   //anything else only sends what the socket takes right away.
+   void CATSocketSink::EndBatch(bool bFlush)
+   {
+      if (!m_Socket.IsConnected())
+         return;
+
+      unsigned long long ullSent = m_Socket.GetBytesSent();
+      unsigned long long ullQueued = m_Socket.GetBytesQueued();
+      unsigned int unCount = m_Binary.GetBlockCount();
+      if (bFlush)
+         m_Binary.EndBlock();
+      else
+         m_Binary.EndBlockIfDue();
+      if (unCount > 0 && m_Binary.GetBlockCount() == 0)
+         this->BlockEnded(unCount, ullQueued);
+      m_Socket.Send(bFlush ? AT_LOG_SOCKET_STALL : 0);
+      this->AddBytesWritten(m_Socket.GetBytesSent() - ullSent);
+      this->CheckSent();
+   }
+}
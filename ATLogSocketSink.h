@@ -0,0 +1,163 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogSocketSink.h
+//
+// Purpose: Sink that ships raw records over a Unix domain socket to a local ATLogCollector, which merges every process's
+//          stream into one time ordered, rolled over Log.  Records go out in the FILE_INDEXED binary format, so a whole
+//          block of them (AT_LOG_BLOCK_SIZE bytes, hundreds of records) costs a single send.
+//
+//          The socket never holds up the process.  Sends are non-blocking and whatever the collector hasn't taken yet
+//          waits in a fixed size buffer.  When that's full a sink without a thread drops the block, while a threaded
+//          sink waits on the collector, which backs the stages up into the sink's eBackpressure policy like any slow
+//          sink.  A collector that takes nothing for AT_LOG_SOCKET_STALL is hung up on and the sink tries to reconnect
+//          every AT_LOG_SOCKET_RETRY.  Every record that doesn't make it is counted as dropped.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include "ATLogSink.h"
+#include "ATFileWriter.h"
+#include "ATLogBinary.h"
+
+//Socket ATLogCollector listens on by default.
+#ifndef AT_LOG_SOCKET_PATH
+#define AT_LOG_SOCKET_PATH "/tmp/atlas-log.sock"
+#endif
+
+//Bytes waiting on the collector before the socket is considered stalled.  Has to hold a whole block.
+#ifndef AT_LOG_SOCKET_BUFFER
+#define AT_LOG_SOCKET_BUFFER (256 * 1024)
+#endif
+
+//Longest a threaded sink (or a flush) waits on a collector that isn't taking anything before hanging up on it (in
+//milliseconds).
+#ifndef AT_LOG_SOCKET_STALL
+#define AT_LOG_SOCKET_STALL 1000
+#endif
+
+//Time between tries at reaching a collector that isn't there (in milliseconds).
+#ifndef AT_LOG_SOCKET_RETRY
+#define AT_LOG_SOCKET_RETRY 1000
+#endif
+
+namespace Atlas
+{
+   //Streams bytes into a non-blocking Unix domain socket through a fixed size buffer.
+   class CATSocketWriter : public CATByteOutput
+   {
+      private:
+         static_assert(AT_LOG_SOCKET_BUFFER >= AT_LOG_BLOCK_SIZE + 1024, "AT_LOG_SOCKET_BUFFER has to hold a whole block");
+
+         int                     m_nSocket;  //The connection, -1 when there isn't one.
+         char*                   m_pBuffer;  //Bytes waiting on the other end.
+         unsigned int            m_unUsed;  //Number of bytes in m_pBuffer.
+         unsigned int            m_unSent;  //Number of those already sent.
+         unsigned int            m_unWait;  //Longest Write waits on the other end, in milliseconds.
+         unsigned long long      m_ullBytesSent;  //Total number of bytes sent since the writer was made.
+         unsigned long long      m_ullBytesQueued;  //Total number of bytes written that were sent or are still waiting.
+
+         CATSocketWriter(const CATSocketWriter&);  //Copy Constructor
+         CATSocketWriter& operator=(const CATSocketWriter&);  //Assignment Operator
+
+      public:
+         CATSocketWriter();  //Constructor
+         ~CATSocketWriter();  //Destructor
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Connect
+         //
+         // Purpose:  Connects to a Unix domain socket, hanging up on any connection that was already open.  Never
+         //           waits, a listener with a full backlog counts as not being there.
+         //
+         // In:  pPath - Path of the socket.
+         //
+         // Out:  true if connected, false otherwise (always on Windows).
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Connect(const char* pPath);
+
+         //Hangs up, throwing away anything that wasn't sent.
+         void Close();
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Write
+         //
+         // Purpose:  Adds bytes to the buffer, sending what's already there first if they won't fit.  Each Write is
+         //           all or nothing, so a stream made of whole writes (e.g. indexed blocks) is never cut mid entry.
+         //           Without a stall timeout bytes that don't fit are thrown away.  With one, an other end that takes
+         //           nothing for that long is hung up on.  Bytes written while there's no connection go nowhere.
+         //
+         // In:  pData - The bytes.
+         //      unLength - Number of bytes in pData.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         virtual void Write(const char* pData, unsigned int unLength) override;
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Send
+         //
+         // Purpose:  Sends as much of the buffer as the other end will take.  With unWait it keeps going until the
+         //           buffer is empty or nothing has gone out for unWait milliseconds.
+         //
+         // In:  unWait - Milliseconds to wait on the other end between sends, 0 to only send what goes right away.
+         //
+         // Out:  false if the connection was lost (or there wasn't one), true otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Send(unsigned int unWait);
+
+         void SetStallTimeout(unsigned int unWait) { m_unWait = unWait; }  //Longest Write waits on the other end, 0 never waits.
+         bool IsConnected() const { return m_nSocket >= 0; }
+         bool IsIdle() const { return m_unSent == m_unUsed; }  //Has everything written been sent?
+         unsigned long long GetBytesSent() const { return m_ullBytesSent; }
+         unsigned long long GetBytesQueued() const { return m_ullBytesQueued; }  //Bytes sent plus bytes waiting, thrown away bytes not included.
+   };
+
+   class CATSocketSink : public CATLogSink
+   {
+      private:
+         //A block handed to the socket that the collector may not have all of yet.
+         struct SSentBlock
+         {
+            unsigned long long   m_ullEnd;  //CATSocketWriter::GetBytesQueued once it was written.
+            unsigned int         m_unCount;  //Number of records in it.
+         };
+
+         CATSocketWriter         m_Socket;  //The connection to the collector.
+         CATBinaryWriter         m_Binary;  //Writes records to m_Socket in indexed blocks.
+         CString                 m_sPath;  //Path of the collector's socket, empty until Open.
+         char                    m_cSource[256];  //Name the collector puts in front of our messages.
+         std::deque<SSentBlock>  m_dqSent;  //Blocks not all sent yet, oldest first.
+         std::chrono::steady_clock::time_point m_tpRetry;  //When to try reaching the collector again.
+
+         bool Reconnect();  //Connects and starts a new stream, if it's time to try.
+         void BlockEnded(unsigned int unCount, unsigned long long ullQueued);  //Tracks a block just handed to the socket.
+         void CheckSent();  //Lets go of blocks the collector has, or counts everything not sent if the connection was lost.
+
+         CATSocketSink(const CATSocketSink&);  //Copy Constructor
+         CATSocketSink& operator=(const CATSocketSink&);  //Assignment Operator
+
+      protected:
+         virtual void WriteRecord(const SATLogRecord& Record) override;  //Adds the raw record to the current block.
+         virtual void EndBatch(bool bFlush) override;  //Sends the block if it's due (or if asked to).
+
+      public:
+         CATSocketSink(const char* pSource = 0);  //Constructor, pSource names this process in the merged Log (default: its pid).
+         ~CATSocketSink();  //Destructor
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Open
+         //
+         // Purpose:  Sets the collector's socket and tries to connect.  The stream's header is written with the
+         //           sink's current time stamp settings, so set those first.  A collector that isn't up yet is tried
+         //           again every AT_LOG_SOCKET_RETRY, messages logged in the meantime are counted as dropped.
+         //
+         // In:  sPath - Path of the socket ATLogCollector is listening on.
+         //
+         // Out:  true if the collector was reached.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool Open(const CString& sPath = AT_LOG_SOCKET_PATH);
+
+         void Close();  //Sends whatever is left and hangs up for good.
+         bool IsConnected() const { return m_Socket.IsConnected(); }
+   };
+}
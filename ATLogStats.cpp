@@ -0,0 +1,94 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogStats.cpp
+//
+// Purpose: What the Logger itself costs.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogStats.h"
+#include <cstring>
+
+namespace Atlas
+{
+   CATLogStats::SShard CATLogStats::m_aShards[AT_LOG_STATS_SHARDS] = {};
+   std::atomic<unsigned int> CATLogStats::m_unNextShard(0);
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Snapshot
+   //
+   // Purpose:  Adds up the counters kept here into Stats.  The sink totals (bytes written, drops, overwrites,
+   //           blocks, queue high water) are left alone, CATLogger::GetStats fills those in.  Counters are read one at a time, so a
+   //           snapshot taken while messages are going out can be a message or two off between fields.
+   //
+   // In:  Stats - Receives the counters.
+   //
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogStats::Snapshot(SATLogStats& Stats)
+   {
+      memset(Stats.m_aullMessages, 0, sizeof(Stats.m_aullMessages));
+      memset(Stats.m_aullCallLatency, 0, sizeof(Stats.m_aullCallLatency));
+      memset(Stats.m_aullFormatLatency, 0, sizeof(Stats.m_aullFormatLatency));
+      Stats.m_ullBytesFormatted = 0;
+
+      for (unsigned int s = 0; s < AT_LOG_STATS_SHARDS; s++)
+      {
+         const SShard& Counters = m_aShards[s];
+         for (unsigned int i = 0; i < 4; i++)
+            Stats.m_aullMessages[i] += Counters.m_aullMessages[i].load(std::memory_order_relaxed);
+         Stats.m_ullBytesFormatted += Counters.m_ullBytesFormatted.load(std::memory_order_relaxed);
+
+         for (unsigned int i = 0; i < AT_LOG_LATENCY_BUCKETS; i++)
+         {
+            Stats.m_aullCallLatency[i] += Counters.m_aullCallLatency[i].load(std::memory_order_relaxed);
+            Stats.m_aullFormatLatency[i] += Counters.m_aullFormatLatency[i].load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+   //Zeroes every counter kept here.
+   void CATLogStats::Reset()
+   {
+      for (unsigned int s = 0; s < AT_LOG_STATS_SHARDS; s++)
+      {
+         SShard& Counters = m_aShards[s];
+         for (unsigned int i = 0; i < 4; i++)
+            Counters.m_aullMessages[i].store(0, std::memory_order_relaxed);
+         Counters.m_ullBytesFormatted.store(0, std::memory_order_relaxed);
+
+         for (unsigned int i = 0; i < AT_LOG_LATENCY_BUCKETS; i++)
+         {
+            Counters.m_aullCallLatency[i].store(0, std::memory_order_relaxed);
+            Counters.m_aullFormatLatency[i].store(0, std::memory_order_relaxed);
+         }
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Percentile
+   //
+   // Purpose:  Estimates a percentile from one of the latency histograms, rounded up to its bucket's upper bound.
+   //
+   // In:  pBuckets - The histogram, AT_LOG_LATENCY_BUCKETS long.
+   //      dFraction - The percentile as a fraction, e.g. 0.99.
+   //
+   // Out:  The time in nanoseconds, 0 if the histogram is empty.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   unsigned long long CATLogStats::Percentile(const unsigned long long* pBuckets, double dFraction)
+   {
+      unsigned long long ullTotal = 0;
+      for (unsigned int i = 0; i < AT_LOG_LATENCY_BUCKETS; i++)
+         ullTotal += pBuckets[i];
+      if (ullTotal == 0)
+         return 0;
+
+      //Walk up the buckets until we've passed the fraction we're after.
+      unsigned long long ullTarget = static_cast<unsigned long long>(dFraction * static_cast<double>(ullTotal));
+      unsigned long long ullSeen = 0;
+      for (unsigned int i = 0; i < AT_LOG_LATENCY_BUCKETS; i++)
+      {
+         ullSeen += pBuckets[i];
+         if (ullSeen > ullTarget)
+            return 1ull << i;
+      }
+      return 1ull << (AT_LOG_LATENCY_BUCKETS - 1);
+   }
+}
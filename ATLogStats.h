@@ -0,0 +1,126 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogStats.h
+//
+// Purpose: What the Logger itself costs: messages per level, bytes formatted, and log2 histograms of the time spent in
+//          info/trace/warn/error and building message text.  Every counter is a relaxed atomic bumped where the work
+//          happens, so measuring doesn't hold anything up.  The counters are split into shards, each thread bumping
+//          its own, so threads logging at once don't all fight over the same cache lines.  Build with AT_LOG_NO_STATS
+//          to compile the counting out.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include "ATLogQueue.h"
+
+//Number of latency histogram buckets.  Bucket n counts times of [2^(n - 1), 2^n) nanoseconds, the last one everything longer.
+#ifndef AT_LOG_LATENCY_BUCKETS
+#define AT_LOG_LATENCY_BUCKETS 32
+#endif
+
+//Number of copies of the counters threads are spread across, Snapshot adds them back up.
+#ifndef AT_LOG_STATS_SHARDS
+#define AT_LOG_STATS_SHARDS 16
+#endif
+
+namespace Atlas
+{
+   //A copy of the Logger's numbers at one point in time, see CATLogger::GetStats.
+   struct SATLogStats
+   {
+      unsigned long long   m_aullMessages[4];  //Messages logged at each eLevel (ERR, WARN, TRACE, INFO), repeats included.
+      unsigned long long   m_ullBytesFormatted;  //Bytes of message text built by the sinks.
+      unsigned long long   m_ullBytesWritten;  //Bytes the sinks have output, added up over every sink.
+      unsigned long long   m_ullDropped;  //Records dropped because a sink's queue was full.
+      unsigned long long   m_ullOverwritten;  //Waiting records thrown away to make room (OVERWRITE_OLDEST).
+      unsigned long long   m_ullBlocked;  //Records whose caller had to wait on a sink to make room (BLOCK, DROP_BELOW_LEVEL).
+      unsigned long long   m_ullQueueHighWater;  //Most records any one sink's queue has held.
+      unsigned long long   m_aullCallLatency[AT_LOG_LATENCY_BUCKETS];  //Time spent inside info/trace/warn/error.
+      unsigned long long   m_aullFormatLatency[AT_LOG_LATENCY_BUCKETS];  //Time spent building a message's text.
+   };
+
+   class CATLogStats
+   {
+      private:
+         //One copy of the counters, lined up on a cache line so neighbouring shards don't share one.
+         struct alignas(AT_CACHE_LINE) SShard
+         {
+            std::atomic<unsigned long long> m_aullMessages[4];  //Messages logged at each level.
+            std::atomic<unsigned long long> m_ullBytesFormatted;  //Bytes of message text built.
+            std::atomic<unsigned long long> m_aullCallLatency[AT_LOG_LATENCY_BUCKETS];  //Time spent logging.
+            std::atomic<unsigned long long> m_aullFormatLatency[AT_LOG_LATENCY_BUCKETS];  //Time spent building text.
+         };
+
+         static SShard                    m_aShards[AT_LOG_STATS_SHARDS];
+         static std::atomic<unsigned int> m_unNextShard;  //Shard handed to the next thread that counts something.
+
+         //The calling thread's shard, threads are dealt out round robin the first time they count something.
+         static SShard& Shard()
+         {
+            static thread_local SShard* s_pShard = &m_aShards[m_unNextShard.fetch_add(1, std::memory_order_relaxed) % AT_LOG_STATS_SHARDS];
+            return *s_pShard;
+         }
+
+      public:
+
+         //Histogram bucket a time falls in.
+         static unsigned int Bucket(unsigned long long ullNanoseconds)
+         {
+            unsigned int unBucket = static_cast<unsigned int>(std::bit_width(ullNanoseconds));
+            return (unBucket < AT_LOG_LATENCY_BUCKETS) ? unBucket : AT_LOG_LATENCY_BUCKETS - 1;
+         }
+
+         //Counts a message at the given eLevel.
+         static void CountMessage(unsigned char ucLevel)
+         {
+            #ifndef AT_LOG_NO_STATS
+               Shard().m_aullMessages[ucLevel & 3].fetch_add(1, std::memory_order_relaxed);
+            #endif
+         }
+
+         //Counts the time a call to info/trace/warn/error took.
+         static void AddCallLatency(unsigned long long ullNanoseconds)
+         {
+            #ifndef AT_LOG_NO_STATS
+               Shard().m_aullCallLatency[Bucket(ullNanoseconds)].fetch_add(1, std::memory_order_relaxed);
+            #endif
+         }
+
+         //Counts the time building a message's text took, and how much text it was.
+         static void AddFormat(unsigned long long ullNanoseconds, unsigned int unBytes)
+         {
+            #ifndef AT_LOG_NO_STATS
+               SShard& Counters = Shard();
+               Counters.m_aullFormatLatency[Bucket(ullNanoseconds)].fetch_add(1, std::memory_order_relaxed);
+               Counters.m_ullBytesFormatted.fetch_add(unBytes, std::memory_order_relaxed);
+            #endif
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Snapshot
+         //
+         // Purpose:  Adds up the counters kept here into Stats.  The sink totals (bytes written, drops, overwrites,
+         //           blocks, queue high water) are left alone, CATLogger::GetStats fills those in.  Counters are read one at a time, so a
+         //           snapshot taken while messages are going out can be a message or two off between fields.
+         //
+         // In:  Stats - Receives the counters.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void Snapshot(SATLogStats& Stats);
+
+         static void Reset();  //Zeroes every counter kept here.
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Percentile
+         //
+         // Purpose:  Estimates a percentile from one of the latency histograms, rounded up to its bucket's upper bound.
+         //
+         // In:  pBuckets - The histogram, AT_LOG_LATENCY_BUCKETS long.
+         //      dFraction - The percentile as a fraction, e.g. 0.99.
+         //
+         // Out:  The time in nanoseconds, 0 if the histogram is empty.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static unsigned long long Percentile(const unsigned long long* pBuckets, double dFraction);
+   };
+}
@@ -0,0 +1,181 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogTrace.cpp
+//
+// Purpose: Scoped trace spans and their Chrome Trace Event export.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "ATLogTrace.h"
+#include "ATLogJson.h"
+#include "ATFileWriter.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <process.h>
+#define AT_GETPID _getpid
+#else
+#include <unistd.h>
+#define AT_GETPID getpid
+#endif
+
+namespace Atlas
+{
+   std::atomic<SATTraceBuffer*> CATLogTrace::m_pBuffers(0);
+   std::atomic<unsigned int> CATLogTrace::m_unNextThreadId(1);
+   std::atomic<bool> CATLogTrace::m_bEnabled(true);
+
+   //Hands the calling thread's buffer back when the thread exits.
+   struct SATTraceHolder
+   {
+      SATTraceBuffer* m_pBuffer = 0;
+      ~SATTraceHolder()
+      {
+         if (m_pBuffer)
+            m_pBuffer->m_bFree.store(true, std::memory_order_release);
+      }
+   };
+
+   static thread_local SATTraceHolder s_thHolder;
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  AcquireBuffer
+   //
+   // Purpose:  Finds a buffer for the calling thread.  One left behind by an exited thread is taken over once its
+   //           spans have been cleared, otherwise a new one is made and pushed on the front of the list.
+   //
+   // In:  None
+   //
+   // Out:  The buffer.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   SATTraceBuffer* CATLogTrace::AcquireBuffer()
+   {
+      SATTraceBuffer* pBuffer = m_pBuffers.load(std::memory_order_acquire);
+      for (; pBuffer; pBuffer = pBuffer->m_pNext)
+      {
+         bool bFree = true;
+         if (pBuffer->m_bFree.load(std::memory_order_relaxed) && pBuffer->m_ullCount.load(std::memory_order_relaxed) == 0 &&
+            pBuffer->m_bFree.compare_exchange_strong(bFree, false, std::memory_order_acquire))
+            break;
+      }
+
+      if (!pBuffer)
+      {
+         pBuffer = new SATTraceBuffer();
+         pBuffer->m_ullCount.store(0, std::memory_order_relaxed);
+         pBuffer->m_bFree.store(false, std::memory_order_relaxed);
+         pBuffer->m_pNext = m_pBuffers.load(std::memory_order_relaxed);
+         while (!m_pBuffers.compare_exchange_weak(pBuffer->m_pNext, pBuffer, std::memory_order_release, std::memory_order_relaxed));
+      }
+
+      pBuffer->m_unThreadId = m_unNextThreadId.fetch_add(1, std::memory_order_relaxed);
+      pBuffer->m_cName[0] = 0;
+      s_thHolder.m_pBuffer = pBuffer;
+      return pBuffer;
+   }
+
+   //Names the calling thread in the trace, e.g. "Render".  Threads without a name show up by number.
+   void CATLogTrace::SetThreadName(const char* pName)
+   {
+      SATTraceBuffer* pBuffer = GetBuffer();
+      size_t unLength = pName ? strlen(pName) : 0;
+      if (unLength >= AT_LOG_TRACE_NAME)
+         unLength = AT_LOG_TRACE_NAME - 1;
+      memcpy(pBuffer->m_cName, pName, unLength);
+      pBuffer->m_cName[unLength] = 0;
+   }
+
+   //Writes nanoseconds out as microseconds with three decimal places, Chrome's time unit.
+   static void AppendMicroseconds(CATFormatBuffer& fbOut, unsigned long long ullNanoseconds)
+   {
+      char cBuffer[32];
+      int nOut = snprintf(cBuffer, sizeof(cBuffer), "%llu.%03llu", ullNanoseconds / 1000, ullNanoseconds % 1000);
+      if (nOut > 0)
+         fbOut.Append(cBuffer, static_cast<unsigned int>(nOut));
+   }
+
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   // Function:  Export
+   //
+   // Purpose:  Writes every thread's spans out as a Chrome Trace Event JSON file.  Spans are "X" (complete)
+   //           events with microsecond time stamps since the epoch, thread names go out as metadata events.
+   //           Spans being recorded while this runs may be left out, but are never written half done.
+   //
+   // In:  pFilename - Name of the file to be created.
+   //
+   // Out:  true if the file was written, false otherwise.
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   bool CATLogTrace::Export(const char* pFilename)
+   {
+      CATFileWriter fwOut;
+      if (!pFilename || !fwOut.Open(pFilename))
+         return false;
+
+      static const char sBegin[] = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+      static const char sEnd[] = "\n]}\n";
+      fwOut.Write(sBegin, sizeof(sBegin) - 1);
+
+      char cEvent[AT_LOG_TRACE_NAME * 6 + 512];
+      char cPid[16];
+      unsigned int unPid = static_cast<unsigned int>(snprintf(cPid, sizeof(cPid), "%d", static_cast<int>(AT_GETPID())));
+      bool bFirst = true;
+
+      for (SATTraceBuffer* pBuffer = m_pBuffers.load(std::memory_order_acquire); pBuffer; pBuffer = pBuffer->m_pNext)
+      {
+         char cTid[16];
+         unsigned int unTid = static_cast<unsigned int>(snprintf(cTid, sizeof(cTid), "%u", pBuffer->m_unThreadId));
+
+         if (pBuffer->m_cName[0])
+         {
+            CATFormatBuffer fbEvent(cEvent, sizeof(cEvent));
+            fbEvent.Append(bFirst ? "\n" : ",\n", bFirst ? 1 : 2);
+            fbEvent.Append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":", 37);
+            fbEvent.Append(cPid, unPid);
+            fbEvent.Append(",\"tid\":", 7);
+            fbEvent.Append(cTid, unTid);
+            fbEvent.Append(",\"args\":{\"name\":\"", 17);
+            CATLogJson::AppendString(fbEvent, pBuffer->m_cName, static_cast<unsigned int>(strlen(pBuffer->m_cName)), 4);
+            fbEvent.Append("\"}}", 3);
+            fwOut.Write(cEvent, fbEvent.Length());
+            bFirst = false;
+         }
+
+         unsigned long long ullCount = pBuffer->m_ullCount.load(std::memory_order_acquire);
+         unsigned long long ullFirst = (ullCount > AT_LOG_TRACE_SPANS) ? ullCount - AT_LOG_TRACE_SPANS : 0;
+         for (unsigned long long i = ullFirst; i < ullCount; i++)
+         {
+            SATTraceSpan Span = pBuffer->m_aSpans[i & (AT_LOG_TRACE_SPANS - 1)];
+
+            //The thread may have lapped us while we were copying, in which case the span is a mix of two.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (i + AT_LOG_TRACE_SPANS <= pBuffer->m_ullCount.load(std::memory_order_relaxed) || !Span.m_pName)
+               continue;
+
+            CATFormatBuffer fbEvent(cEvent, sizeof(cEvent));
+            fbEvent.Append(bFirst ? "\n" : ",\n", bFirst ? 1 : 2);
+            fbEvent.Append("{\"name\":\"", 9);
+            CATLogJson::AppendString(fbEvent, Span.m_pName, static_cast<unsigned int>(strlen(Span.m_pName)), 128);
+            fbEvent.Append("\",\"cat\":\"scope\",\"ph\":\"X\",\"ts\":", 30);
+            AppendMicroseconds(fbEvent, CATLogClock::ToNanoseconds(Span.m_ullBegin));
+            fbEvent.Append(",\"dur\":", 7);
+            AppendMicroseconds(fbEvent, CATLogClock::ElapsedNanoseconds(Span.m_ullEnd - Span.m_ullBegin));
+            fbEvent.Append(",\"pid\":", 7);
+            fbEvent.Append(cPid, unPid);
+            fbEvent.Append(",\"tid\":", 7);
+            fbEvent.Append(cTid, unTid);
+            fbEvent.Append('}');
+            fwOut.Write(cEvent, fbEvent.Length());
+            bFirst = false;
+         }
+      }
+
+      fwOut.Write(sEnd, sizeof(sEnd) - 1);
+      fwOut.Close();
+      return true;
+   }
+
+   //Throws away every span recorded so far, e.g. after an Export.  Call while no spans are being recorded.
+   void CATLogTrace::Clear()
+   {
+      for (SATTraceBuffer* pBuffer = m_pBuffers.load(std::memory_order_acquire); pBuffer; pBuffer = pBuffer->m_pNext)
+         pBuffer->m_ullCount.store(0, std::memory_order_release);
+   }
+}
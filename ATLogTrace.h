@@ -0,0 +1,155 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogTrace.h
+//
+// Purpose: Scoped trace spans, a lightweight built-in profiler.  AT_LOG_SCOPE("name") times the rest of the block it's in
+//          and keeps the span in a ring owned by the calling thread, costing two time stamps and a few stores with no
+//          locks or shared writes.  CATLogTrace::Export writes every thread's spans out in the Chrome Trace Event format,
+//          to be opened in chrome://tracing or https://ui.perfetto.dev:
+//
+//             void CWorld::Update()
+//             {
+//                AT_LOG_SCOPE("World::Update");
+//                ...
+//             }
+//
+//          Each thread keeps its last AT_LOG_TRACE_SPANS spans.  Build with AT_LOG_NO_TRACE (or AT_RELEASE) to compile
+//          the spans out.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <atomic>
+#include "ATLogClock.h"
+
+//Number of spans each thread keeps, older ones are written over.  Has to be a power of two.
+#ifndef AT_LOG_TRACE_SPANS
+#define AT_LOG_TRACE_SPANS 8192
+#endif
+
+//Longest thread name kept for the trace, see CATLogTrace::SetThreadName.
+#define AT_LOG_TRACE_NAME 32
+
+namespace Atlas
+{
+   //A single timed scope.
+   struct SATTraceSpan
+   {
+      const char*          m_pName;  //Name handed to AT_LOG_SCOPE, has to stay around for the life of the program.
+      unsigned long long   m_ullBegin;  //When the scope was entered, CATLogClock ticks.
+      unsigned long long   m_ullEnd;  //When it was left.
+   };
+
+   //A thread's spans.  Buffers are never deleted, a thread's buffer is handed on to a later thread once it exits and
+   //its spans have been cleared (see CATLogTrace::Clear).
+   struct SATTraceBuffer
+   {
+      SATTraceSpan                     m_aSpans[AT_LOG_TRACE_SPANS];  //The ring.
+      std::atomic<unsigned long long>  m_ullCount;  //Spans added since the last Clear, never wraps.
+      std::atomic<bool>                m_bFree;  //Its thread has exited.
+      unsigned int                     m_unThreadId;  //Id the thread goes by in the trace.
+      char                             m_cName[AT_LOG_TRACE_NAME];  //Name the thread goes by in the trace, empty for none.
+      SATTraceBuffer*                  m_pNext;  //Next buffer on the list.
+   };
+
+   class CATLogTrace
+   {
+      private:
+         static_assert((AT_LOG_TRACE_SPANS & (AT_LOG_TRACE_SPANS - 1)) == 0, "AT_LOG_TRACE_SPANS has to be a power of two");
+
+         static std::atomic<SATTraceBuffer*>    m_pBuffers;  //Every thread's buffer, newest first.
+         static std::atomic<unsigned int>       m_unNextThreadId;  //Id handed to the next thread that records a span.
+         static std::atomic<bool>               m_bEnabled;  //Are spans being recorded?
+
+         static SATTraceBuffer* AcquireBuffer();  //Finds or makes a buffer for the calling thread.
+
+      public:
+
+         //Are spans being recorded?  On by default.
+         static bool IsEnabled() { return m_bEnabled.load(std::memory_order_relaxed); }
+
+         //Turns recording spans on or off, e.g. to only capture a few frames.
+         static void SetEnabled(bool bEnabled) { m_bEnabled.store(bEnabled, std::memory_order_relaxed); }
+
+         //The calling thread's buffer, made the first time it records a span.
+         static SATTraceBuffer* GetBuffer()
+         {
+            static thread_local SATTraceBuffer* s_pBuffer = 0;
+            if (!s_pBuffer)
+               s_pBuffer = AcquireBuffer();
+            return s_pBuffer;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Add
+         //
+         // Purpose:  Records a span in the calling thread's ring over its oldest one.  Only the calling thread writes
+         //           its ring, so there's nothing to lock.
+         //
+         // In:  pName - Name of the span, has to stay around for the life of the program.
+         //      ullBegin - When the span started, CATLogClock ticks.
+         //      ullEnd - When it ended.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static void Add(const char* pName, unsigned long long ullBegin, unsigned long long ullEnd)
+         {
+            SATTraceBuffer* pBuffer = GetBuffer();
+            unsigned long long ullIndex = pBuffer->m_ullCount.load(std::memory_order_relaxed);
+            SATTraceSpan& Span = pBuffer->m_aSpans[ullIndex & (AT_LOG_TRACE_SPANS - 1)];
+            Span.m_pName = pName;
+            Span.m_ullBegin = ullBegin;
+            Span.m_ullEnd = ullEnd;
+            pBuffer->m_ullCount.store(ullIndex + 1, std::memory_order_release);
+         }
+
+         //Names the calling thread in the trace, e.g. "Render".  Threads without a name show up by number.
+         static void SetThreadName(const char* pName);
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  Export
+         //
+         // Purpose:  Writes every thread's spans out as a Chrome Trace Event JSON file.  Spans are "X" (complete)
+         //           events with microsecond time stamps since the epoch, thread names go out as metadata events.
+         //           Spans being recorded while this runs may be left out, but are never written half done.
+         //
+         // In:  pFilename - Name of the file to be created.
+         //
+         // Out:  true if the file was written, false otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static bool Export(const char* pFilename);
+
+         //Throws away every span recorded so far, e.g. after an Export.  Call while no spans are being recorded.
+         static void Clear();
+   };
+
+   //Times the scope it lives in, see AT_LOG_SCOPE.
+   class CATLogScope
+   {
+      private:
+         const char*          m_pName;  //Name of the span.
+         unsigned long long   m_ullBegin;  //When the scope was entered, 0 if recording is off.
+
+         CATLogScope(const CATLogScope&);  //Copy Constructor
+         CATLogScope& operator=(const CATLogScope&);  //Assignment Operator
+
+      public:
+         //Constructor
+         explicit CATLogScope(const char* pName) : m_pName(pName), m_ullBegin(CATLogTrace::IsEnabled() ? CATLogClock::Now() : 0) {}
+
+         //Destructor
+         ~CATLogScope()
+         {
+            if (m_ullBegin)
+               CATLogTrace::Add(m_pName, m_ullBegin, CATLogClock::Now());
+         }
+   };
+}
+
+#define AT_LOG_CONCAT_INNER(a, b) a##b
+#define AT_LOG_CONCAT(a, b) AT_LOG_CONCAT_INNER(a, b)
+
+//Times the rest of the enclosing block as a span called name (a string literal).
+#if !defined(AT_LOG_NO_TRACE) && !defined(AT_RELEASE)
+#define AT_LOG_SCOPE(name)  ::Atlas::CATLogScope AT_LOG_CONCAT(atLogScope, __LINE__)(name);
+#else
+#define AT_LOG_SCOPE(name)
+#endif
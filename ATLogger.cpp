@@ -1,23 +1,108 @@
 #include "ATLogger.h"
-#include <time.h>
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
 
 //The one and ONLY!!!!
-Atlas::CATLogger* Atlas::CATLogger::m_pInstance = 0;
-
-//Size of cBuffer used in snprintf (in ProcessToken)
-#define BUFFER_SIZE 256
+std::atomic<Atlas::CATLogger*> Atlas::CATLogger::m_pInstance(0);
+std::mutex Atlas::CATLogger::m_mtxInstance;
 
 namespace Atlas
 {
+   //A thread's own repeat tracking and in-use count, so threads logging different messages don't keep knocking each
+   //other's last message out or fight over the same counter.  Only the owning thread touches it outside of Flush and
+   //Shutdown.
+   struct SATLogThread
+   {
+      std::atomic<unsigned int>        m_unInUse{0};  //Depth of SATSinksInUse on the thread, Shutdown waits for it to be 0.
+      std::atomic<unsigned long long>  m_ullLastMessage{0};  //Hash of the thread's last message, its level and channel in the low 12 bits, 0 for none.
+      std::atomic<unsigned int>        m_unRepeats{0};  //Times it has been repeated since it went out.
+      std::atomic<unsigned char>       m_ucLastLevel{0};  //Level of the thread's last message, for the repeat count.
+      std::atomic<unsigned char>       m_ucLastChannel{0};  //Channel it was logged on.
+      const char*                      m_pLastFormat = 0;  //Format of the thread's last message, so a hash match can be confirmed.
+      unsigned int                     m_unLastArgCount = 0;  //Number of arguments it had.
+      std::atomic<bool>                m_bFree{false};  //Its thread has exited, the next new thread can take it over.
+      SATLogThread*                    m_pNext = 0;
+   };
+
+   //Every thread's state.  Entries are never deleted, a thread's entry is handed on to a later thread once it exits,
+   //so the list only grows as far as the most threads that have ever logged at once.
+   static std::atomic<SATLogThread*> s_pThreads(0);
+
+   //Hands the calling thread's state back when the thread exits, and frees its large record if it ever needed one.
+   struct SATThreadHolder
+   {
+      SATLogThread* m_pThread = 0;
+      SATLogLargeRecord* m_pLarge = 0;  //Where messages too big for a SATLogRecord are built for sinks without a thread.
+      ~SATThreadHolder()
+      {
+         if (m_pThread)
+            m_pThread->m_bFree.store(true, std::memory_order_release);
+         delete m_pLarge;
+      }
+   };
+
+   static thread_local SATThreadHolder s_thThread;
+
+   //The calling thread's state, taken over from an exited thread or made the first time the thread logs.
+   static SATLogThread* GetLogThread()
+   {
+      if (s_thThread.m_pThread)
+         return s_thThread.m_pThread;
+
+      SATLogThread* pThread = s_pThreads.load(std::memory_order_acquire);
+      for (; pThread; pThread = pThread->m_pNext)
+      {
+         bool bFree = true;
+         if (pThread->m_bFree.load(std::memory_order_relaxed) &&
+            pThread->m_bFree.compare_exchange_strong(bFree, false, std::memory_order_acquire))
+            break;
+      }
+
+      if (!pThread)
+      {
+         pThread = new SATLogThread();
+         pThread->m_pNext = s_pThreads.load(std::memory_order_relaxed);
+         while (!s_pThreads.compare_exchange_weak(pThread->m_pNext, pThread, std::memory_order_seq_cst, std::memory_order_relaxed));
+      }
+
+      s_thThread.m_pThread = pThread;
+      return pThread;
+   }
+
+   //Marks the calling thread as using the sinks for as long as it's in scope, so Shutdown doesn't delete them out from
+   //under it.  The count here and the sink count are both seq_cst, so either Shutdown sees this thread's count, or
+   //this thread sees the sink count Shutdown zeroed and leaves the sinks alone.
+   struct SATSinksInUse
+   {
+      SATLogThread* m_pThread;
+      SATSinksInUse() : m_pThread(GetLogThread()) { m_pThread->m_unInUse.fetch_add(1, std::memory_order_seq_cst); }
+      ~SATSinksInUse() { m_pThread->m_unInUse.fetch_sub(1, std::memory_order_release); }
+   };
+
    //Constructor
    CATLogger::CATLogger()
    {
-      this->m_hConsole = 0;  //Sets Handler to null.
       this->m_cLoggerLevel = eLevel::ALL;  //Set default level to all messages.
       m_ucFlags = 0;  //Sets all flags to off.
+      m_ucTimestampDigits = CATLogClock::PRECISION_MICRO;
+      m_unFileFlushSize = AT_LOG_FILE_BUFFER;
+      m_unFileFlushInterval = AT_LOG_FILE_INTERVAL;
+      m_ullFileMaxBytes = 0;  //Never roll the file over unless asked to.
+      m_unFileMaxSeconds = 0;
+      m_unFileKeep = AT_LOG_ROLL_KEEP;
+      m_bFileCompress = true;
+      m_bInitialized = false;
+      m_unSinkCount = 0;  //No sinks until Init or AddSink.
+      m_bCollapseRepeats = false;
+      m_ucBackpressure = CATLogSink::DROP_NEWEST;
+      m_ucKeepLevel = eLevel::ERR;
+      m_ullStatsInterval = 0;  //No summaries unless asked for.
+      m_ullLastStats = 0;
+      m_bTicking = false;
    }
 
    //Deconstructor
@@ -26,21 +111,31 @@ namespace Atlas
       this->Shutdown();
    }
 
-   //Retrieve the ONLY instance of ATLogger.
+   //Retrieve the ONLY instance of ATLogger.  Only the very first call takes the lock.
    CATLogger* CATLogger::GetInstance()
    {
       //Have I already been allocated?
-      if (!m_pInstance)
-         m_pInstance = new CATLogger();  //No?  Go ahead an allocate.
-      return m_pInstance;
+      CATLogger* pInstance = m_pInstance.load(std::memory_order_acquire);
+      if (!pInstance)
+      {
+         //No?  Go ahead an allocate, unless another thread beat us to it.
+         std::lock_guard<std::mutex> lgInstance(m_mtxInstance);
+         pInstance = m_pInstance.load(std::memory_order_relaxed);
+         if (!pInstance)
+         {
+            pInstance = new CATLogger();
+            m_pInstance.store(pInstance, std::memory_order_release);
+         }
+      }
+      return pInstance;
    }
 
-   //Delete instance of ATLogger.
+   //Delete instance of ATLogger.  Nothing should still be logging when this is called.
    void CATLogger::DeleteInstance()
    {
-      //Was I created?
-      if (m_pInstance)
-         delete m_pInstance;  //Then delete me!
+      //Was I created?  Then delete me!
+      std::lock_guard<std::mutex> lgInstance(m_mtxInstance);
+      delete m_pInstance.exchange(0, std::memory_order_acq_rel);
    }
 
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -58,6 +153,11 @@ namespace Atlas
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
    bool CATLogger::Init(eLevel Loggerlevel, unsigned char ucFlags, const CString& sOutputFilename)
    {
+      //Only the first call sets anything up.
+      std::lock_guard<std::mutex> lgInit(m_mtxInit);
+      if (m_bInitialized)
+         return true;
+
       //If we're not a console app already then we need to create a console.
       #ifdef AT_WINDOWS
          bool bresult = AllocConsole();
@@ -67,22 +167,63 @@ namespace Atlas
 
       this->SetLevel(Loggerlevel);
       SET_BIT(m_ucFlags, ucFlags);
+      this->UpdateSinkTimestamps();  //Sinks added before Init pick up the flags we were just handed.
+
+      //Line the time stamp counter up with the wall clock before any messages come in.
+      CATLogClock::Calibrate();
 
       //Are we printing to Console?
       if (CHECK_BIT(m_ucFlags, eFlags::CONSOLE))
       {
-         FILE* pStream;
-         errno_t etResult = freopen_s(&pStream, "CONOUT$", "w", stdout);
-         if (etResult != 0)
+         #ifdef _WIN32
+            FILE* pStream;
+            errno_t etResult = freopen_s(&pStream, "CONOUT$", "w", stdout);
+            if (etResult != 0)
+               return false;
+         #endif
+
+         //The sink picks up the Console's standard output itself.
+         if (!this->AddSink(new CATConsoleSink()))
             return false;
-
-         //Grab the Handle to the Console for future use.
-         this->m_hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
       }
 
-      //Are we outputting to a file, if so store the name of that file.
+      //Are we outputting to a file, if so store the name of that file and open it up.
       if (CHECK_BIT(m_ucFlags, eFlags::LOGFILE))
-         SetOutputFile(sOutputFilename.getCstr());
+      {
+         if (!sOutputFilename.Empty())
+            SetOutputFile(sOutputFilename.getCstr());
+
+         CATRollingFileSink* pFile = new CATRollingFileSink(CHECK_BIT(m_ucFlags, eFlags::BINARY), CHECK_BIT(m_ucFlags, eFlags::INDEXED));
+         if (CHECK_BIT(m_ucFlags, eFlags::JSON))
+            pFile->SetFormatter(CATLogJson::Formatter);
+         pFile->SetFlushPolicy(m_unFileFlushSize, m_unFileFlushInterval);
+         pFile->SetRollPolicy(m_ullFileMaxBytes, m_unFileMaxSeconds, m_unFileKeep, m_bFileCompress);
+         pFile->SetTimestamp(CHECK_BIT(m_ucFlags, eFlags::TIMESTAMP));
+         pFile->SetTimestampDigits(m_ucTimestampDigits);
+         if (!pFile->Open(m_sOutputFilename))
+         {
+            delete pFile;
+            return false;
+         }
+
+         if (!this->AddSink(pFile))
+            return false;
+      }
+
+      //Start up any sinks that were added before we got here.
+      {
+         std::lock_guard<std::mutex> lgSinks(m_mtxSinks);
+         m_bInitialized = true;
+         for (unsigned int i = 0; i < m_unSinkCount.load(std::memory_order_relaxed); i++)
+         {
+            m_apSinks[i]->SetBackpressure(static_cast<CATLogSink::eBackpressure>(m_ucBackpressure), m_ucKeepLevel);
+            m_apSinks[i]->Start(CHECK_BIT(m_ucFlags, eFlags::ASYNC));
+         }
+      }
+
+      //Sinks writing on the calling thread only flush when they're written to, the tick thread covers the quiet spells.
+      m_bTicking = true;
+      m_tTick = std::thread(&CATLogger::TickThread, this);
 
       //We're in the clear output message saying so and telling user what message level was set.
       this->info("Atlas Logger Intialized at level {i}", this->m_cLoggerLevel);
@@ -95,7 +236,8 @@ namespace Atlas
    // Last Modified:  November 18th, 2023 (JB)
    // Author:  Jason A. Biddle
    //
-   // Purpose:  Cleans up memory and writes out messages to desired output file.
+   // Purpose:  Cleans up memory and writes out any messages still waiting to go to the sinks.  Calls still using
+   //           the sinks on other threads are waited out before the sinks are deleted, calls after that skip them.
    //
    // In:  None
    //
@@ -103,340 +245,459 @@ namespace Atlas
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////         
    void CATLogger::Shutdown()
    {
+      std::lock_guard<std::mutex> lgInit(m_mtxInit);
+
       //If we're not a console app then we need to free up the Console we created.
       #ifdef AT_WINDOWS
          FreeConsole();
       #endif
 
-      //Are we outputting to a file and there are message to be outputted to that file?
-      if (CHECK_BIT(m_ucFlags,eFlags::LOGFILE) && !m_vFileQueue.empty())
+      //The tick thread goes first, it walks the sinks.
       {
-         std::ofstream fout(m_sOutputFilename.getCstr());
-         std::vector<CString>::iterator iter = m_vFileQueue.begin();
-         std::vector<CString>::iterator iterEnd = m_vFileQueue.end();
-         while (iter != iterEnd)
+         std::lock_guard<std::mutex> lgTick(m_mtxTick);
+         m_bTicking = false;
+      }
+      m_cvTick.notify_all();
+      if (m_tTick.joinable())
+         m_tTick.join();
+
+      //Let every sink drain whatever is left in its queue, then get rid of them.
+      this->FlushRepeats();
+      std::lock_guard<std::mutex> lgSinks(m_mtxSinks);
+      unsigned int unCount = m_unSinkCount.load(std::memory_order_relaxed);
+      m_unSinkCount.store(0, std::memory_order_seq_cst);
+
+      //Nobody picks the sinks up from here on, wait out whoever already had them (see SATSinksInUse).
+      for (SATLogThread* pThread = s_pThreads.load(std::memory_order_seq_cst); pThread; pThread = pThread->m_pNext)
+      {
+         while (pThread->m_unInUse.load(std::memory_order_seq_cst) > 0)
+            std::this_thread::yield();
+      }
+
+      for (unsigned int i = 0; i < unCount; i++)
+      {
+         m_apSinks[i]->Stop();
+         delete m_apSinks[i];
+         m_apSinks[i] = 0;
+      }
+      m_bInitialized = false;
+      CLEAR_BITS(m_ucFlags);  //Init sets them again, so the next Init starts from scratch.
+   }
+
+   //Hashes everything that makes a message what it is, keeping the low 12 bits free for its level and channel.
+   static unsigned long long HashMessage(unsigned char ucLevel, unsigned int unChannel, const char* pFormat, bool bLiteral,
+      const SATFormatArg* pArgs, unsigned int unArgCount)
+   {
+      //FNV-1a, string literals are hashed by address since the same format always lives in the same place.
+      unsigned long long ullHash = 14695981039346656037ull;
+      auto Mix = [&ullHash](const void* pData, size_t unLength)
+      {
+         const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+         for (size_t i = 0; i < unLength; i++)
+            ullHash = (ullHash ^ pBytes[i]) * 1099511628211ull;
+      };
+
+      if (bLiteral)
+         Mix(&pFormat, sizeof(pFormat));
+      else
+         Mix(pFormat, strlen(pFormat));
+
+      for (unsigned int i = 0; i < unArgCount; i++)
+      {
+         const SATFormatArg& Arg = pArgs[i];
+         Mix(&Arg.m_ucType, 1);
+         if (Arg.m_pKey)
+            Mix(Arg.m_pKey, Arg.m_ucKeyLength);
+         if (Arg.m_ucType == ARG_STRING || Arg.m_ucType == ARG_USER)
          {
-            fout.write((*iter).getCstr(), (*iter).Length());
-            fout.write("\n", 1);
-            iter++;
+            if (Arg.m_pString)
+               Mix(Arg.m_pString, Arg.m_unLength);
          }
-         fout.close();
+         else if (Arg.m_ucType == ARG_CHAR)
+            Mix(&Arg.m_cValue, 1);
+         else if (Arg.m_ucType == ARG_BOOL)
+            Mix(&Arg.m_bValue, 1);
+         else
+            Mix(&Arg.m_ullValue, 8);
       }
+
+      return (ullHash & ~0xFFFull) | (static_cast<unsigned long long>(ucLevel & 0x0F) << 8) | (unChannel & 0xFF);
    }
 
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   // Function:  info
-   // Last Modified:  November 18th, 2023 (JB)
-   // Author:  Jason A. Biddle
+   // Function:  Log
    //
-   // Purpose:  Prints out information messages to Console and/or file, if printed to Console these messages
-   //           print out in Aqua color.
+   // Purpose:  With SetCollapseRepeats on, drops a message that's identical to the one its thread logged before it,
+   //           just counting it, so a message stuck firing in a loop doesn't bury the sinks.  The count goes out as "Last message repeated
+   //           N times" ahead of that thread's next different message (or on Flush).  Everything else goes straight
+   //           on to Dispatch.  Repeats are tracked per thread, so nothing here is shared between logging threads.
    //
-   // In:  sMessage - Message to be printed.
-   //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+   // In:  ucLevel - The eLevel of the message.
+   //      unChannel - The channel the message was logged on.
+   //      pFormat - The message being outputted e.g. "Hello there {f}!"
+   //      bLiteral - Is pFormat a string literal?
+   //      pArgs - The variables that will be pressed into pFormat.
+   //      unArgCount - Number of variables in pArgs.
    //
    // Out:  None
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   void CATLogger::info(const CString sMessage, ...)
+   void CATLogger::Log(unsigned char ucLevel, unsigned int unChannel, const char* pFormat, bool bLiteral, const SATFormatArg* pArgs, unsigned int unArgCount)
    {
-      //Are we displaying this message?  If not get outta here!
-      if (this->m_cLoggerLevel != eLevel::INFO && this->m_cLoggerLevel != eLevel::ERR_INFO
-         && this->m_cLoggerLevel != eLevel::WARN_INFO && this->m_cLoggerLevel != eLevel::TRACE_INFO
-         && this->m_cLoggerLevel != eLevel::ALL)
+      unsigned long long ullTimestamp = CATLogClock::Now();
+      SATSinksInUse siuSinks;
+
+      //Filtered out by the channel and only here for the flight recorder, none of the sinks' bookkeeping applies.
+      if (!CATLogChannels::IsEnabled(unChannel, LevelBit(ucLevel)))
+      {
+         this->Dispatch(ullTimestamp, ucLevel, unChannel, pFormat, bLiteral, pArgs, unArgCount);
          return;
+      }
+
+      CATLogStats::CountMessage(ucLevel);
+
+      bool bRepeat = false;
+      if (m_bCollapseRepeats.load(std::memory_order_relaxed))
+      {
+         unsigned long long ullMessage = HashMessage(ucLevel, unChannel, pFormat, bLiteral, pArgs, unArgCount);
+         SATLogThread* pThread = siuSinks.m_pThread;
+
+         //A matching hash alone could be a collision, only a message with the same format and argument count is dropped.
+         if (pThread->m_ullLastMessage.load(std::memory_order_relaxed) == ullMessage && pThread->m_pLastFormat == pFormat &&
+            pThread->m_unLastArgCount == unArgCount)
+         {
+            pThread->m_unRepeats.fetch_add(1, std::memory_order_relaxed);
+            bRepeat = true;
+         }
+         else
+         {
+            //Something new, own up to how many times the last message was repeated before this one goes out.
+            //A last message of 0 means Flush already put its repeats out, anything counted since is a straggler
+            //that raced the Flush and belongs to no message.
+            unsigned long long ullLast = pThread->m_ullLastMessage.exchange(ullMessage, std::memory_order_relaxed);
+            unsigned int unRepeats = pThread->m_unRepeats.exchange(0, std::memory_order_relaxed);
+            unsigned char ucLastLevel = pThread->m_ucLastLevel.exchange(ucLevel, std::memory_order_relaxed);
+            unsigned char ucLastChannel = pThread->m_ucLastChannel.exchange(static_cast<unsigned char>(unChannel), std::memory_order_relaxed);
+            pThread->m_pLastFormat = pFormat;
+            pThread->m_unLastArgCount = unArgCount;
+            if (unRepeats > 0 && ullLast != 0)
+               this->OutputRepeats(ucLastLevel, ucLastChannel, unRepeats);
+         }
+      }
 
-      va_list args;  //Grab the list of arguments passed to info.
-      va_start(args, sMessage);  //Begin processing from args list.
+      if (!bRepeat)
+         this->Dispatch(ullTimestamp, ucLevel, unChannel, pFormat, bLiteral, pArgs, unArgCount);
 
-      CString sResult = this->buildMessage(sMessage, args);
-      if (CHECK_BIT(m_ucFlags,eFlags::LOGFILE))  //If we're outputting to file then store in vector for later processing.
-         m_vFileQueue.push_back(sResult);
+      //Time the summary's due?  Only the thread that wins the exchange puts it out.
+      unsigned long long ullInterval = m_ullStatsInterval.load(std::memory_order_relaxed);
+      unsigned long long ullLastStats = m_ullLastStats.load(std::memory_order_relaxed);
+      if (ullInterval > 0 && CATLogClock::ElapsedNanoseconds(ullTimestamp - ullLastStats) >= ullInterval &&
+         m_ullLastStats.compare_exchange_strong(ullLastStats, ullTimestamp, std::memory_order_relaxed))
+         this->OutputStats();
 
-      va_end(args);  //Done with the arg list.
+      CATLogStats::AddCallLatency(CATLogClock::ElapsedNanoseconds(CATLogClock::Now() - ullTimestamp));
+   }
 
-      //Are we printing to console?  Then print it out in Aqua color.
-      if (CHECK_BIT(m_ucFlags, eFlags::CONSOLE))
+   //Outputs the "repeated N times" message for every thread's last message that was repeated.
+   void CATLogger::FlushRepeats()
+   {
+      for (SATLogThread* pThread = s_pThreads.load(std::memory_order_acquire); pThread; pThread = pThread->m_pNext)
       {
-         SetConsoleTextAttribute(this->m_hConsole, eColors::AQUA);
-         std::cout << sResult << std::endl;
-         SetConsoleTextAttribute(this->m_hConsole, eColors::WHITE);
+         //Taking the last message clears it first, so the next message goes out even if it matches (the Flush
+         //doesn't hide it) and a repeat the owning thread counts after this can't be put out against a message of 0.
+         unsigned long long ullLast = pThread->m_ullLastMessage.exchange(0, std::memory_order_relaxed);
+         unsigned char ucLevel = pThread->m_ucLastLevel.load(std::memory_order_relaxed);
+         unsigned char ucChannel = pThread->m_ucLastChannel.load(std::memory_order_relaxed);
+         unsigned int unRepeats = pThread->m_unRepeats.exchange(0, std::memory_order_relaxed);
+         if (unRepeats > 0 && ullLast != 0)
+            this->OutputRepeats(ucLevel, ucChannel, unRepeats);
       }
    }
 
+   //Outputs "Last message repeated N times" at the repeated message's level and channel.
+   void CATLogger::OutputRepeats(unsigned char ucLevel, unsigned int unChannel, unsigned int unRepeats)
+   {
+      static const char sRepeated[] = "Last message repeated {u} times";
+      SATFormatArg Arg = MakeFormatArg(unRepeats);
+      this->Dispatch(CATLogClock::Now(), ucLevel, unChannel, sRepeated, true, &Arg, 1);
+   }
+
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   // Function:  trace
-   // Last Modified:  November 18th, 2023 (JB)
-   // Author:  Jason A. Biddle
+   // Function:  Dispatch
    //
-   // Purpose:  Prints out trace messages to Console and/or file, if printed to Console these messages
-   //           print out in Aqua color.
+   // Purpose:  Records the message's format id, time stamp and raw arguments and hands it to every sink whose level
+   //           mask takes it.  Threaded sinks get it filled in straight into a slot in this thread's stage of the
+   //           sink (the record is built once and copied into the rest), so the text gets built on each sink's own
+   //           thread and logging threads never wait on each other.  A full stage is handled by that sink's
+   //           backpressure policy (see SetBackpressure), by default dropping the message for that sink only.  The flight recorder gets a
+   //           copy of anything a sink took, and of levels it's been asked to record even when the channel's level
+   //           keeps them from every sink.  Sinks without a thread output it
+   //           right here, from a SATLogLargeRecord if it didn't fit in a SATLogRecord.  The level has already been
+   //           checked by info, trace, warn or error and repeats collapsed by Log.
    //
-   // In:  sMessage - Message to be printed.
-   //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+   // In:  ullTimestamp - When the message was logged, CATLogClock ticks.
+   //      ucLevel - The eLevel of the message.
+   //      unChannel - The channel the message was logged on.
+   //      pFormat - The message being outputted e.g. "Hello there {f}!"
+   //      bLiteral - Is pFormat a string literal?
+   //      pArgs - The variables that will be pressed into pFormat.
+   //      unArgCount - Number of variables in pArgs.
    //
    // Out:  None
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   void CATLogger::trace(const CString sMessage, ...)
+   void CATLogger::Dispatch(unsigned long long ullTimestamp, unsigned char ucLevel, unsigned int unChannel, const char* pFormat, bool bLiteral,
+      const SATFormatArg* pArgs, unsigned int unArgCount)
    {
-      //Are we displaying this message?  If not get outta here!
-      if (this->m_cLoggerLevel != eLevel::TRACE && this->m_cLoggerLevel != eLevel::ERR_TRACE
-         && this->m_cLoggerLevel != eLevel::WARN_TRACE && this->m_cLoggerLevel != eLevel::TRACE_INFO
-         && this->m_cLoggerLevel != eLevel::ALL)
-         return;
+      unsigned char ucLevelBit = LevelBit(ucLevel);
 
-      va_list args;  //Grab the list of arguments passed to info.
-      va_start(args, sMessage);  //Begin processing from args list.
+      //We may only be here for the flight recorder, in which case the sinks don't get it.
+      unsigned int unCount = 0;
+      if (CATLogChannels::IsEnabled(unChannel, ucLevelBit))
+         unCount = m_unSinkCount.load(std::memory_order_seq_cst);  //Pairs with Shutdown, see SATSinksInUse.
 
-      CString sResult = this->buildMessage(sMessage, args);
-      if (CHECK_BIT(m_ucFlags, eFlags::LOGFILE))  //If we're outputting to file then store in vector for later processing.
-         m_vFileQueue.push_back(sResult);
+      CATLogSink::STicket atTickets[AT_LOG_MAX_SINKS];  //Slots claimed in this thread's stages of the threaded sinks.
+      CATLogSink* apClaimed[AT_LOG_MAX_SINKS];  //The sink each of those slots belongs to.
+      unsigned int unClaimed = 0;
+      SATLogRecord Record;  //Built here when no threaded sink took the message.
+      SATLogRecord* pRecord = 0;  //The first copy of the record that got filled in.
+      bool bFit = true;  //Did all of the message fit in pRecord?
 
-      va_end(args);  //Done with the arg list.
+      for (unsigned int i = 0; i < unCount; i++)
+      {
+         CATLogSink* pSink = m_apSinks[i];
+         if (!pSink->Accepts(ucLevelBit) || !pSink->IsThreaded() || !pSink->Claim(atTickets[unClaimed], ucLevel))
+            continue;
 
-      //Are we printing to console?  Then print it out in Green color.
-      if (CHECK_BIT(m_ucFlags, eFlags::CONSOLE))
+         //Fill the first slot in and copy it into the others.
+         if (!pRecord)
+         {
+            pRecord = atTickets[unClaimed].m_tSlot.m_pData;
+            bFit = CATLogBinary::FillRecord(*pRecord, ucLevel, unChannel, ullTimestamp, pFormat, bLiteral, pArgs, unArgCount);
+         }
+         else
+            memcpy(atTickets[unClaimed].m_tSlot.m_pData, pRecord, offsetof(SATLogRecord, m_cData) + pRecord->m_usLength);
+         apClaimed[unClaimed++] = pSink;
+      }
+
+      //The flight recorder keeps a copy of anything a sink took, it's already built.  It only builds its own for
+      //levels it's been asked to record that no sink took.
+      bool bRecorded = false;
+      if (pRecord || CATFlightRecorder::Accepts(ucLevelBit))
+      {
+         if (!pRecord)
+         {
+            bFit = CATLogBinary::FillRecord(Record, ucLevel, unChannel, ullTimestamp, pFormat, bLiteral, pArgs, unArgCount);
+            pRecord = &Record;
+         }
+         CATFlightRecorder::Add(*pRecord);
+         bRecorded = true;
+      }
+
+      //Sinks without a thread of their own output it right here, with the time stamp already turned into wall clock time.
+      SATLogRecord* pOutput = 0;  //What they output.
+      for (unsigned int i = 0; i < unCount; i++)
       {
-         SetConsoleTextAttribute(this->m_hConsole, eColors::GREEN);
-         std::cout << sResult << std::endl;
-         SetConsoleTextAttribute(this->m_hConsole, eColors::WHITE);
+         CATLogSink* pSink = m_apSinks[i];
+         if (!pSink->Accepts(ucLevelBit) || pSink->IsThreaded())
+            continue;
+
+         if (!pOutput)
+         {
+            if (pRecord && bFit)
+            {
+               if (pRecord != &Record)
+                  memcpy(&Record, pRecord, offsetof(SATLogRecord, m_cData) + pRecord->m_usLength);
+               pOutput = &Record;
+            }
+            else
+            {
+               //Nothing's built yet or it was cut short, nobody's queuing this copy so it can be as big as it needs.
+               if (!s_thThread.m_pLarge)
+                  s_thThread.m_pLarge = new SATLogLargeRecord;
+               pOutput = &s_thThread.m_pLarge->m_Record;
+               CATLogBinary::FillRecord(*pOutput, ucLevel, unChannel, ullTimestamp, pFormat, bLiteral, pArgs, unArgCount,
+                  sizeof(SATLogLargeRecord) - offsetof(SATLogRecord, m_cData));
+
+               //Record isn't in use here, so it can hold the recorder's cut down copy.
+               if (!bRecorded && pOutput->m_usLength > sizeof(pOutput->m_cData))
+               {
+                  CATLogBinary::FitRecord(*pOutput, Record);
+                  CATFlightRecorder::Add(Record);
+               }
+               else if (!bRecorded)
+                  CATFlightRecorder::Add(*pOutput);
+            }
+            pOutput->m_ullTimestamp = CATLogClock::ToNanoseconds(pOutput->m_ullTimestamp);
+         }
+         pSink->Write(*pOutput);
       }
+
+      //Only let the sink threads at the record once every copy has been made.
+      for (unsigned int i = 0; i < unClaimed; i++)
+         apClaimed[i]->Publish(atTickets[i]);
    }
 
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   // Function:  warn
-   // Last Modified:  November 18th, 2023 (JB)
-   // Author:  Jason A. Biddle
+   // Function: Flush
    //
-   // Purpose:  Prints out warning messages to Console and/or file, if printed to Console these messages
-   //           print out in Aqua color.
+   // Purpose:  Makes sure every message logged before this call has been written to the Console and output file.
+   //           In ASYNC mode this waits on each sink thread to get there.
    //
-   // In:  sMessage - Message to be printed.
-   //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+   // In:  None
    //
    // Out:  None
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   void CATLogger::warn(const CString sMessage, ...)
+   void CATLogger::Flush()
    {
-      //Are we displaying this message?  If not get outta here!
-      if (this->m_cLoggerLevel != eLevel::WARN && this->m_cLoggerLevel != eLevel::ERR_WARN
-         && this->m_cLoggerLevel != eLevel::WARN_INFO && this->m_cLoggerLevel != eLevel::WARN_TRACE
-         && this->m_cLoggerLevel != eLevel::ALL)
-         return;
-
-      va_list args;  //Grab the list of arguments passed to info.
-      va_start(args, sMessage);  //Begin processing from args list.
-
-      CString sResult = this->buildMessage(sMessage, args);
-      if (CHECK_BIT(m_ucFlags, eFlags::LOGFILE))  //If we're outputting to file then store in vector for later processing.
-         m_vFileQueue.push_back(sResult);
-
-      va_end(args);  //Done with the arg list.
-
-      //Are we printing to console?  Then print it out in Yellow color.
-      if (CHECK_BIT(m_ucFlags, eFlags::CONSOLE))
-      {
-         SetConsoleTextAttribute(this->m_hConsole, eColors::YELLOW);
-         std::cout << sResult << std::endl;
-         SetConsoleTextAttribute(this->m_hConsole, eColors::WHITE);
-      }
+      SATSinksInUse siuSinks;
+      this->FlushRepeats();
+      unsigned int unCount = m_unSinkCount.load(std::memory_order_seq_cst);
+      for (unsigned int i = 0; i < unCount; i++)
+         m_apSinks[i]->Flush();
    }
 
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   // Function:  error
-   // Last Modified:  November 18th, 2023 (JB)
-   // Author:  Jason A. Biddle
+   // Function:  AddSink
    //
-   // Purpose:  Prints out error messages to Console and/or file, if printed to Console these messages
-   //           print out in Aqua color.
+   // Purpose:  Adds somewhere for messages to go, on top of the Console and file set up by Init.  The sink picks
+   //           up the Logger's time stamp settings and, in ASYNC mode, gets its own thread.  Can be called before
+   //           or after Init.
    //
-   // In:  sMessage - Message to be printed.
-   //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+   // In:  pSink - The sink, allocated with new.  The Logger deletes it at Shutdown.
    //
-   // Out:  None
+   // Out:  true if the sink was added, false if there are already AT_LOG_MAX_SINKS (pSink is deleted).
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   void CATLogger::error(const CString sMessage, ...)
+   bool CATLogger::AddSink(CATLogSink* pSink)
    {
-      //Are we displaying this message?  If not get outta here!
-      if (this->m_cLoggerLevel != eLevel::ERR && this->m_cLoggerLevel != eLevel::ERR_INFO
-         && this->m_cLoggerLevel != eLevel::ERR_WARN && this->m_cLoggerLevel != eLevel::ERR_TRACE
-         && this->m_cLoggerLevel != eLevel::ALL)
-         return;
+      if (!pSink)
+         return false;
 
-      va_list args;  //Grab the list of arguments passed to info.
-      va_start(args, sMessage);  //Begin processing from args list.
+      std::lock_guard<std::mutex> lgSinks(m_mtxSinks);
+      unsigned int unCount = m_unSinkCount.load(std::memory_order_relaxed);
+      if (unCount >= AT_LOG_MAX_SINKS)
+      {
+         delete pSink;
+         return false;
+      }
 
-      CString sResult = this->buildMessage(sMessage, args);
-      if (CHECK_BIT(m_ucFlags, eFlags::LOGFILE))  //If we're outputting to file then store in vector for later processing.
-         m_vFileQueue.push_back(sResult);
+      pSink->SetTimestamp(CHECK_BIT(m_ucFlags, eFlags::TIMESTAMP));
+      pSink->SetTimestampDigits(m_ucTimestampDigits);
+      if (m_bInitialized)
+         pSink->Start(CHECK_BIT(m_ucFlags, eFlags::ASYNC));
 
-      va_end(args);  //Done with the arg list.
+      //Publish it once it's ready to take records.
+      m_apSinks[unCount] = pSink;
+      m_unSinkCount.store(unCount + 1, std::memory_order_release);
+      return true;
+   }
 
-      //Are we printing to console?  Then print it out in Red color.
-      if (CHECK_BIT(m_ucFlags, eFlags::CONSOLE))
-      {
-         SetConsoleTextAttribute(this->m_hConsole, eColors::RED);
-         std::cout << sResult << std::endl;
-         SetConsoleTextAttribute(this->m_hConsole, eColors::WHITE);
-      }
+   //Number of messages dropped by every sink put together.
+   unsigned long long CATLogger::GetDroppedCount() const
+   {
+      SATSinksInUse siuSinks;
+      unsigned long long ullDropped = 0;
+      unsigned int unCount = m_unSinkCount.load(std::memory_order_seq_cst);
+      for (unsigned int i = 0; i < unCount; i++)
+         ullDropped += m_apSinks[i]->GetDroppedCount();
+      return ullDropped;
    }
 
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   // Function:  buildMessage
-   // Last Modified:  November 18th, 2023 (JB)
-   // Author:  Jason A. Biddle
+   // Function:  GetStats
    //
-   // Purpose:  Constructs the message being outputted by the Logger.
+   // Purpose:  Takes a snapshot of what the Logger has been up to: messages per level, bytes formatted and written,
+   //           drops, the deepest any sink's queue has been and how long logging and formatting take.
    //
-   // In:  sFormat - The message being outputted e.g. "Hello there {f}!"
-   //      args - The variables that will be pressed into sFormat.
+   // In:  Stats - Receives the numbers.
    //
-   // Out:  sResult - The completed message to be outputted.
-   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////   
-   CString CATLogger::buildMessage(const CString &sFormat, va_list args)
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogger::GetStats(SATLogStats& Stats) const
    {
-      CString sResult;  //The completed message.
-
-      //Are we using a time stamp?  If so add it to sResult.
-      if (CHECK_BIT(m_ucFlags,eFlags::TIMESTAMP))
+      SATSinksInUse siuSinks;
+      CATLogStats::Snapshot(Stats);
+      Stats.m_ullBytesWritten = 0;
+      Stats.m_ullDropped = 0;
+      Stats.m_ullOverwritten = 0;
+      Stats.m_ullBlocked = 0;
+      Stats.m_ullQueueHighWater = 0;
+
+      unsigned int unCount = m_unSinkCount.load(std::memory_order_seq_cst);
+      for (unsigned int i = 0; i < unCount; i++)
       {
-         time_t ttCurrent = time(0);
-         tm now_time = {};
-
-         char cBuffer[30] = {};
-
-         localtime_s(&now_time, &ttCurrent);  //Grabs current system time.
-         strftime(cBuffer, 30, "[%D %T]", &now_time);  //Format it into something legable.
-         sResult += cBuffer;
-         sResult += ' ';
-      }
-
-      int i = 0;
-      int nLastPos = 0;  //Last position of } found.
-      bool bCarryOn = true;  //Keep going?
-      bool bFirstPass = true;  //Have we already found a {}?
-      while(bCarryOn)
-      {
-         switch (sFormat[i])
-         {
-            case '\0':  //We've reach end of string.
-            {
-               bCarryOn = false;  //Stop processing.
-               if (bFirstPass)  //Didn't find any tags?  Then sFormat is sResult.
-                  sResult += sFormat;
-               else
-                  sResult += sFormat.Substring(i, nLastPos);
-               break;
-            }
-            case '{':
-            {
-               sResult += sFormat.Substring(i, nLastPos);  //Grab the substring from last tag to new tag.
-
-               //Find end of tag.
-               int j = i;
-               while (sFormat[j] != '}')
-                  j++;               
-
-               //Break out the variable type.
-               CString sToken = sFormat.Substring(j, i+1);
-
-               if (bFirstPass)
-                  bFirstPass = false;
-
-               sResult += ProcessToken(sToken, args);
-               nLastPos = j + 1;
-               break;
-            }
-         }
-
-         i++;
+         Stats.m_ullBytesWritten += m_apSinks[i]->GetBytesWritten();
+         Stats.m_ullDropped += m_apSinks[i]->GetDroppedCount();
+         Stats.m_ullOverwritten += m_apSinks[i]->GetOverwrittenCount();
+         Stats.m_ullBlocked += m_apSinks[i]->GetBlockedCount();
+         if (m_apSinks[i]->GetQueueHighWater() > Stats.m_ullQueueHighWater)
+            Stats.m_ullQueueHighWater = m_apSinks[i]->GetQueueHighWater();
       }
+   }
 
-      return sResult;
+   //Puts a summary of GetStats out as an info message on the general channel.
+   void CATLogger::OutputStats()
+   {
+      static const char sStats[] = "Logger stats: {u} messages ({u} error, {u} warn, {u} trace, {u} info), {u} bytes formatted, "
+         "{u} bytes written, {u} dropped, {u} overwritten, {u} blocked, queue high water {u}, log call p50 {u}ns p99 {u}ns, format p50 {u}ns p99 {u}ns";
+
+      SATLogStats Stats;
+      this->GetStats(Stats);
+
+      unsigned long long ullMessages = Stats.m_aullMessages[0] + Stats.m_aullMessages[1] + Stats.m_aullMessages[2] + Stats.m_aullMessages[3];
+      SATFormatArg aArgs[] = {MakeFormatArg(ullMessages), MakeFormatArg(Stats.m_aullMessages[eLevel::ERR]),
+         MakeFormatArg(Stats.m_aullMessages[eLevel::WARN]), MakeFormatArg(Stats.m_aullMessages[eLevel::TRACE]),
+         MakeFormatArg(Stats.m_aullMessages[eLevel::INFO]), MakeFormatArg(Stats.m_ullBytesFormatted),
+         MakeFormatArg(Stats.m_ullBytesWritten), MakeFormatArg(Stats.m_ullDropped), MakeFormatArg(Stats.m_ullOverwritten),
+         MakeFormatArg(Stats.m_ullBlocked), MakeFormatArg(Stats.m_ullQueueHighWater),
+         MakeFormatArg(CATLogStats::Percentile(Stats.m_aullCallLatency, 0.5)), MakeFormatArg(CATLogStats::Percentile(Stats.m_aullCallLatency, 0.99)),
+         MakeFormatArg(CATLogStats::Percentile(Stats.m_aullFormatLatency, 0.5)), MakeFormatArg(CATLogStats::Percentile(Stats.m_aullFormatLatency, 0.99))};
+      this->Dispatch(CATLogClock::Now(), eLevel::INFO, CATLogChannels::CHANNEL_GENERAL, sStats, true, aArgs, sizeof(aArgs) / sizeof(aArgs[0]));
    }
 
    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-   // Function:  ProcessToken
-   // Last Modified:  November 18th, 2023 (JB)
-   // Author:  Jason A. Biddle
+   // Function:  TickThread
    //
-   // Purpose:  Grabs the variable out of the args list to covert into a string.
+   // Purpose:  Every AT_LOG_TICK_INTERVAL milliseconds, keeps the clock lined up with the wall clock (see
+   //           CATLogClock::Reanchor) and ticks each sink without a thread of its own (see CATLogSink::Tick) so a file
+   //           that goes quiet still gets flushed once its interval is up.  Sink threads already do this between
+   //           batches.  Runs from Init until Shutdown.
    //
-   // In:  sToken - The type the variable is. e.g. i = int, u = unsigned int, etc.
-   //      args - List of arguments set into the buildMessage function.
+   // In:  None
    //
-   // Out: sResult - The variable turned into a CString.
-   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////   
-   CString CATLogger::ProcessToken(const CString &sToken, va_list &args)
+   // Out:  None
+   /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+   void CATLogger::TickThread()
    {
-      CString sResult;  //Converted variable into string.
-      char cBuffer[256] = {};  //Buffer used for snprintf.
-      int nOut = 0;  //Number of character used by snprintf.
-
-      if (sToken.Length() == 1)
+      std::unique_lock<std::mutex> ulTick(m_mtxTick);
+      while (m_bTicking)
       {
-         switch (sToken[0])
+         m_cvTick.wait_for(ulTick, std::chrono::milliseconds(AT_LOG_TICK_INTERVAL));
+         if (!m_bTicking)
+            break;
+
+         ulTick.unlock();
+         CATLogClock::Reanchor();
          {
-            case 'i':  // int/short
-            {
-               sResult = std::to_string(va_arg(args, int)).c_str();
-               break;
-            }
-            case 'u':  // Unsigned int/short/char
-            {
-               sResult = std::to_string(va_arg(args, unsigned int)).c_str();
-               break;
-            }
-            case 'f':  //Float
-            {
-               sResult = std::to_string(va_arg(args, double)).c_str();
-               break;
-            }
-            case 'd':  //Double
-            {
-               sResult = std::to_string(va_arg(args, double)).c_str();
-               break;
-            }
-            case 'c':  //Single character
-            {
-               sResult = va_arg(args, char);
-               break;
-            }
-            case 's':  //String
+            std::lock_guard<std::mutex> lgSinks(m_mtxSinks);
+            unsigned int unCount = m_unSinkCount.load(std::memory_order_relaxed);
+            for (unsigned int i = 0; i < unCount; i++)
             {
-               sResult = va_arg(args, const char*);
-               break;
-            }
-            case 'p':  //Printing out pointer address.
-            {
-               nOut = snprintf(cBuffer, BUFFER_SIZE, "0x%p", va_arg(args, void*));
-               sResult = cBuffer;
-               break;
-            }
-            case 'b':  //Boolean
-            {
-               bool bValue = va_arg(args, bool);
-               if (bValue)
-                  sResult = "True";
-               else
-                  sResult = "False";
-               break;
-            }
-            case 'l':  //Long
-            {
-               sResult = std::to_string(va_arg(args, long int)).c_str();
-               break;
+               if (!m_apSinks[i]->IsThreaded())
+                  m_apSinks[i]->Tick();
             }
          }
+         ulTick.lock();
       }
-      else
+   }
+
+   //Hands the Logger's time stamp settings to every sink.
+   void CATLogger::UpdateSinkTimestamps()
+   {
+      std::lock_guard<std::mutex> lgSinks(m_mtxSinks);
+      unsigned int unCount = m_unSinkCount.load(std::memory_order_relaxed);
+      for (unsigned int i = 0; i < unCount; i++)
       {
-         if (sToken == "ll")  //Long Long
-            sResult = std::to_string(va_arg(args, long long int)).c_str();
-         else if (sToken == "lu")  //unsigned Long
-            sResult = std::to_string(va_arg(args, unsigned long int)).c_str();
-         else if (sToken == "llu")  //unsigned Long Long
-            sResult = std::to_string(va_arg(args,unsigned long long int)).c_str();
+         m_apSinks[i]->SetTimestamp(CHECK_BIT(m_ucFlags, eFlags::TIMESTAMP));
+         m_apSinks[i]->SetTimestampDigits(m_ucTimestampDigits);
       }
-      return sResult;
    }
 }
\ No newline at end of file
@@ -6,9 +6,39 @@
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #pragma once
 
-#include <windows.h>
-#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+#include <mutex>
 #include "CString.h"
+#include "ATLogRecord.h"
+#include "ATLogFormat.h"
+#include "ATLogBinary.h"
+#include "ATLogJson.h"
+#include "ATLogChannel.h"
+#include "ATLogClock.h"
+#include "ATLogSink.h"
+#include "ATLogConsoleSink.h"
+#include "ATLogFileSink.h"
+#include "ATLogRollingFileSink.h"
+#include "ATLogMemorySink.h"
+#include "ATLogSocketSink.h"
+#include "ATLogFlightRecorder.h"
+#include "ATLogSite.h"
+#include "ATLogStats.h"
+#include "ATLogTrace.h"
+
+//Most sinks the Logger can have at once, the Console and file included.
+#ifndef AT_LOG_MAX_SINKS
+#define AT_LOG_MAX_SINKS 8
+#endif
+
+//Milliseconds between the Logger's ticks, which let sinks without a thread of their own flush and roll over while
+//nothing is being logged, and re-anchor the clock (AT_LOG_CLOCK_REANCHOR).  Keep it under the file flush interval
+//(AT_LOG_FILE_INTERVAL).
+#ifndef AT_LOG_TICK_INTERVAL
+#define AT_LOG_TICK_INTERVAL 100
+#endif
 
 #define SET_BIT(x,y) (x |= y)
 #define CLEAR_BITS(x) (x = 0)
@@ -21,25 +51,52 @@ namespace Atlas
    class CATLogger
    {
       private:
-         static CATLogger*       m_pInstance;  //The one and ONLY instance of the Logger.
-         HANDLE                  m_hConsole;  //The handle to the Console that we're outputting to.
+         static std::atomic<CATLogger*>   m_pInstance;  //The one and ONLY instance of the Logger.
+         static std::mutex                m_mtxInstance;  //Held while creating or deleting the instance.
          CString                 m_sOutputFilename; //Name of the File we're outputting to.
-         std::vector<CString>    m_vFileQueue;  //Vector of all the Messages that will be put into file.
+         unsigned int            m_unFileFlushSize;  //Flush policy handed to the file sink when Init creates it.
+         unsigned int            m_unFileFlushInterval;
+         unsigned long long      m_ullFileMaxBytes;  //Roll policy handed to the file sink when Init creates it.
+         unsigned int            m_unFileMaxSeconds;
+         unsigned int            m_unFileKeep;
+         bool                    m_bFileCompress;
 
          unsigned char           m_cLoggerLevel;  //Message level that we're only outputting.
          unsigned char           m_ucFlags;  //Logger states such as "Are we outputting to a file?" or "Are we viewing a time stamp?".
+         unsigned char           m_ucTimestampDigits;  //Digits after the seconds in time stamps (CATLogClock::ePrecision).
+         bool                    m_bInitialized;  //Has Init been called?  Sinks added before then are started by Init.
+         std::mutex              m_mtxInit;  //Held through Init and Shutdown so they only ever run one at a time.
+
+         CATLogSink*                m_apSinks[AT_LOG_MAX_SINKS];  //Everywhere messages go, owned by the Logger.
+         std::atomic<unsigned int>  m_unSinkCount;  //Number of sinks in m_apSinks.
+         std::mutex                 m_mtxSinks;  //Held while adding or removing sinks.
 
-         //Colors that can be used on Console Output.
-         enum eColors {BLACK = 0, BLUE, GREEN, AQUA, RED, PURPLE, YELLOW, WHITE, GRAY, LIGHT_BLUE,
-            LIGHT_GREEN, LIGHT_AQUA, LIGHT_RED, LIGHT_PURPLE, LIGHT_YELLO, BRIGHT_WHITE};
+         unsigned char                    m_ucBackpressure;  //CATLogSink::eBackpressure Init hands to every sink.
+         unsigned char                    m_ucKeepLevel;  //Least important level DROP_BELOW_LEVEL never drops.
+
+         std::atomic<bool>                m_bCollapseRepeats;  //Collapse identical back to back messages from the same thread?
+
+         std::atomic<unsigned long long>  m_ullStatsInterval;  //Nanoseconds between stats summaries, 0 for none.
+         std::atomic<unsigned long long>  m_ullLastStats;  //When the last summary went out, CATLogClock ticks.
+
+         std::thread                      m_tTick;  //Ticks the clock and sinks every AT_LOG_TICK_INTERVAL, from Init to Shutdown.
+         std::mutex                       m_mtxTick;  //Guards m_bTicking.
+         std::condition_variable          m_cvTick;  //Wakes the tick thread early when it's time to stop.
+         bool                             m_bTicking;  //Tells the tick thread to keep going.
 
          CATLogger();  //Constructor
          CATLogger(const CATLogger&);  //Copy Constructor
          CATLogger* operator=(const CATLogger&);  //Assignment Operator
          ~CATLogger();  //Destructor
 
-         CString buildMessage(const CString &sFormat, va_list args);  //Constructs the Message to be outputted.
-         CString ProcessToken(const CString& sToken, va_list &args);  //String-afies a given token into a string.
+         void Log(unsigned char ucLevel, unsigned int unChannel, const char* pFormat, bool bLiteral, const SATFormatArg* pArgs, unsigned int unArgCount);  //Collapses repeats then hands the message to Dispatch.
+         void Dispatch(unsigned long long ullTimestamp, unsigned char ucLevel, unsigned int unChannel, const char* pFormat, bool bLiteral,
+            const SATFormatArg* pArgs, unsigned int unArgCount);  //Records a message and hands it to every sink that wants it.
+         void FlushRepeats();  //Outputs the "repeated N times" message for every thread's last message that was repeated.
+         void OutputRepeats(unsigned char ucLevel, unsigned int unChannel, unsigned int unRepeats);  //Outputs "Last message repeated N times".
+         void UpdateSinkTimestamps();  //Hands the Logger's time stamp settings to every sink.
+         void OutputStats();  //Puts a summary of GetStats out as an info message.
+         void TickThread();  //Ticks the sinks without a thread of their own until Shutdown.
 
       public:
 
@@ -48,7 +105,58 @@ namespace Atlas
             WARN_INFO, TRACE_INFO, ALL};
 
          //Various flag states for the Logger.
-         enum eFlags {TIMESTAMP = 1, LOGFILE = 2, CONSOLE = 4};
+         enum eFlags {TIMESTAMP = 1, LOGFILE = 2, CONSOLE = 4, ASYNC = 8, BINARY = 16, JSON = 32, INDEXED = 64};
+
+         //Bit a single message level (ERR, WARN, TRACE or INFO) takes up in a channel's level mask.
+         static constexpr unsigned char LevelBit(unsigned char ucLevel) { return static_cast<unsigned char>(1 << ucLevel); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  LevelMask
+         //
+         // Purpose:  Turns one of the eLevel settings (including the combined ones like WARN_INFO) into the mask of
+         //           level bits it lets through.
+         //
+         // In:  level - The Logger or channel level.
+         //
+         // Out:  The level mask.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static constexpr unsigned char LevelMask(eLevel level)
+         {
+            switch (level)
+            {
+               case eLevel::ERR:        return LevelBit(eLevel::ERR);
+               case eLevel::WARN:       return LevelBit(eLevel::WARN);
+               case eLevel::TRACE:      return LevelBit(eLevel::TRACE);
+               case eLevel::INFO:       return LevelBit(eLevel::INFO);
+               case eLevel::ERR_WARN:   return LevelBit(eLevel::ERR) | LevelBit(eLevel::WARN);
+               case eLevel::ERR_TRACE:  return LevelBit(eLevel::ERR) | LevelBit(eLevel::TRACE);
+               case eLevel::ERR_INFO:   return LevelBit(eLevel::ERR) | LevelBit(eLevel::INFO);
+               case eLevel::WARN_TRACE: return LevelBit(eLevel::WARN) | LevelBit(eLevel::TRACE);
+               case eLevel::WARN_INFO:  return LevelBit(eLevel::WARN) | LevelBit(eLevel::INFO);
+               case eLevel::TRACE_INFO: return LevelBit(eLevel::TRACE) | LevelBit(eLevel::INFO);
+               case eLevel::ALL:        return LevelBit(eLevel::ERR) | LevelBit(eLevel::WARN) | LevelBit(eLevel::TRACE) | LevelBit(eLevel::INFO);
+            }
+            return 0;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  IsLevelEnabled
+         //
+         // Purpose:  Checks a message's level against the level mask of the channel it's being logged on, and the
+         //           flight recorder's if it's been turned on for more (see SetFlightRecorderLevel).  The AT_LOG_*
+         //           macros call this before anything else, so a message that's turned off costs two loads and
+         //           compares and its arguments are never evaluated.  Doesn't need the Logger instance.
+         //
+         // In:  unChannel - The channel the message is logged on.
+         //      ucLevel - The eLevel of the message.
+         //
+         // Out:  true if the message should be displayed, false otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         static bool IsLevelEnabled(unsigned int unChannel, unsigned char ucLevel)
+         {
+            return unChannel < AT_LOG_MAX_CHANNELS && (CATLogChannels::IsEnabled(unChannel, LevelBit(ucLevel)) ||
+               CATFlightRecorder::Accepts(LevelBit(ucLevel)));
+         }
 
          static CATLogger* GetInstance();  //Retrieves the one and ONLY Instance of the Logger.
          static void DeleteInstance();  //Deletes the one and ONLY Instance of the Logger.
@@ -58,10 +166,20 @@ namespace Atlas
          // Last Modified:  November 18th, 2023 (JB)  
          // Author:  Jason A. Biddle
          //
-         // Purpose:  Intializes the Logger
+         // Purpose:  Intializes the Logger.  Safe to call from more than one thread, only the first call sets
+         //           anything up until Shutdown, the rest just return true.
          //
          // In:  Loggerlevel - The type of message(s) that the Logger will display or output to file.
-         //      ucFlags - Set whether we're using a Time Stamp, Outputting to Console and/or file.
+         //      ucFlags - Set whether we're using a Time Stamp, Outputting to Console and/or file.  ASYNC moves all
+         //                output onto background threads, one per sink, so callers only pay for queuing the message.
+         //                BINARY writes the file as raw records to be turned into text later by ATLogDecode.
+         //                JSON writes the file as JSON Lines, one object per message with its kv fields (ATLogJson.h).
+         //                INDEXED writes a BINARY file in indexed blocks so ATLogQuery can pull out a time range or
+         //                level without reading the rest (ATLogBinary.h).
+         //                What ASYNC does when a sink falls behind is set beforehand with SetBackpressure.
+         //                ASYNC queues, BINARY and INDEXED files keep AT_LOG_RECORD_SIZE bytes of a message's
+         //                arguments, everything else AT_LOG_LARGE_RECORD_SIZE, anything cut short ends in
+         //                AT_LOG_TRUNCATED (see ATLogRecord.h).
          //      sOutputFilename - Name of the file for where the messages will be ouputted.
          // 
          // Out:  Returns true if Logger was successfully intialized, false otherwise.
@@ -73,7 +191,7 @@ namespace Atlas
          // Last Modified:  November 18th, 2023 (JB)
          // Author:  Jason A. Biddle
          //
-         // Purpose:  Cleans up memory and writes out messages to desired output file.
+         // Purpose:  Cleans up memory and writes out any messages still waiting to go to the output file.
          //
          // In:  None
          //
@@ -81,6 +199,18 @@ namespace Atlas
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////         
          void Shutdown();
 
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function: Flush
+         //
+         // Purpose:  Makes sure every message logged before this call has been written to the Console and output file.
+         //           In ASYNC mode this waits on each sink thread to get there.
+         //
+         // In:  None
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void Flush();
+
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
          // Function:  info
          // Last Modified:  November 18th, 2023 (JB)
@@ -90,11 +220,30 @@ namespace Atlas
          //           print out in Aqua color.
          //
          // In:  sMessage - Message to be printed.
-         //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //      args - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //             When sMessage is a string literal the placeholders are checked against args at compile time.
+         //             Named fields can follow, e.g. info("frame done", kv("ms", dt), kv("entities", n)).
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-         void info(const CString sMessage, ...);
+         template <typename... Args>
+         void info(CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(CATLogChannels::CHANNEL_GENERAL, eLevel::INFO))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::INFO, CATLogChannels::CHANNEL_GENERAL, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
+
+         //Same as above but on a channel, e.g. info(CATLogChannels::CHANNEL_RENDER, "...").
+         template <typename... Args>
+         void info(unsigned int unChannel, CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(unChannel, eLevel::INFO))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::INFO, unChannel, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
 
 
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -106,11 +255,30 @@ namespace Atlas
          //           print out in Aqua color.
          //
          // In:  sMessage - Message to be printed.
-         //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //      args - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //             When sMessage is a string literal the placeholders are checked against args at compile time.
+         //             Named fields can follow, e.g. info("frame done", kv("ms", dt), kv("entities", n)).
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-         void trace(const CString sMessage, ...);
+         template <typename... Args>
+         void trace(CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(CATLogChannels::CHANNEL_GENERAL, eLevel::TRACE))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::TRACE, CATLogChannels::CHANNEL_GENERAL, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
+
+         //Same as above but on a channel, e.g. trace(CATLogChannels::CHANNEL_RENDER, "...").
+         template <typename... Args>
+         void trace(unsigned int unChannel, CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(unChannel, eLevel::TRACE))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::TRACE, unChannel, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
 
 
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -122,11 +290,30 @@ namespace Atlas
          //           print out in Aqua color.
          //
          // In:  sMessage - Message to be printed.
-         //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //      args - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //             When sMessage is a string literal the placeholders are checked against args at compile time.
+         //             Named fields can follow, e.g. info("frame done", kv("ms", dt), kv("entities", n)).
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-         void warn(const CString sMessage, ...);
+         template <typename... Args>
+         void warn(CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(CATLogChannels::CHANNEL_GENERAL, eLevel::WARN))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::WARN, CATLogChannels::CHANNEL_GENERAL, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
+
+         //Same as above but on a channel, e.g. warn(CATLogChannels::CHANNEL_RENDER, "...").
+         template <typename... Args>
+         void warn(unsigned int unChannel, CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(unChannel, eLevel::WARN))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::WARN, unChannel, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
 
 
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -138,76 +325,445 @@ namespace Atlas
          //           print out in Aqua color.
          //
          // In:  sMessage - Message to be printed.
-         //      ... - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //      args - variables to be imprinted into sMessage using {} e.g. info("There are {i} items in array.",nCount)
+         //             When sMessage is a string literal the placeholders are checked against args at compile time.
+         //             Named fields can follow, e.g. info("frame done", kv("ms", dt), kv("entities", n)).
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-         void error(const CString sMessage, ...);
+         template <typename... Args>
+         void error(CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(CATLogChannels::CHANNEL_GENERAL, eLevel::ERR))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::ERR, CATLogChannels::CHANNEL_GENERAL, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
+
+         //Same as above but on a channel, e.g. error(CATLogChannels::CHANNEL_RENDER, "...").
+         template <typename... Args>
+         void error(unsigned int unChannel, CATFormatString<std::type_identity_t<Args>...> sMessage, const Args&... args)
+         {
+            if (!IsLevelEnabled(unChannel, eLevel::ERR))
+               return;
+            SATFormatArg aArgs[sizeof...(Args) + 1] = {MakeFormatArg(args)...};
+            this->Log(eLevel::ERR, unChannel, sMessage.Get(), sMessage.IsLiteral(), aArgs, sizeof...(Args));
+         }
 
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
          // Function: SetLevel
          // Last Modified:  November 18th, 2023 (JB)
          // Author:  Jason A. Biddle
          //
-         // Purpose:  Set the message level of the Logger.  e.g. SetLevel(eLevel::ERR);
+         // Purpose:  Set the message level of the Logger.  e.g. SetLevel(eLevel::ERR);  This resets every channel to
+         //           the same level, use SetChannelLevel afterwards to turn single channels up or down.
          //
          // In:  level - The type of message(s) that will be outputted by the Logger.
          //              All other message types will be ignored.
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-         void SetLevel(eLevel level = eLevel::INFO) { m_cLoggerLevel = level; }
+         void SetLevel(eLevel level = eLevel::INFO)
+         {
+            m_cLoggerLevel = level;
+            CATLogChannels::SetAllMasks(LevelMask(level));
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function: SetChannelLevel
+         //
+         // Purpose:  Set the message level of a single channel.  e.g. SetChannelLevel(CATLogChannels::CHANNEL_NET, eLevel::ALL);
+         //
+         // In:  unChannel - The channel's id.
+         //      level - The type of message(s) that will be outputted on that channel.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetChannelLevel(unsigned int unChannel, eLevel level) { CATLogChannels::SetMask(unChannel, LevelMask(level)); }
+
+         //Same as above but finds the channel by name, returns false if there's no such channel.
+         bool SetChannelLevel(const char* pChannel, eLevel level)
+         {
+            unsigned int unChannel = CATLogChannels::Find(pChannel);
+            if (unChannel == CATLogChannels::INVALID_CHANNEL)
+               return false;
+            CATLogChannels::SetMask(unChannel, LevelMask(level));
+            return true;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function: RegisterChannel
+         //
+         // Purpose:  Adds a channel for a subsystem that isn't one of the built in ones.  Registering a name that
+         //           already exists hands back the existing channel.
+         //
+         // In:  pName - Name of the channel, shows up in front of its messages e.g. "[ai] ".
+         //      level - The type of message(s) that will be outputted on that channel.
+         //
+         // Out:  The channel's id, CATLogChannels::INVALID_CHANNEL if all AT_LOG_MAX_CHANNELS are taken.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         unsigned int RegisterChannel(const char* pName, eLevel level = eLevel::ALL) { return CATLogChannels::Register(pName, LevelMask(level)); }
          
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
          // Function:  EnableTimeStamp
          // Last Modified:  November 18th, 2023 (JB)
          // Author:  Jason A. Biddle
          //
-         // Purpose:  Enables use of a time stamp in messages.
+         // Purpose:  Enables use of a time stamp in messages, on every sink.
          //
          // In:  None
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-         void EnableTimeStamp() { SET_BIT(m_ucFlags,eFlags::TIMESTAMP); }
+         void EnableTimeStamp() { SET_BIT(m_ucFlags,eFlags::TIMESTAMP); this->UpdateSinkTimestamps(); }
          
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
          // Function:  DisableTimeStamp
          // Last Modified:  November 18th, 2023 (JB)
          // Author:  Jason A. Biddle
          //
-         // Purpose:  Disables the use of time stamps in messages.
+         // Purpose:  Disables the use of time stamps in messages, on every sink.
          //
          // In:  None
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-         void DisableTimeStamp() { CLEAR_BIT(m_ucFlags, eFlags::TIMESTAMP); }
+         void DisableTimeStamp() { CLEAR_BIT(m_ucFlags, eFlags::TIMESTAMP); this->UpdateSinkTimestamps(); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetTimeStampPrecision
+         //
+         // Purpose:  Sets how much of the second time stamps show, microseconds by default.  Call before Init when
+         //           writing a BINARY file so ATLogDecode picks it up too.
+         //
+         // In:  ePrecision - PRECISION_SECONDS, PRECISION_MILLI, PRECISION_MICRO or PRECISION_NANO.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetTimeStampPrecision(CATLogClock::ePrecision ePrecision)
+         {
+            m_ucTimestampDigits = static_cast<unsigned char>(ePrecision);
+            this->UpdateSinkTimestamps();
+         }
          
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
          // Function:  SetOutputFile
          // Last Modified:  November 18th, 2023 (JB)
          // Author:  Jason A. Biddle
          //
-         // Purpose:  Sets the name of the file that messages will be outputted to.
+         // Purpose:  Sets the name of the file that messages will be outputted to.  The file is opened by Init, so this
+         //           needs to be called before Init to have any effect.
          //
          // In:  sOutputFilename - Name of the file to be created.
          //
          // Out:  None
          /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
          void SetOutputFile(const char* sOutputFilename) { m_sOutputFilename = sOutputFilename; }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetFileFlushPolicy
+         //
+         // Purpose:  Sets how often buffered messages get written to the output file.  The buffer itself is a fixed
+         //           AT_LOG_FILE_BUFFER bytes.  Call before Init.
+         //
+         // In:  unFlushSize - Write out once this many bytes are waiting.
+         //      unFlushInterval - Write out once the oldest waiting message is this many milliseconds old.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetFileFlushPolicy(unsigned int unFlushSize, unsigned int unFlushInterval)
+         {
+            m_unFileFlushSize = unFlushSize;
+            m_unFileFlushInterval = unFlushInterval;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetFileRollPolicy
+         //
+         // Purpose:  Has the output file roll over to a fresh one once it gets too big or too old.  The file being
+         //           written keeps its name, closed ones get the time they were closed added to theirs.  Call before Init.
+         //
+         // In:  ullMaxBytes - Roll over once the file gets this big, 0 for never.
+         //      unMaxSeconds - Roll over once the file is this many seconds old, 0 for never.
+         //      unKeep - Number of closed files to keep, older ones are deleted.
+         //      bCompress - Gzip closed files in the background (needs AT_LOG_ZLIB).
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetFileRollPolicy(unsigned long long ullMaxBytes, unsigned int unMaxSeconds, unsigned int unKeep = AT_LOG_ROLL_KEEP, bool bCompress = true)
+         {
+            m_ullFileMaxBytes = ullMaxBytes;
+            m_unFileMaxSeconds = unMaxSeconds;
+            m_unFileKeep = unKeep;
+            m_bFileCompress = bCompress;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetBackpressure
+         //
+         // Purpose:  Sets what happens in ASYNC mode when a sink can't keep up and a calling thread's queue into it
+         //           fills: wait for room (BLOCK), drop the new message (DROP_NEWEST, the default), throw away the
+         //           oldest waiting message (OVERWRITE_OLDEST) or drop only messages less important than KeepLevel
+         //           (DROP_BELOW_LEVEL).  Call before Init, which hands it to every sink it starts.  Sinks added after
+         //           Init keep their own (CATLogSink::SetBackpressure).  Counts show up in GetStats.
+         //
+         // In:  ePolicy - The policy.
+         //      KeepLevel - For DROP_BELOW_LEVEL, the least important level that is never dropped (ERR, WARN, TRACE
+         //                  or INFO).  ERR keeps only errors.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetBackpressure(CATLogSink::eBackpressure ePolicy, eLevel KeepLevel = eLevel::ERR)
+         {
+            m_ucBackpressure = static_cast<unsigned char>(ePolicy);
+            m_ucKeepLevel = static_cast<unsigned char>((KeepLevel <= eLevel::INFO) ? KeepLevel : eLevel::ERR);
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetCollapseRepeats
+         //
+         // Purpose:  Turns collapsing of repeated messages on or off (off by default).  While on, a message identical
+         //           to the one its thread logged before it (same level, channel, format and arguments) isn't output,
+         //           instead a single "Last message repeated N times" goes out once that thread logs a different
+         //           message or on Flush.  Messages are matched by a hash of all that, confirmed by the format and
+         //           number of arguments being the same.
+         //
+         // In:  bCollapse - Collapse repeated messages?
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetCollapseRepeats(bool bCollapse) { m_bCollapseRepeats.store(bCollapse, std::memory_order_relaxed); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetFlightRecorderLevel
+         //
+         // Purpose:  Sets which messages the flight recorder keeps on top of what the sinks take, no matter what
+         //           level the channels and sinks are at.  Everything a sink takes is recorded anyway, this is only for
+         //           more.  Levels turned on here are built into records even when the channel filters them out, so
+         //           every message at those levels costs about what a logged one does.
+         //           Those filtered messages only go to the recorder, they aren't counted in the stats, collapsed as
+         //           repeats or let through by AT_LOG_*_ONCE, _EVERY_N and _RATE.
+         //
+         // In:  level - The type of message(s) that will be recorded.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetFlightRecorderLevel(eLevel level) { CATFlightRecorder::SetLevelMask(LevelMask(level)); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  EnableCrashDump
+         //
+         // Purpose:  Writes the flight recorder's last AT_LOG_FLIGHT_RECORDS messages to a BINARY Log file if the
+         //           program crashes (SIGSEGV, SIGABRT, std::terminate, ...).  Read it back with ATLogDecode.
+         //
+         // In:  pFilename - Name of the file the messages get dumped to.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void EnableCrashDump(const char* pFilename) { CATFlightRecorder::InstallCrashHandler(pFilename, m_ucTimestampDigits); }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  ExportTrace
+         //
+         // Purpose:  Writes the spans recorded by AT_LOG_SCOPE out as a Chrome Trace Event JSON file, to be opened
+         //           in chrome://tracing or Perfetto.  See ATLogTrace.h.
+         //
+         // In:  pFilename - Name of the file to be created.
+         //      bClear - Throw the spans away once they're written, so the next export only has what came after.
+         //
+         // Out:  true if the file was written, false otherwise.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool ExportTrace(const char* pFilename, bool bClear = false)
+         {
+            bool bResult = CATLogTrace::Export(pFilename);
+            if (bResult && bClear)
+               CATLogTrace::Clear();
+            return bResult;
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  GetDroppedCount
+         //
+         // Purpose:  Returns how many messages were thrown away because a sink couldn't keep up (ASYNC only), added up
+         //           over every sink.
+         //
+         // In:  None
+         //
+         // Out:  Number of dropped messages.
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         unsigned long long GetDroppedCount() const;
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  GetStats
+         //
+         // Purpose:  Takes a snapshot of what the Logger has been up to: messages per level, bytes formatted and written,
+         //           drops, the deepest any sink's queue has been and how long logging and formatting take.
+         //
+         // In:  Stats - Receives the numbers.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void GetStats(SATLogStats& Stats) const;
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  SetStatsInterval
+         //
+         // Purpose:  Has the Logger put a summary of GetStats out as an info message every so often.  The summary rides
+         //           along with the first message logged once the interval is up, so a quiet Logger stays quiet.
+         //
+         // In:  unSeconds - Seconds between summaries, 0 turns them off.
+         //
+         // Out:  None
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         void SetStatsInterval(unsigned int unSeconds)
+         {
+            m_ullLastStats.store(CATLogClock::Now(), std::memory_order_relaxed);
+            m_ullStatsInterval.store(unSeconds * 1000000000ull, std::memory_order_relaxed);
+         }
+
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         // Function:  AddSink
+         //
+         // Purpose:  Adds somewhere for messages to go, on top of the Console and file set up by Init.  The sink picks
+         //           up the Logger's time stamp settings and, in ASYNC mode, gets its own thread.  Can be called before
+         //           or after Init.
+         //
+         // In:  pSink - The sink, allocated with new.  The Logger deletes it at Shutdown.
+         //
+         // Out:  true if the sink was added, false if there are already AT_LOG_MAX_SINKS (pSink is deleted).
+         /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+         bool AddSink(CATLogSink* pSink);
+
+         //Number of sinks the Logger has.
+         unsigned int GetSinkCount() const { return m_unSinkCount.load(std::memory_order_acquire); }
    };
 }
 
-#ifndef AT_RELEASE
-#define AT_LOG_INFO(...)   ::Atlas::CATLogger::GetInstance()->info(__VA_ARGS__);
-#define AT_LOG_TRACE(...)  ::Atlas::CATLogger::GetInstance()->trace(__VA_ARGS__);
-#define AT_LOG_WARN(...)   ::Atlas::CATLogger::GetInstance()->warn(__VA_ARGS__);
-#define AT_LOG_ERROR(...)  ::Atlas::CATLogger::GetInstance()->error(__VA_ARGS__);
+//Severity order used by AT_LOG_MIN_LEVEL, least severe first.  This isn't the eLevel order, which is kept as is for
+//anything already storing those values.
+#define AT_LOG_LEVEL_TRACE 0
+#define AT_LOG_LEVEL_INFO 1
+#define AT_LOG_LEVEL_WARN 2
+#define AT_LOG_LEVEL_ERROR 3
+#define AT_LOG_LEVEL_OFF 4
+
+//Least severe messages compiled in, the AT_LOG_* macros below it compile to nothing.  e.g. building with
+//-DAT_LOG_MIN_LEVEL=AT_LOG_LEVEL_WARN strips out every AT_LOG_TRACE and AT_LOG_INFO.  AT_RELEASE strips out everything.
+#ifndef AT_LOG_MIN_LEVEL
+#ifdef AT_RELEASE
+#define AT_LOG_MIN_LEVEL AT_LOG_LEVEL_OFF
+#else
+#define AT_LOG_MIN_LEVEL AT_LOG_LEVEL_TRACE
+#endif
+#endif
+
+//Checks the level before touching the Logger or evaluating any of the message's arguments.
+#define AT_LOG_IF_ENABLED(level, func, ...) \
+   do { if (::Atlas::CATLogger::IsLevelEnabled(::Atlas::CATLogChannels::CHANNEL_GENERAL, ::Atlas::CATLogger::level)) \
+      ::Atlas::CATLogger::GetInstance()->func(__VA_ARGS__); } while (0)
+
+//Same as above on a channel, the channel expression is only evaluated once.
+#define AT_LOG_IF_ENABLED_C(channel, level, func, ...) \
+   do { unsigned int unAtLogChannel = (channel); \
+      if (::Atlas::CATLogger::IsLevelEnabled(unAtLogChannel, ::Atlas::CATLogger::level)) \
+         ::Atlas::CATLogger::GetInstance()->func(unAtLogChannel, __VA_ARGS__); } while (0)
+
+//Same as AT_LOG_IF_ENABLED but only lets the calls check (a CATLogSite method) allows through.  The call site's state
+//is a static inside the block, so every use of a macro gets its own.  Only the channel's level is checked, messages
+//it filters out never use up the site's allowance.
+#define AT_LOG_IF_SAMPLED(level, func, check, ...) \
+   do { if (::Atlas::CATLogChannels::IsEnabled(::Atlas::CATLogChannels::CHANNEL_GENERAL, \
+      ::Atlas::CATLogger::LevelBit(::Atlas::CATLogger::level))) { \
+      static ::Atlas::CATLogSite atLogSite; \
+      if (atLogSite.check) ::Atlas::CATLogger::GetInstance()->func(__VA_ARGS__); } } while (0)
+
+//Same as above on a channel, the channel expression is only evaluated once.
+#define AT_LOG_IF_SAMPLED_C(channel, level, func, check, ...) \
+   do { unsigned int unAtLogChannel = (channel); \
+      if (unAtLogChannel < AT_LOG_MAX_CHANNELS && ::Atlas::CATLogChannels::IsEnabled(unAtLogChannel, \
+      ::Atlas::CATLogger::LevelBit(::Atlas::CATLogger::level))) { \
+      static ::Atlas::CATLogSite atLogSite; \
+      if (atLogSite.check) ::Atlas::CATLogger::GetInstance()->func(unAtLogChannel, __VA_ARGS__); } } while (0)
+
+//What a compiled out message turns into, still a statement so it's safe in an if without braces.
+#define AT_LOG_DISABLED do { } while (0)
+
+#if AT_LOG_MIN_LEVEL <= AT_LOG_LEVEL_TRACE
+#define AT_LOG_TRACE(...)  AT_LOG_IF_ENABLED(TRACE, trace, __VA_ARGS__)
+#define AT_LOG_TRACE_C(channel, ...)  AT_LOG_IF_ENABLED_C(channel, TRACE, trace, __VA_ARGS__)
+#define AT_LOG_TRACE_EVERY_N(n, ...)  AT_LOG_IF_SAMPLED(TRACE, trace, EveryN(n), __VA_ARGS__)
+#define AT_LOG_TRACE_RATE(perSecond, ...)  AT_LOG_IF_SAMPLED(TRACE, trace, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_TRACE_ONCE(...)  AT_LOG_IF_SAMPLED(TRACE, trace, Once(), __VA_ARGS__)
+#define AT_LOG_TRACE_EVERY_N_C(channel, n, ...)  AT_LOG_IF_SAMPLED_C(channel, TRACE, trace, EveryN(n), __VA_ARGS__)
+#define AT_LOG_TRACE_RATE_C(channel, perSecond, ...)  AT_LOG_IF_SAMPLED_C(channel, TRACE, trace, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_TRACE_ONCE_C(channel, ...)  AT_LOG_IF_SAMPLED_C(channel, TRACE, trace, Once(), __VA_ARGS__)
 #else
-#define AT_LOG_INFO(...)
-#define AT_LOG_TRACE(...)
-#define AT_LOG_WARN(...)
-#define AT_LOG_ERROR(...)
+#define AT_LOG_TRACE(...)  AT_LOG_DISABLED
+#define AT_LOG_TRACE_C(channel, ...)  AT_LOG_DISABLED
+#define AT_LOG_TRACE_EVERY_N(n, ...)  AT_LOG_DISABLED
+#define AT_LOG_TRACE_RATE(perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_TRACE_ONCE(...)  AT_LOG_DISABLED
+#define AT_LOG_TRACE_EVERY_N_C(channel, n, ...)  AT_LOG_DISABLED
+#define AT_LOG_TRACE_RATE_C(channel, perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_TRACE_ONCE_C(channel, ...)  AT_LOG_DISABLED
 #endif
 
+#if AT_LOG_MIN_LEVEL <= AT_LOG_LEVEL_INFO
+#define AT_LOG_INFO(...)   AT_LOG_IF_ENABLED(INFO, info, __VA_ARGS__)
+#define AT_LOG_INFO_C(channel, ...)   AT_LOG_IF_ENABLED_C(channel, INFO, info, __VA_ARGS__)
+#define AT_LOG_INFO_EVERY_N(n, ...)  AT_LOG_IF_SAMPLED(INFO, info, EveryN(n), __VA_ARGS__)
+#define AT_LOG_INFO_RATE(perSecond, ...)  AT_LOG_IF_SAMPLED(INFO, info, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_INFO_ONCE(...)  AT_LOG_IF_SAMPLED(INFO, info, Once(), __VA_ARGS__)
+#define AT_LOG_INFO_EVERY_N_C(channel, n, ...)  AT_LOG_IF_SAMPLED_C(channel, INFO, info, EveryN(n), __VA_ARGS__)
+#define AT_LOG_INFO_RATE_C(channel, perSecond, ...)  AT_LOG_IF_SAMPLED_C(channel, INFO, info, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_INFO_ONCE_C(channel, ...)  AT_LOG_IF_SAMPLED_C(channel, INFO, info, Once(), __VA_ARGS__)
+#else
+#define AT_LOG_INFO(...)  AT_LOG_DISABLED
+#define AT_LOG_INFO_C(channel, ...)  AT_LOG_DISABLED
+#define AT_LOG_INFO_EVERY_N(n, ...)  AT_LOG_DISABLED
+#define AT_LOG_INFO_RATE(perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_INFO_ONCE(...)  AT_LOG_DISABLED
+#define AT_LOG_INFO_EVERY_N_C(channel, n, ...)  AT_LOG_DISABLED
+#define AT_LOG_INFO_RATE_C(channel, perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_INFO_ONCE_C(channel, ...)  AT_LOG_DISABLED
+#endif
+
+#if AT_LOG_MIN_LEVEL <= AT_LOG_LEVEL_WARN
+#define AT_LOG_WARN(...)   AT_LOG_IF_ENABLED(WARN, warn, __VA_ARGS__)
+#define AT_LOG_WARN_C(channel, ...)   AT_LOG_IF_ENABLED_C(channel, WARN, warn, __VA_ARGS__)
+#define AT_LOG_WARN_EVERY_N(n, ...)  AT_LOG_IF_SAMPLED(WARN, warn, EveryN(n), __VA_ARGS__)
+#define AT_LOG_WARN_RATE(perSecond, ...)  AT_LOG_IF_SAMPLED(WARN, warn, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_WARN_ONCE(...)  AT_LOG_IF_SAMPLED(WARN, warn, Once(), __VA_ARGS__)
+#define AT_LOG_WARN_EVERY_N_C(channel, n, ...)  AT_LOG_IF_SAMPLED_C(channel, WARN, warn, EveryN(n), __VA_ARGS__)
+#define AT_LOG_WARN_RATE_C(channel, perSecond, ...)  AT_LOG_IF_SAMPLED_C(channel, WARN, warn, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_WARN_ONCE_C(channel, ...)  AT_LOG_IF_SAMPLED_C(channel, WARN, warn, Once(), __VA_ARGS__)
+#else
+#define AT_LOG_WARN(...)  AT_LOG_DISABLED
+#define AT_LOG_WARN_C(channel, ...)  AT_LOG_DISABLED
+#define AT_LOG_WARN_EVERY_N(n, ...)  AT_LOG_DISABLED
+#define AT_LOG_WARN_RATE(perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_WARN_ONCE(...)  AT_LOG_DISABLED
+#define AT_LOG_WARN_EVERY_N_C(channel, n, ...)  AT_LOG_DISABLED
+#define AT_LOG_WARN_RATE_C(channel, perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_WARN_ONCE_C(channel, ...)  AT_LOG_DISABLED
+#endif
+
+#if AT_LOG_MIN_LEVEL <= AT_LOG_LEVEL_ERROR
+#define AT_LOG_ERROR(...)  AT_LOG_IF_ENABLED(ERR, error, __VA_ARGS__)
+#define AT_LOG_ERROR_C(channel, ...)  AT_LOG_IF_ENABLED_C(channel, ERR, error, __VA_ARGS__)
+#define AT_LOG_ERROR_EVERY_N(n, ...)  AT_LOG_IF_SAMPLED(ERR, error, EveryN(n), __VA_ARGS__)
+#define AT_LOG_ERROR_RATE(perSecond, ...)  AT_LOG_IF_SAMPLED(ERR, error, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_ERROR_ONCE(...)  AT_LOG_IF_SAMPLED(ERR, error, Once(), __VA_ARGS__)
+#define AT_LOG_ERROR_EVERY_N_C(channel, n, ...)  AT_LOG_IF_SAMPLED_C(channel, ERR, error, EveryN(n), __VA_ARGS__)
+#define AT_LOG_ERROR_RATE_C(channel, perSecond, ...)  AT_LOG_IF_SAMPLED_C(channel, ERR, error, Rate(perSecond), __VA_ARGS__)
+#define AT_LOG_ERROR_ONCE_C(channel, ...)  AT_LOG_IF_SAMPLED_C(channel, ERR, error, Once(), __VA_ARGS__)
+#else
+#define AT_LOG_ERROR(...)  AT_LOG_DISABLED
+#define AT_LOG_ERROR_C(channel, ...)  AT_LOG_DISABLED
+#define AT_LOG_ERROR_EVERY_N(n, ...)  AT_LOG_DISABLED
+#define AT_LOG_ERROR_RATE(perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_ERROR_ONCE(...)  AT_LOG_DISABLED
+#define AT_LOG_ERROR_EVERY_N_C(channel, n, ...)  AT_LOG_DISABLED
+#define AT_LOG_ERROR_RATE_C(channel, perSecond, ...)  AT_LOG_DISABLED
+#define AT_LOG_ERROR_ONCE_C(channel, ...)  AT_LOG_DISABLED
+#endif
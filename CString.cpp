@@ -6,6 +6,7 @@
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #include "CString.h"
 #include <string>
+#include <cstring>
 
 //Constructor
 CString::CString()
@@ -0,0 +1,358 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogBench.cpp
+//
+// Purpose: Benchmarks the Logger.  Drives info/warn/error through each output setup (filtered out, Console, text and
+//          binary files, sync and ASYNC, time stamps on and off) with a few different argument mixes, across 1..N
+//          producer threads, and reports calls per second, end to end messages per second, p50/p99/p999 call
+//          latency and how many heap allocations the calls made once each thread was warmed up (should be 0).
+//          The Console goes to /dev/null (NUL on Windows) so the numbers don't depend on the terminal, results are
+//          printed to stderr.
+//
+//          Usage:  ATLogBench [-n messages] [-t threads] [-c config] [-a args]
+//                  -n  Messages logged by each thread per run (default 100000).
+//                  -t  Most producer threads, runs go 1, 2, 4, ... up to this (default: number of cores).
+//                  -c  Only run setups whose name contains this, e.g. "file".
+//                  -a  Only run argument mixes whose name contains this, e.g. "ints".
+//
+//          Built by the root CMakeLists.txt, or by hand with every .cpp in the root folder, optimizations on, e.g.
+//             g++ -std=c++20 -O2 -I.. ATLogBench.cpp ../*.cpp -pthread -o ATLogBench
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "../ATLogger.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+using namespace Atlas;
+
+#ifdef _WIN32
+#define AT_BENCH_NULL "NUL"
+#else
+#define AT_BENCH_NULL "/dev/null"
+#endif
+
+//File written by the file setups, deleted when we're done.
+#define AT_BENCH_FILE "ATLogBench.log"
+
+//Heap allocations made by the calling thread, counted by the operator new replacements below.
+static thread_local unsigned long long s_ullAllocations = 0;
+
+//Every allocation in the program goes through these, so the bench can see any the Logger makes.
+void* operator new(std::size_t unSize)
+{
+   s_ullAllocations++;
+   void* pMemory = malloc(unSize ? unSize : 1);
+   if (!pMemory)
+      throw std::bad_alloc();
+   return pMemory;
+}
+
+void* operator new[](std::size_t unSize)
+{
+   return operator new(unSize);
+}
+
+void* operator new(std::size_t unSize, std::align_val_t Align)
+{
+   s_ullAllocations++;
+   size_t unAlign = static_cast<size_t>(Align);
+#ifdef _WIN32
+   void* pMemory = _aligned_malloc(unSize ? unSize : 1, unAlign);
+#else
+   void* pMemory = aligned_alloc(unAlign, (unSize + unAlign - 1) / unAlign * unAlign + (unSize ? 0 : unAlign));
+#endif
+   if (!pMemory)
+      throw std::bad_alloc();
+   return pMemory;
+}
+
+void* operator new[](std::size_t unSize, std::align_val_t Align)
+{
+   return operator new(unSize, Align);
+}
+
+void operator delete(void* pMemory) noexcept { free(pMemory); }
+void operator delete[](void* pMemory) noexcept { free(pMemory); }
+void operator delete(void* pMemory, std::size_t) noexcept { free(pMemory); }
+void operator delete[](void* pMemory, std::size_t) noexcept { free(pMemory); }
+
+#ifdef _WIN32
+void operator delete(void* pMemory, std::align_val_t) noexcept { _aligned_free(pMemory); }
+void operator delete[](void* pMemory, std::align_val_t) noexcept { _aligned_free(pMemory); }
+void operator delete(void* pMemory, std::size_t, std::align_val_t) noexcept { _aligned_free(pMemory); }
+void operator delete[](void* pMemory, std::size_t, std::align_val_t) noexcept { _aligned_free(pMemory); }
+#else
+void operator delete(void* pMemory, std::align_val_t) noexcept { free(pMemory); }
+void operator delete[](void* pMemory, std::align_val_t) noexcept { free(pMemory); }
+void operator delete(void* pMemory, std::size_t, std::align_val_t) noexcept { free(pMemory); }
+void operator delete[](void* pMemory, std::size_t, std::align_val_t) noexcept { free(pMemory); }
+#endif
+
+//Logs a single message, i is the message's number within its thread.
+typedef void (*BenchCall)(unsigned int unThread, unsigned int i);
+
+//A string long enough to matter, logged by the "string" argument mix.
+static const char* s_pLongString = "The quick brown fox jumps over the lazy dog while the logger tries to keep up with it all";
+
+//No arguments at all, just the format.
+static void CallStatic(unsigned int /*unThread*/, unsigned int /*i*/)
+{
+   AT_LOG_INFO("Static message with no arguments");
+}
+
+//A few integers.
+static void CallInts(unsigned int unThread, unsigned int i)
+{
+   AT_LOG_INFO("Ints {i} {u} {i}", unThread, i, static_cast<int>(i) * -7);
+}
+
+//One of everything, spread over info, warn and error.
+static void CallMixed(unsigned int /*unThread*/, unsigned int i)
+{
+   switch (i % 3)
+   {
+      case 0:  AT_LOG_INFO("Mixed {i} {f} {s} {b}", i, i * 0.25, "text", (i & 1) != 0); break;
+      case 1:  AT_LOG_WARN("Mixed {i} {f} {s} {b}", i, i * 0.25, "text", (i & 1) != 0); break;
+      default: AT_LOG_ERROR("Mixed {i} {f} {s} {b}", i, i * 0.25, "text", (i & 1) != 0); break;
+   }
+}
+
+//A long string argument.
+static void CallString(unsigned int /*unThread*/, unsigned int i)
+{
+   AT_LOG_INFO("String {s} {u}", s_pLongString, i);
+}
+
+//An argument mix to run every setup with.
+struct SBenchArgs
+{
+   const char*    m_pName;
+   BenchCall      m_pfnCall;
+};
+
+static const SBenchArgs s_aArgs[] =
+{
+   {"static", CallStatic},
+   {"ints", CallInts},
+   {"mixed", CallMixed},
+   {"string", CallString},
+};
+
+//Where messages go for a run.
+enum eOutput {OUTPUT_NONE = 0, OUTPUT_CONSOLE, OUTPUT_FILE};
+
+//One output setup.
+struct SBenchConfig
+{
+   const char*                m_pName;
+   CATLogger::eLevel          m_Level;  //Logger level, ERR filters out the info calls.
+   unsigned char              m_ucFlags;  //CATLogger::eFlags, LOGFILE is added for file output.
+   eOutput                    m_Output;
+   bool                       m_bFlightRecorder;  //Turn the flight recorder on for every level, filtered messages included?
+};
+
+static const SBenchConfig s_aConfigs[] =
+{
+   {"filtered",               CATLogger::ERR, 0,                                                          OUTPUT_NONE,    false},
+   {"filtered+recorder",      CATLogger::ERR, 0,                                                          OUTPUT_NONE,    true},
+   {"console sync",           CATLogger::ALL, 0,                                                          OUTPUT_CONSOLE, true},
+   {"console async",          CATLogger::ALL, CATLogger::ASYNC,                                           OUTPUT_CONSOLE, true},
+   {"file sync",              CATLogger::ALL, 0,                                                          OUTPUT_FILE,    true},
+   {"file sync ts",           CATLogger::ALL, CATLogger::TIMESTAMP,                                       OUTPUT_FILE,    true},
+   {"file async",             CATLogger::ALL, CATLogger::ASYNC,                                           OUTPUT_FILE,    true},
+   {"file async ts",          CATLogger::ALL, CATLogger::ASYNC | CATLogger::TIMESTAMP,                    OUTPUT_FILE,    true},
+   {"file binary async",      CATLogger::ALL, CATLogger::ASYNC | CATLogger::BINARY,                       OUTPUT_FILE,    true},
+   {"file binary async ts",   CATLogger::ALL, CATLogger::ASYNC | CATLogger::BINARY | CATLogger::TIMESTAMP, OUTPUT_FILE,    true},
+   {"file indexed async",     CATLogger::ALL, CATLogger::ASYNC | CATLogger::INDEXED,                      OUTPUT_FILE,    true},
+};
+
+//What one run measured.
+struct SBenchResult
+{
+   double               m_dCallsPerSecond;  //Calls made per second by all threads put together.
+   double               m_dMessagesPerSecond;  //Same, but counting the time to Flush everything out.
+   unsigned long long   m_ullP50;  //Call latency percentiles, nanoseconds.
+   unsigned long long   m_ullP99;
+   unsigned long long   m_ullP999;
+   unsigned long long   m_ullDropped;  //Messages the sinks dropped.
+   unsigned long long   m_ullAllocations;  //Heap allocations made by the calls after each thread's first.
+};
+
+//Logs unMessages messages, keeping how long each call took in CATLogClock ticks.  The first call sets the thread up
+//with the Logger (its stage, line buffers, ...), pAllocations gets the allocations made by the rest.
+static void BenchThread(BenchCall pfnCall, unsigned int unThread, unsigned int unMessages, std::atomic<unsigned int>* pReady,
+   std::atomic<bool>* pGo, unsigned int* pTicks, unsigned long long* pAllocations)
+{
+   //Wait for everyone so all the threads start hammering at once.
+   pReady->fetch_add(1, std::memory_order_acq_rel);
+   while (!pGo->load(std::memory_order_acquire))
+      std::this_thread::yield();
+
+   unsigned long long ullAllocations = 0;
+   for (unsigned int i = 0; i < unMessages; i++)
+   {
+      if (i == 1)
+         ullAllocations = s_ullAllocations;
+      unsigned long long ullStart = CATLogClock::Now();
+      pfnCall(unThread, i);
+      unsigned long long ullTicks = CATLogClock::Now() - ullStart;
+      pTicks[i] = (ullTicks < 0xFFFFFFFF) ? static_cast<unsigned int>(ullTicks) : 0xFFFFFFFF;
+   }
+   *pAllocations = (unMessages > 1) ? s_ullAllocations - ullAllocations : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Function:  RunBench
+//
+// Purpose:  Sets the Logger up for a config, has unThreads threads each log unMessages messages with pfnCall and
+//           shuts the Logger back down.
+//
+// In:  Config - The output setup.
+//      pfnCall - Logs one message.
+//      unThreads - Number of producer threads.
+//      unMessages - Messages logged by each thread.
+//      Result - Receives what was measured.
+//
+// Out:  true if the Logger could be set up.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool RunBench(const SBenchConfig& Config, BenchCall pfnCall, unsigned int unThreads, unsigned int unMessages, SBenchResult& Result)
+{
+   CATLogger* pLogger = CATLogger::GetInstance();
+   pLogger->SetCollapseRepeats(false);  //We want to measure logging, not counting repeats.
+   pLogger->SetFlightRecorderLevel(Config.m_bFlightRecorder ? CATLogger::ALL : Config.m_Level);
+
+   unsigned char ucFlags = Config.m_ucFlags;
+   if (Config.m_Output == OUTPUT_CONSOLE)
+      pLogger->AddSink(new CATConsoleSink());
+   else if (Config.m_Output == OUTPUT_FILE)
+      ucFlags |= CATLogger::LOGFILE;
+
+   if (!pLogger->Init(Config.m_Level, ucFlags, AT_BENCH_FILE))
+   {
+      pLogger->Shutdown();
+      return false;
+   }
+   unsigned long long ullDropped = pLogger->GetDroppedCount();
+
+   std::vector<unsigned int> vTicks(static_cast<size_t>(unThreads) * unMessages);
+   std::vector<unsigned long long> vAllocations(unThreads);
+   std::vector<std::thread> vThreads;
+   std::atomic<unsigned int> unReady(0);
+   std::atomic<bool> bGo(false);
+   for (unsigned int t = 0; t < unThreads; t++)
+      vThreads.emplace_back(BenchThread, pfnCall, t, unMessages, &unReady, &bGo, vTicks.data() + static_cast<size_t>(t) * unMessages,
+         &vAllocations[t]);
+
+   while (unReady.load(std::memory_order_acquire) < unThreads)
+      std::this_thread::yield();
+
+   std::chrono::steady_clock::time_point tpStart = std::chrono::steady_clock::now();
+   bGo.store(true, std::memory_order_release);
+   for (std::thread& tThread : vThreads)
+      tThread.join();
+   std::chrono::steady_clock::time_point tpCalls = std::chrono::steady_clock::now();
+   pLogger->Flush();
+   std::chrono::steady_clock::time_point tpFlushed = std::chrono::steady_clock::now();
+
+   Result.m_ullDropped = pLogger->GetDroppedCount() - ullDropped;
+   pLogger->Shutdown();
+
+   Result.m_ullAllocations = 0;
+   for (unsigned long long ullAllocations : vAllocations)
+      Result.m_ullAllocations += ullAllocations;
+
+   double dMessages = static_cast<double>(unThreads) * unMessages;
+   Result.m_dCallsPerSecond = dMessages / std::chrono::duration<double>(tpCalls - tpStart).count();
+   Result.m_dMessagesPerSecond = dMessages / std::chrono::duration<double>(tpFlushed - tpStart).count();
+
+   //Only the percentiles we print need to be in place, nth_element is plenty.
+   size_t aunRanks[] = {vTicks.size() / 2, vTicks.size() * 99 / 100, vTicks.size() * 999 / 1000};
+   unsigned long long* apullOut[] = {&Result.m_ullP50, &Result.m_ullP99, &Result.m_ullP999};
+   for (unsigned int i = 0; i < 3; i++)
+   {
+      std::nth_element(vTicks.begin(), vTicks.begin() + aunRanks[i], vTicks.end());
+      *apullOut[i] = CATLogClock::ElapsedNanoseconds(vTicks[aunRanks[i]]);
+   }
+   return true;
+}
+
+int main(int argc, char** argv)
+{
+   unsigned int unMessages = 100000;  //Messages per thread per run.
+   unsigned int unMaxThreads = std::thread::hardware_concurrency();  //Most producer threads.
+   const char* pConfig = 0;  //Only run setups with this in their name.
+   const char* pArgs = 0;  //Only run argument mixes with this in their name.
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         unMessages = static_cast<unsigned int>(strtoul(argv[++i], 0, 10));
+      else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+         unMaxThreads = static_cast<unsigned int>(strtoul(argv[++i], 0, 10));
+      else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+         pConfig = argv[++i];
+      else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+         pArgs = argv[++i];
+      else
+      {
+         fprintf(stderr, "Usage: ATLogBench [-n messages] [-t threads] [-c config] [-a args]\n");
+         return 1;
+      }
+   }
+
+   if (unMessages == 0)
+      unMessages = 1;
+   if (unMaxThreads == 0)
+      unMaxThreads = 1;
+
+   //Console output goes nowhere, so the terminal doesn't end up being what we measure.
+   if (!freopen(AT_BENCH_NULL, "w", stdout))
+   {
+      fprintf(stderr, "Couldn't send the Console to %s\n", AT_BENCH_NULL);
+      return 1;
+   }
+
+   CATLogClock::Calibrate();
+   fprintf(stderr, "%-22s %-8s %7s %14s %14s %9s %9s %9s %10s %8s\n", "setup", "args", "threads", "calls/s", "msgs/s",
+      "p50 ns", "p99 ns", "p999 ns", "dropped", "allocs");
+
+   for (const SBenchConfig& Config : s_aConfigs)
+   {
+      if (pConfig && !strstr(Config.m_pName, pConfig))
+         continue;
+
+      for (const SBenchArgs& Args : s_aArgs)
+      {
+         if (pArgs && !strstr(Args.m_pName, pArgs))
+            continue;
+
+         //1, 2, 4, ... threads, finishing on unMaxThreads even if it isn't a power of two.
+         for (unsigned int unThreads = 1; ; unThreads *= 2)
+         {
+            if (unThreads > unMaxThreads)
+               unThreads = unMaxThreads;
+
+            SBenchResult Result;
+            if (!RunBench(Config, Args.m_pfnCall, unThreads, unMessages, Result))
+            {
+               fprintf(stderr, "%-22s couldn't set up the Logger\n", Config.m_pName);
+               break;
+            }
+
+            fprintf(stderr, "%-22s %-8s %7u %14.0f %14.0f %9llu %9llu %9llu %10llu %8llu\n", Config.m_pName, Args.m_pName, unThreads,
+               Result.m_dCallsPerSecond, Result.m_dMessagesPerSecond, Result.m_ullP50, Result.m_ullP99, Result.m_ullP999, Result.m_ullDropped,
+               Result.m_ullAllocations);
+
+            if (unThreads == unMaxThreads)
+               break;
+         }
+      }
+   }
+
+   CATLogger::DeleteInstance();
+   remove(AT_BENCH_FILE);
+   return 0;
+}
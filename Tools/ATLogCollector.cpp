@@ -0,0 +1,606 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogCollector.cpp
+//
+// Purpose: Local Log collector.  Listens on a Unix domain socket for any number of processes logging through a
+//          CATSocketSink and merges their records into one time ordered Log, written through a CATRollingFileSink so it
+//          rolls over and gets compressed like any other.  Every message is put under its process's name, e.g.
+//          "[server] Player joined".
+//
+//          Records are held back for up to the merge window so a process whose block arrives late still lands in
+//          order.  Anything older than every connected process's latest record (or older than the window) is
+//          written, so the Log trails the slowest process by at most the window.
+//
+//          Usage:  ATLogCollector [-s socket] [-o log] [-r MB] [-a seconds] [-k keep] [-b | -x | -j] [-t] [-d digits]
+//                                 [-w milliseconds] [-v]
+//                  -s  Socket to listen on (default AT_LOG_SOCKET_PATH).
+//                  -o  Log to write (default "collected.log").
+//                  -r  Roll over once the Log gets this many megabytes (default 64, 0 for never).
+//                  -a  Roll over once the Log is this many seconds old (default 0, never).
+//                  -k  Number of rolled over Logs to keep (default AT_LOG_ROLL_KEEP).
+//                  -b  Write BINARY, -x INDEXED binary, -j JSON Lines (default text).
+//                  -t  Start every line with its time stamp, -d sets the digits after the seconds.
+//                  -w  Merge window (default AT_COLLECT_WINDOW).
+//                  -v  Say who connects and disconnects and how many records were merged on stderr.
+//                  Stop it with SIGINT or SIGTERM, everything still held back is written out first.  Unix only.
+//
+//          Build with ATLogFormat.cpp, ATLogBinary.cpp, ATLogJson.cpp, ATLogChannel.cpp, ATLogClock.cpp, ATLogSink.cpp,
+//          ATLogFileSink.cpp, ATLogRollingFileSink.cpp, ATLogStats.cpp, ATFileWriter.cpp and CString.cpp.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "../ATLogRollingFileSink.h"
+#include "../ATLogSocketSink.h"
+#include "../ATLogJson.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+//Default merge window, how long records wait on the other processes before being written (in milliseconds).
+//Should be longer than AT_LOG_BLOCK_INTERVAL, the longest a sink holds a block back.
+#define AT_COLLECT_WINDOW 2000
+
+//Most records held back at once, the oldest are written early past this.
+#define AT_COLLECT_MAX_PENDING 65536
+
+//Biggest block a process can send, anything bigger means the stream is corrupt.
+#define AT_COLLECT_MAX_BLOCK (16 * 1024 * 1024)
+
+//Bytes read from a process at a time.
+#define AT_COLLECT_READ_SIZE 65536
+
+using namespace Atlas;
+
+#ifdef _WIN32
+int main()
+{
+   fprintf(stderr, "ATLogCollector: Needs Unix domain sockets\n");
+   return 1;
+}
+#else
+
+//Our copy of one of a process's formats.
+struct SLocalFormat
+{
+   const char*    m_pFormat = 0;  //"[source] format", 0 until it's been looked up.
+   unsigned int   m_unId = CATFormatRegistry::PREFORMATTED_ID;  //Our id for it, PREFORMATTED_ID if the registry is full.
+};
+
+//A process sending us records.
+struct SClient
+{
+   int                        m_nSocket = -1;  //The connection.
+   std::vector<char>          m_vBuffer;  //Bytes read but not parsed yet.
+   size_t                     m_unStart = 0;  //Where the unparsed bytes start in m_vBuffer.
+   bool                       m_bHeader = false;  //Has the stream header been read?
+   std::string                m_sSource;  //Name the process goes by, "unknown" until it says.
+   std::vector<std::string>   m_vFormats;  //The process's formats, indexed by its ids.
+   std::vector<SLocalFormat>  m_vLocal;  //Our copy of each of them.
+   std::vector<unsigned int>  m_vChannels;  //Our channel for each of the process's channels.
+   unsigned long long         m_ullLatest = 0;  //Latest time stamp received, 0 (hold everything back) until the first record.
+};
+
+//A record held back for the merge, ordered by time stamp then arrival.
+struct SPending
+{
+   unsigned long long   m_ullTimestamp;
+   unsigned long long   m_ullSequence;
+   SATLogRecord*        m_pRecord;
+
+   bool operator>(const SPending& Other) const
+   {
+      return (m_ullTimestamp != Other.m_ullTimestamp) ? m_ullTimestamp > Other.m_ullTimestamp : m_ullSequence > Other.m_ullSequence;
+   }
+};
+
+//Everything the collector keeps track of.
+struct SCollector
+{
+   CATRollingFileSink*     m_pSink = 0;  //Where the merged records go.
+   std::vector<SClient*>   m_vClients;
+   std::priority_queue<SPending, std::vector<SPending>, std::greater<SPending>> m_pqPending;  //Held back records, oldest on top.
+   std::vector<SATLogRecord*> m_vFree;  //Records ready to be reused.
+   std::unordered_map<std::string, const char*> m_umFormats;  //"[source] format" strings, kept for the life of the program.
+   unsigned long long      m_ullSequence = 0;  //Arrival order of the next record.
+   unsigned long long      m_ullWritten = 0;  //Records written so far.
+   unsigned long long      m_ullLate = 0;  //Records that arrived after a later one had already been written.
+   unsigned long long      m_ullLastWritten = 0;  //Time stamp of the last record written.
+   unsigned long long      m_ullWindow = AT_COLLECT_WINDOW * 1000000ULL;  //Merge window in nanoseconds.
+   bool                    m_bVerbose = false;
+};
+
+static volatile sig_atomic_t s_bStop = 0;  //Set by SIGINT and SIGTERM.
+
+//Asks the main loop to wrap up.
+static void OnStopSignal(int)
+{
+   s_bStop = 1;
+}
+
+//Nanoseconds since the epoch right now.
+static unsigned long long WallNow()
+{
+   return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+//Our id for a process's format, "[source] " stuck on the front so the merged Log says where each message came from.
+//pFormat receives our copy of the format.
+static unsigned int LocalFormatId(SCollector& Collector, SClient& Client, unsigned int unId, const char*& pFormat)
+{
+   if (unId >= AT_LOG_MAX_FORMATS)
+      unId = CATFormatRegistry::PREFORMATTED_ID;
+   if (unId >= Client.m_vFormats.size())
+      Client.m_vFormats.resize(unId + 1, "{s}");
+   if (unId >= Client.m_vLocal.size())
+      Client.m_vLocal.resize(unId + 1);
+
+   SLocalFormat& Local = Client.m_vLocal[unId];
+   if (!Local.m_pFormat)
+   {
+      std::string sFormat = "[" + Client.m_sSource + "] " + Client.m_vFormats[unId];
+      auto itFormat = Collector.m_umFormats.find(sFormat);
+      if (itFormat == Collector.m_umFormats.end())
+      {
+         char* pCopy = new char[sFormat.size() + 1];
+         memcpy(pCopy, sFormat.c_str(), sFormat.size() + 1);
+         itFormat = Collector.m_umFormats.emplace(sFormat, pCopy).first;
+      }
+      Local.m_pFormat = itFormat->second;
+      Local.m_unId = CATFormatRegistry::Register(Local.m_pFormat);
+   }
+
+   pFormat = Local.m_pFormat;
+   return Local.m_unId;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Function:  AddRecord
+//
+// Purpose:  Turns a record from a process into one of ours and holds it back for the merge.  The arguments are
+//           kept as they were encoded, only the format and channel ids change.  If our format registry is full the
+//           message is formatted right here instead, the same as the Logger would.
+//
+// In:  Collector - The collector.
+//      Client - The process the record came from.
+//      pEntry - The record entry, header and data.
+//
+// Out:  None
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void AddRecord(SCollector& Collector, SClient& Client, const char* pEntry)
+{
+   SATLogRecord* pRecord = 0;
+   if (!Collector.m_vFree.empty())
+   {
+      pRecord = Collector.m_vFree.back();
+      Collector.m_vFree.pop_back();
+   }
+   else
+      pRecord = new SATLogRecord();
+
+   CATLogBinary::ReadRecordHeader(pEntry, *pRecord);
+   memcpy(pRecord->m_cData, pEntry + CATLogBinary::RECORD_HEADER_SIZE, pRecord->m_usLength);
+   pRecord->m_ucChannel = static_cast<unsigned char>((pRecord->m_ucChannel < Client.m_vChannels.size()) ?
+      Client.m_vChannels[pRecord->m_ucChannel] : static_cast<unsigned int>(CATLogChannels::CHANNEL_GENERAL));
+
+   const char* pFormat = 0;
+   unsigned int unId = LocalFormatId(Collector, Client, pRecord->m_unFormatId, pFormat);
+   if (unId != CATFormatRegistry::PREFORMATTED_ID)
+      pRecord->m_unFormatId = unId;
+   else
+   {
+      SATFormatArg aArgs[AT_LOG_MAX_ARGS];
+      SATLogRecord Remote = *pRecord;
+      unsigned int unArgCount = CATLogBinary::DecodeArgs(Remote.m_cData, Remote.m_usLength, aArgs, AT_LOG_MAX_ARGS);
+      CATLogBinary::FillRecord(*pRecord, Remote.m_ucLevel, Remote.m_ucChannel, Remote.m_ullTimestamp, pFormat, false, aArgs, unArgCount);
+   }
+
+   if (pRecord->m_ullTimestamp > Client.m_ullLatest)
+      Client.m_ullLatest = pRecord->m_ullTimestamp;
+   Collector.m_pqPending.push(SPending{pRecord->m_ullTimestamp, Collector.m_ullSequence++, pRecord});
+}
+
+//Reads a single format, channel, source or record entry.  Returns its size, 0 if it isn't all there yet, or -1 if
+//it's corrupt.
+static long long ParseEntry(SCollector& Collector, SClient& Client, const char* pData, size_t unRoom)
+{
+   switch (pData[0])
+   {
+      case CATLogBinary::ENTRY_SOURCE:
+      {
+         if (unRoom < CATLogBinary::SOURCE_HEADER_SIZE || unRoom < static_cast<size_t>(CATLogBinary::SOURCE_HEADER_SIZE) + static_cast<unsigned char>(pData[1]))
+            return 0;
+         size_t unEntry = CATLogBinary::SOURCE_HEADER_SIZE + static_cast<unsigned char>(pData[1]);
+         Client.m_sSource.assign(pData + CATLogBinary::SOURCE_HEADER_SIZE, unEntry - CATLogBinary::SOURCE_HEADER_SIZE);
+         if (Collector.m_bVerbose)
+            fprintf(stderr, "ATLogCollector: %s connected\n", Client.m_sSource.c_str());
+         return static_cast<long long>(unEntry);
+      }
+      case CATLogBinary::ENTRY_FORMAT:
+      {
+         unsigned int unId = 0;
+         unsigned short usLength = 0;
+         if (unRoom < CATLogBinary::FORMAT_HEADER_SIZE)
+            return 0;
+         memcpy(&unId, pData + 1, 4);
+         memcpy(&usLength, pData + 5, 2);
+         if (unId >= AT_LOG_MAX_FORMATS)
+            return -1;
+         if (unRoom < CATLogBinary::FORMAT_HEADER_SIZE + static_cast<size_t>(usLength))
+            return 0;
+
+         //Formats don't change, but a new definition is taken at its word.
+         if (unId >= Client.m_vFormats.size())
+            Client.m_vFormats.resize(unId + 1, "{s}");
+         if (Client.m_vFormats[unId].compare(0, std::string::npos, pData + CATLogBinary::FORMAT_HEADER_SIZE, usLength) != 0)
+         {
+            Client.m_vFormats[unId].assign(pData + CATLogBinary::FORMAT_HEADER_SIZE, usLength);
+            if (unId < Client.m_vLocal.size())
+               Client.m_vLocal[unId] = SLocalFormat();
+         }
+         return CATLogBinary::FORMAT_HEADER_SIZE + usLength;
+      }
+      case CATLogBinary::ENTRY_CHANNEL:
+      {
+         if (unRoom < CATLogBinary::CHANNEL_HEADER_SIZE || unRoom < static_cast<size_t>(CATLogBinary::CHANNEL_HEADER_SIZE) + static_cast<unsigned char>(pData[2]))
+            return 0;
+         size_t unEntry = CATLogBinary::CHANNEL_HEADER_SIZE + static_cast<unsigned char>(pData[2]);
+
+         //Channels are matched up by name, ones we run out of room for end up on the general channel.
+         unsigned char ucId = static_cast<unsigned char>(pData[1]);
+         std::string sName(pData + CATLogBinary::CHANNEL_HEADER_SIZE, unEntry - CATLogBinary::CHANNEL_HEADER_SIZE);
+         unsigned int unChannel = CATLogChannels::Register(sName.c_str(), 0x0F);
+         if (ucId >= Client.m_vChannels.size())
+            Client.m_vChannels.resize(ucId + 1, CATLogChannels::CHANNEL_GENERAL);
+         Client.m_vChannels[ucId] = (unChannel == CATLogChannels::INVALID_CHANNEL) ? static_cast<unsigned int>(CATLogChannels::CHANNEL_GENERAL) : unChannel;
+         return static_cast<long long>(unEntry);
+      }
+      case CATLogBinary::ENTRY_RECORD:
+      {
+         unsigned short usLength = 0;
+         if (unRoom < CATLogBinary::RECORD_HEADER_SIZE)
+            return 0;
+         memcpy(&usLength, pData + 13, 2);
+         if (usLength > sizeof(SATLogRecord::m_cData))
+            return -1;
+         if (unRoom < CATLogBinary::RECORD_HEADER_SIZE + static_cast<size_t>(usLength))
+            return 0;
+
+         AddRecord(Collector, Client, pData);
+         return CATLogBinary::RECORD_HEADER_SIZE + usLength;
+      }
+      default:
+         return -1;
+   }
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Function:  ParseEntries
+//
+// Purpose:  Reads every whole entry waiting in a process's buffer, leaving a partial one for the next read.  A
+//           block is only read once all of it is here, so a process that's cut off mid block has either sent
+//           every record in it or none of them, which is how its sink counts what it dropped.
+//
+// In:  Collector - The collector.
+//      Client - The process.
+//
+// Out:  false if the stream is corrupt and the process should be hung up on.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool ParseEntries(SCollector& Collector, SClient& Client)
+{
+   for (;;)
+   {
+      const char* pData = Client.m_vBuffer.data() + Client.m_unStart;
+      size_t unRoom = Client.m_vBuffer.size() - Client.m_unStart;
+      long long llEntry = 0;  //Size of the entry, 0 until all of it is here.
+
+      if (!Client.m_bHeader)
+      {
+         unsigned short usFlags = 0;
+         if (unRoom < CATLogBinary::HEADER_SIZE)
+            break;
+         if (!CATLogBinary::ReadHeader(pData, usFlags))
+            return false;
+         Client.m_bHeader = true;
+         llEntry = CATLogBinary::HEADER_SIZE;
+      }
+      else if (unRoom == 0)
+         break;
+      else if (pData[0] == CATLogBinary::ENTRY_BLOCK)
+      {
+         SATLogBlock Block;
+         if (unRoom < CATLogBinary::BLOCK_HEADER_SIZE)
+            break;
+         CATLogBinary::ReadBlockHeader(pData, Block);
+         if (Block.m_unLength > AT_COLLECT_MAX_BLOCK)
+            return false;
+         if (unRoom < CATLogBinary::BLOCK_HEADER_SIZE + static_cast<size_t>(Block.m_unLength))
+            break;
+
+         //Every entry in the block has to be there in full.
+         size_t unAt = CATLogBinary::BLOCK_HEADER_SIZE;
+         while (unAt < CATLogBinary::BLOCK_HEADER_SIZE + Block.m_unLength)
+         {
+            long long llInner = ParseEntry(Collector, Client, pData + unAt, CATLogBinary::BLOCK_HEADER_SIZE + Block.m_unLength - unAt);
+            if (llInner <= 0)
+               return false;
+            unAt += static_cast<size_t>(llInner);
+         }
+         llEntry = static_cast<long long>(unAt);
+      }
+      else
+      {
+         llEntry = ParseEntry(Collector, Client, pData, unRoom);
+         if (llEntry < 0)
+            return false;
+      }
+
+      if (llEntry == 0)
+         break;
+      Client.m_unStart += static_cast<size_t>(llEntry);
+   }
+
+   //Slide the partial entry down to the front once the parsed bytes pile up.
+   if (Client.m_unStart > 0 && Client.m_unStart * 2 >= Client.m_vBuffer.size())
+   {
+      Client.m_vBuffer.erase(Client.m_vBuffer.begin(), Client.m_vBuffer.begin() + static_cast<std::ptrdiff_t>(Client.m_unStart));
+      Client.m_unStart = 0;
+   }
+   return true;
+}
+
+//Writes out the oldest held back record.
+static void WriteOldest(SCollector& Collector)
+{
+   SATLogRecord* pRecord = Collector.m_pqPending.top().m_pRecord;
+   Collector.m_pqPending.pop();
+
+   if (pRecord->m_ullTimestamp < Collector.m_ullLastWritten)
+      Collector.m_ullLate++;
+   else
+      Collector.m_ullLastWritten = pRecord->m_ullTimestamp;
+
+   Collector.m_pSink->Write(*pRecord);
+   Collector.m_ullWritten++;
+   Collector.m_vFree.push_back(pRecord);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Function:  WriteReady
+//
+// Purpose:  Writes out every held back record no process can still send anything older than.  That's anything up
+//           to the earliest of the processes' latest records, or older than the merge window no matter what.
+//
+// In:  Collector - The collector.
+//      bAll - Write out everything, we're stopping.
+//
+// Out:  None
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static void WriteReady(SCollector& Collector, bool bAll)
+{
+   unsigned long long ullNow = WallNow();
+   unsigned long long ullLimit = (ullNow > Collector.m_ullWindow) ? ullNow - Collector.m_ullWindow : 0;
+   unsigned long long ullEarliest = ~0ULL;
+   for (SClient* pClient : Collector.m_vClients)
+   {
+      if (pClient->m_ullLatest < ullEarliest)
+         ullEarliest = pClient->m_ullLatest;
+   }
+   if (ullEarliest != ~0ULL && ullEarliest > ullLimit)
+      ullLimit = ullEarliest;
+
+   while (!Collector.m_pqPending.empty() && (bAll || Collector.m_pqPending.top().m_ullTimestamp <= ullLimit ||
+      Collector.m_pqPending.size() > AT_COLLECT_MAX_PENDING))
+      WriteOldest(Collector);
+}
+
+//Hangs up on a process.  Whatever it already sent stays in the merge.
+static void DropClient(SCollector& Collector, size_t unClient)
+{
+   SClient* pClient = Collector.m_vClients[unClient];
+   if (Collector.m_bVerbose)
+      fprintf(stderr, "ATLogCollector: %s disconnected\n", pClient->m_sSource.c_str());
+
+   close(pClient->m_nSocket);
+   delete pClient;
+   Collector.m_vClients.erase(Collector.m_vClients.begin() + static_cast<std::ptrdiff_t>(unClient));
+}
+
+//Opens the socket we listen on, replacing whatever a collector before us left behind.
+static int Listen(const char* pPath)
+{
+   sockaddr_un saAddress;
+   memset(&saAddress, 0, sizeof(saAddress));
+   saAddress.sun_family = AF_UNIX;
+   if (strlen(pPath) >= sizeof(saAddress.sun_path))
+      return -1;
+   strcpy(saAddress.sun_path, pPath);
+
+   int nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (nSocket < 0)
+      return -1;
+
+   unlink(pPath);
+   if (bind(nSocket, reinterpret_cast<sockaddr*>(&saAddress), sizeof(saAddress)) != 0 || listen(nSocket, 64) != 0)
+   {
+      close(nSocket);
+      return -1;
+   }
+
+   fcntl(nSocket, F_SETFL, fcntl(nSocket, F_GETFL, 0) | O_NONBLOCK);
+   return nSocket;
+}
+
+int main(int argc, char** argv)
+{
+   const char* pSocket = AT_LOG_SOCKET_PATH;  //Socket we listen on.
+   const char* pOutput = "collected.log";  //Log we're writing.
+   unsigned long long ullMaxMegabytes = 64;
+   unsigned int unMaxSeconds = 0;
+   unsigned int unKeep = AT_LOG_ROLL_KEEP;
+   bool bBinary = false;
+   bool bIndexed = false;
+   bool bJson = false;
+   bool bTimestamp = false;
+   unsigned int unDigits = 0;
+   SCollector Collector;
+
+   for (int i = 1; i < argc; i++)
+   {
+      bool bHasValue = (i + 1 < argc);
+      if (strcmp(argv[i], "-s") == 0 && bHasValue)
+         pSocket = argv[++i];
+      else if (strcmp(argv[i], "-o") == 0 && bHasValue)
+         pOutput = argv[++i];
+      else if (strcmp(argv[i], "-r") == 0 && bHasValue)
+         ullMaxMegabytes = strtoull(argv[++i], 0, 10);
+      else if (strcmp(argv[i], "-a") == 0 && bHasValue)
+         unMaxSeconds = static_cast<unsigned int>(atoi(argv[++i]));
+      else if (strcmp(argv[i], "-k") == 0 && bHasValue)
+         unKeep = static_cast<unsigned int>(atoi(argv[++i]));
+      else if (strcmp(argv[i], "-d") == 0 && bHasValue)
+         unDigits = static_cast<unsigned int>(atoi(argv[++i]));
+      else if (strcmp(argv[i], "-w") == 0 && bHasValue)
+         Collector.m_ullWindow = strtoull(argv[++i], 0, 10) * 1000000ULL;
+      else if (strcmp(argv[i], "-b") == 0)
+         bBinary = true;
+      else if (strcmp(argv[i], "-x") == 0)
+         bIndexed = true;
+      else if (strcmp(argv[i], "-j") == 0)
+         bJson = true;
+      else if (strcmp(argv[i], "-t") == 0)
+         bTimestamp = true;
+      else if (strcmp(argv[i], "-v") == 0)
+         Collector.m_bVerbose = true;
+      else
+      {
+         fprintf(stderr, "Usage: ATLogCollector [-s socket] [-o log] [-r MB] [-a seconds] [-k keep] [-b | -x | -j] [-t] [-d digits]\n"
+            "                      [-w milliseconds] [-v]\n");
+         return 1;
+      }
+   }
+
+   Collector.m_pSink = new CATRollingFileSink(bBinary, bIndexed);
+   if (bJson)
+      Collector.m_pSink->SetFormatter(CATLogJson::Formatter);
+   Collector.m_pSink->SetTimestamp(bTimestamp);
+   Collector.m_pSink->SetTimestampDigits(unDigits);
+   Collector.m_pSink->SetRollPolicy(ullMaxMegabytes * 1024 * 1024, unMaxSeconds, unKeep);
+   if (!Collector.m_pSink->Open(pOutput))
+   {
+      fprintf(stderr, "ATLogCollector: Couldn't open %s\n", pOutput);
+      delete Collector.m_pSink;
+      return 1;
+   }
+   Collector.m_pSink->Start(false);
+
+   int nListen = Listen(pSocket);
+   if (nListen < 0)
+   {
+      fprintf(stderr, "ATLogCollector: Couldn't listen on %s\n", pSocket);
+      Collector.m_pSink->Stop();
+      delete Collector.m_pSink;
+      return 1;
+   }
+
+   signal(SIGINT, OnStopSignal);
+   signal(SIGTERM, OnStopSignal);
+   signal(SIGPIPE, SIG_IGN);
+
+   std::vector<pollfd> vPoll;
+   while (!s_bStop)
+   {
+      vPoll.resize(Collector.m_vClients.size() + 1);
+      vPoll[0].fd = nListen;
+      vPoll[0].events = POLLIN;
+      vPoll[0].revents = 0;
+      for (size_t i = 0; i < Collector.m_vClients.size(); i++)
+      {
+         vPoll[i + 1].fd = Collector.m_vClients[i]->m_nSocket;
+         vPoll[i + 1].events = POLLIN;
+         vPoll[i + 1].revents = 0;
+      }
+
+      //Wake up every so often even when it's quiet, held back records age past the window on their own.
+      if (poll(vPoll.data(), vPoll.size(), 100) < 0 && errno != EINTR)
+         break;
+
+      //Read from the processes first, walking backwards so hanging up on one doesn't upset the rest.
+      for (size_t i = Collector.m_vClients.size(); i-- > 0;)
+      {
+         if (!vPoll[i + 1].revents)
+            continue;
+
+         SClient& Client = *Collector.m_vClients[i];
+         size_t unOld = Client.m_vBuffer.size();
+         Client.m_vBuffer.resize(unOld + AT_COLLECT_READ_SIZE);
+         ssize_t nRead = recv(Client.m_nSocket, Client.m_vBuffer.data() + unOld, AT_COLLECT_READ_SIZE, 0);
+         Client.m_vBuffer.resize(unOld + ((nRead > 0) ? static_cast<size_t>(nRead) : 0));
+
+         if (nRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            continue;
+         if (nRead <= 0 || !ParseEntries(Collector, Client))
+            DropClient(Collector, i);
+      }
+
+      //Then take on anyone new.
+      if (vPoll[0].revents & POLLIN)
+      {
+         for (;;)
+         {
+            int nClient = accept(nListen, 0, 0);
+            if (nClient < 0)
+               break;
+
+            fcntl(nClient, F_SETFL, fcntl(nClient, F_GETFL, 0) | O_NONBLOCK);
+            SClient* pClient = new SClient();
+            pClient->m_nSocket = nClient;
+            pClient->m_sSource = "unknown";
+            Collector.m_vClients.push_back(pClient);
+         }
+      }
+
+      WriteReady(Collector, false);
+   }
+
+   //Write out everything we're holding and everything still on its way in.
+   while (!Collector.m_vClients.empty())
+   {
+      SClient& Client = *Collector.m_vClients.back();
+      for (;;)
+      {
+         size_t unOld = Client.m_vBuffer.size();
+         Client.m_vBuffer.resize(unOld + AT_COLLECT_READ_SIZE);
+         ssize_t nRead = recv(Client.m_nSocket, Client.m_vBuffer.data() + unOld, AT_COLLECT_READ_SIZE, 0);
+         Client.m_vBuffer.resize(unOld + ((nRead > 0) ? static_cast<size_t>(nRead) : 0));
+         if (nRead <= 0 || !ParseEntries(Collector, Client))
+            break;
+      }
+      DropClient(Collector, Collector.m_vClients.size() - 1);
+   }
+   WriteReady(Collector, true);
+
+   close(nListen);
+   unlink(pSocket);
+   Collector.m_pSink->Stop();
+   delete Collector.m_pSink;
+
+   if (Collector.m_bVerbose)
+      fprintf(stderr, "ATLogCollector: %llu records written, %llu of them out of order\n", Collector.m_ullWritten, Collector.m_ullLate);
+   for (SATLogRecord* pRecord : Collector.m_vFree)
+      delete pRecord;
+   return 0;
+}
+#endif
@@ -0,0 +1,151 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogDecode.cpp
+//
+// Purpose: Turns a Log file written in BINARY mode back into the same text the Logger would have written.
+//
+//          Usage:  ATLogDecode <binary log> [-t | -n] [-j]
+//                  -t  Start every line with its time stamp.
+//                  -n  Leave time stamps off.
+//                  -j  Write JSON Lines (see ATLogJson.h) instead of text.
+//                  By default time stamps are written if the Logger had TIMESTAMP on when the file was written, with
+//                  the precision it was set to.  INDEXED files are decoded start to finish, see ATLogQuery for
+//                  pulling out just a time range or level.
+//
+//          Build with ATLogFormat.cpp, ATLogBinary.cpp, ATLogJson.cpp, ATLogChannel.cpp, ATFileWriter.cpp and CString.cpp.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "../ATLogBinary.h"
+#include "../ATLogJson.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace Atlas;
+
+int main(int argc, char** argv)
+{
+   const char* pFilename = 0;  //Binary Log we're decoding.
+   int nTimestamps = -1;  //-1 = do what the file says, 0 = never, 1 = always.
+   bool bJson = false;  //Write JSON Lines instead of text?
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-t") == 0)
+         nTimestamps = 1;
+      else if (strcmp(argv[i], "-n") == 0)
+         nTimestamps = 0;
+      else if (strcmp(argv[i], "-j") == 0)
+         bJson = true;
+      else
+         pFilename = argv[i];
+   }
+
+   if (!pFilename)
+   {
+      fprintf(stderr, "Usage: ATLogDecode <binary log> [-t | -n] [-j]\n");
+      return 1;
+   }
+
+   FILE* pFile = fopen(pFilename, "rb");
+   if (!pFile)
+   {
+      fprintf(stderr, "ATLogDecode: Couldn't open %s\n", pFilename);
+      return 1;
+   }
+
+   //Make sure it's one of ours.
+   char cHeader[CATLogBinary::HEADER_SIZE];
+   unsigned short usFlags = 0;
+   if (fread(cHeader, 1, sizeof(cHeader), pFile) != sizeof(cHeader) || !CATLogBinary::ReadHeader(cHeader, usFlags))
+   {
+      fprintf(stderr, "ATLogDecode: %s isn't a binary Atlas Log\n", pFilename);
+      fclose(pFile);
+      return 1;
+   }
+
+   bool bTimestamp = (nTimestamps == -1) ? ((usFlags & CATLogBinary::FILE_TIMESTAMP) != 0) : (nTimestamps == 1);
+   unsigned int unDigits = (usFlags & CATLogBinary::FILE_DIGITS) >> CATLogBinary::FILE_DIGITS_SHIFT;
+
+   std::vector<std::string> vFormats;  //Formats defined so far, indexed by id.
+   std::vector<std::string> vChannels;  //Channel names defined so far, indexed by id.
+   std::vector<char> vData(0x10000);  //Format text or record data being read.
+   char cLine[AT_LOG_LINE_SIZE + 1];  //Text being built, plus room for the newline.
+   int nResult = 0;
+
+   for (;;)
+   {
+      int nTag = fgetc(pFile);
+      if (nTag == EOF)
+         break;
+
+      if (nTag == CATLogBinary::ENTRY_BLOCK)
+      {
+         //A block's entries are just the same entries, read on through its header.
+         char cEntry[CATLogBinary::BLOCK_HEADER_SIZE];
+         if (fread(cEntry + 1, 1, sizeof(cEntry) - 1, pFile) != sizeof(cEntry) - 1)
+            break;
+      }
+      else if (nTag == CATLogBinary::ENTRY_FORMAT)
+      {
+         char cEntry[CATLogBinary::FORMAT_HEADER_SIZE];
+         unsigned int unId = 0;
+         unsigned short usLength = 0;
+
+         if (fread(cEntry + 1, 1, sizeof(cEntry) - 1, pFile) != sizeof(cEntry) - 1)
+            break;
+         memcpy(&unId, cEntry + 1, 4);
+         memcpy(&usLength, cEntry + 5, 2);
+         if (fread(vData.data(), 1, usLength, pFile) != usLength)
+            break;
+
+         if (unId >= vFormats.size())
+            vFormats.resize(unId + 1, "{s}");
+         vFormats[unId].assign(vData.data(), usLength);
+      }
+      else if (nTag == CATLogBinary::ENTRY_CHANNEL)
+      {
+         char cEntry[CATLogBinary::CHANNEL_HEADER_SIZE];
+         if (fread(cEntry + 1, 1, sizeof(cEntry) - 1, pFile) != sizeof(cEntry) - 1)
+            break;
+
+         unsigned char ucId = static_cast<unsigned char>(cEntry[1]);
+         unsigned char ucLength = static_cast<unsigned char>(cEntry[2]);
+         if (fread(vData.data(), 1, ucLength, pFile) != ucLength)
+            break;
+
+         if (ucId >= vChannels.size())
+            vChannels.resize(ucId + 1);
+         vChannels[ucId].assign(vData.data(), ucLength);
+      }
+      else if (nTag == CATLogBinary::ENTRY_RECORD)
+      {
+         char cEntry[CATLogBinary::RECORD_HEADER_SIZE];
+         SATLogRecord Record;
+
+         if (fread(cEntry + 1, 1, sizeof(cEntry) - 1, pFile) != sizeof(cEntry) - 1)
+            break;
+         CATLogBinary::ReadRecordHeader(cEntry, Record);
+         if (Record.m_usLength > sizeof(Record.m_cData) || fread(Record.m_cData, 1, Record.m_usLength, pFile) != Record.m_usLength)
+            break;
+
+         const char* pFormat = (Record.m_unFormatId < vFormats.size()) ? vFormats[Record.m_unFormatId].c_str() : "{s}";
+         const char* pChannel = (Record.m_ucChannel < vChannels.size()) ? vChannels[Record.m_ucChannel].c_str() : "";
+
+         CATFormatBuffer fbLine(cLine, AT_LOG_LINE_SIZE);
+         if (bJson)
+            CATLogJson::FormatRecord(fbLine, pFormat, pChannel, Record, bTimestamp, unDigits);
+         else
+            CATLogBinary::FormatRecord(fbLine, pFormat, pChannel, Record, bTimestamp, unDigits);
+         cLine[fbLine.Length()] = '\n';
+         fwrite(cLine, 1, fbLine.Length() + 1, stdout);
+      }
+      else
+      {
+         fprintf(stderr, "ATLogDecode: %s is corrupt at offset %ld\n", pFilename, ftell(pFile) - 1);
+         nResult = 1;
+         break;
+      }
+   }
+
+   fclose(pFile);
+   return nResult;
+}
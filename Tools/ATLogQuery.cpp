@@ -0,0 +1,420 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File:	ATLogQuery.cpp
+//
+// Purpose: Pulls the messages in a time range and/or at certain levels out of a binary Log file.  INDEXED files are
+//          read a block header at a time, seeking straight past every block whose index says it has nothing we're
+//          after, and the blocks that are left are decoded in parallel across the cores.  The output is the same text
+//          (or JSON Lines) ATLogDecode would write, in file order.
+//
+//          Usage:  ATLogQuery <binary log> [-f from] [-u until] [-l levels] [-p threads] [-t | -n] [-j] [-v]
+//                  -f  Only messages at or after this local time, "YYYY-MM-DD HH:MM[:SS[.fraction]]" or seconds
+//                      since the epoch.
+//                  -u  Only messages before this time, same forms as -f.
+//                  -l  Only these levels, any of e (error), w (warn), t (trace) and i (info), e.g. "ew".
+//                  -p  Threads to decode with (default: number of cores).
+//                  -t  Start every line with its time stamp.
+//                  -n  Leave time stamps off.
+//                  -j  Write JSON Lines (see ATLogJson.h) instead of text.
+//                  -v  Say how many blocks were read and skipped on stderr.
+//                  Files that weren't written INDEXED still work, they're just read start to finish on one thread.
+//
+//          Build with ATLogFormat.cpp, ATLogBinary.cpp, ATLogJson.cpp, ATLogChannel.cpp, ATFileWriter.cpp and CString.cpp.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#include "../ATLogBinary.h"
+#include "../ATLogJson.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define AT_FSEEK _fseeki64
+#define AT_FTELL _ftelli64
+#else
+#define AT_FSEEK fseeko
+#define AT_FTELL ftello
+#endif
+
+//Blocks handed to each thread per round, the output of a round is written out before the next one starts.
+#define AT_QUERY_BLOCKS_PER_THREAD 16
+
+using namespace Atlas;
+
+//What we're pulling out of the file and how it's written.
+struct SQuery
+{
+   unsigned long long   m_ullFrom = 0;  //Earliest time stamp wanted, nanoseconds since the epoch.
+   unsigned long long   m_ullUntil = ~0ULL;  //Time stamps from here on aren't wanted.
+   unsigned char        m_ucLevels = 0x0F;  //Bit per eLevel wanted.
+   bool                 m_bJson = false;  //Write JSON Lines instead of text?
+   bool                 m_bTimestamp = false;  //Start lines with time stamps?
+   unsigned int         m_unDigits = 0;  //Digits after the seconds in those time stamps.
+};
+
+//An indexed block that made it past the query, and where it lives in the file.
+struct SQueryBlock
+{
+   long long      m_llOffset;  //Offset of the block's entries (just past its header).
+   SATLogBlock    m_Block;  //The block's index.
+};
+
+//Turns "YYYY-MM-DD HH:MM[:SS[.fraction]]" (local time) or a plain number of seconds since the epoch into nanoseconds
+//since the epoch.  Returns false if it's neither.
+static bool ParseTime(const char* pText, unsigned long long& ullTime)
+{
+   char* pEnd = 0;
+   unsigned long long ullSeconds = strtoull(pText, &pEnd, 10);
+   if (pEnd != pText && *pEnd == 0)
+   {
+      ullTime = ullSeconds * 1000000000ULL;
+      return true;
+   }
+
+   tm local_time = {};
+   double dSeconds = 0.0;
+   if (sscanf(pText, "%d-%d-%d %d:%d:%lf", &local_time.tm_year, &local_time.tm_mon, &local_time.tm_mday,
+      &local_time.tm_hour, &local_time.tm_min, &dSeconds) < 5)
+      return false;
+
+   local_time.tm_year -= 1900;
+   local_time.tm_mon -= 1;
+   local_time.tm_sec = static_cast<int>(dSeconds);
+   local_time.tm_isdst = -1;
+   time_t ttTime = mktime(&local_time);
+   if (ttTime == static_cast<time_t>(-1) || dSeconds < 0.0)
+      return false;
+
+   ullTime = static_cast<unsigned long long>(ttTime) * 1000000000ULL +
+      static_cast<unsigned long long>((dSeconds - local_time.tm_sec) * 1e9 + 0.5);
+   return true;
+}
+
+//Turns level letters ("ewti") into a bit per eLevel.  Returns 0 if there's a letter we don't know.
+static unsigned char ParseLevels(const char* pText)
+{
+   unsigned char ucLevels = 0;
+   for (; *pText; pText++)
+   {
+      switch (*pText)
+      {
+         case 'e': case 'E': ucLevels |= 1 << 0; break;
+         case 'w': case 'W': ucLevels |= 1 << 1; break;
+         case 't': case 'T': ucLevels |= 1 << 2; break;
+         case 'i': case 'I': ucLevels |= 1 << 3; break;
+         default: return 0;
+      }
+   }
+   return ucLevels;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Function:  DecodeEntries
+//
+// Purpose:  Decodes a run of format, channel and record entries, either an indexed block or everything after the
+//           header of a file that isn't indexed, and adds a line for every record the query wants.  Only touches
+//           its own arguments, so any number of threads can run it at once.
+//
+// In:  pData - The entries.
+//      unLength - Number of bytes in pData.
+//      Query - What we're after and how it's written.
+//      sOut - Where the lines are going.
+//
+// Out:  true if every entry was read, false if they're corrupt or cut short.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool DecodeEntries(const char* pData, size_t unLength, const SQuery& Query, std::string& sOut)
+{
+   std::vector<std::string> vFormats;  //Formats defined so far, indexed by id.
+   std::vector<std::string> vChannels;  //Channel names defined so far, indexed by id.
+   char cLine[AT_LOG_LINE_SIZE + 1];  //Text being built, plus room for the newline.
+   size_t unAt = 0;
+
+   while (unAt < unLength)
+   {
+      char cTag = pData[unAt];
+      size_t unLeft = unLength - unAt;
+
+      if (cTag == CATLogBinary::ENTRY_FORMAT)
+      {
+         unsigned int unId = 0;
+         unsigned short usLength = 0;
+         if (unLeft < CATLogBinary::FORMAT_HEADER_SIZE)
+            return false;
+         memcpy(&unId, pData + unAt + 1, 4);
+         memcpy(&usLength, pData + unAt + 5, 2);
+         if (unLeft < CATLogBinary::FORMAT_HEADER_SIZE + static_cast<size_t>(usLength) || unId >= AT_LOG_MAX_FORMATS)
+            return false;
+
+         if (unId >= vFormats.size())
+            vFormats.resize(unId + 1, "{s}");
+         vFormats[unId].assign(pData + unAt + CATLogBinary::FORMAT_HEADER_SIZE, usLength);
+         unAt += CATLogBinary::FORMAT_HEADER_SIZE + usLength;
+      }
+      else if (cTag == CATLogBinary::ENTRY_CHANNEL)
+      {
+         if (unLeft < CATLogBinary::CHANNEL_HEADER_SIZE)
+            return false;
+         unsigned char ucId = static_cast<unsigned char>(pData[unAt + 1]);
+         unsigned char ucLength = static_cast<unsigned char>(pData[unAt + 2]);
+         if (unLeft < CATLogBinary::CHANNEL_HEADER_SIZE + static_cast<size_t>(ucLength))
+            return false;
+
+         if (ucId >= vChannels.size())
+            vChannels.resize(ucId + 1);
+         vChannels[ucId].assign(pData + unAt + CATLogBinary::CHANNEL_HEADER_SIZE, ucLength);
+         unAt += CATLogBinary::CHANNEL_HEADER_SIZE + ucLength;
+      }
+      else if (cTag == CATLogBinary::ENTRY_RECORD)
+      {
+         SATLogRecord Record;
+         if (unLeft < CATLogBinary::RECORD_HEADER_SIZE)
+            return false;
+         CATLogBinary::ReadRecordHeader(pData + unAt, Record);
+         if (Record.m_usLength > sizeof(Record.m_cData) || unLeft < CATLogBinary::RECORD_HEADER_SIZE + static_cast<size_t>(Record.m_usLength))
+            return false;
+         unAt += CATLogBinary::RECORD_HEADER_SIZE;
+
+         //Only records the query wants get their data copied out and their text built.
+         if (Record.m_ullTimestamp >= Query.m_ullFrom && Record.m_ullTimestamp < Query.m_ullUntil &&
+            Record.m_ucLevel < 8 && (Query.m_ucLevels & (1 << Record.m_ucLevel)))
+         {
+            memcpy(Record.m_cData, pData + unAt, Record.m_usLength);
+
+            const char* pFormat = (Record.m_unFormatId < vFormats.size()) ? vFormats[Record.m_unFormatId].c_str() : "{s}";
+            const char* pChannel = (Record.m_ucChannel < vChannels.size()) ? vChannels[Record.m_ucChannel].c_str() : "";
+
+            CATFormatBuffer fbLine(cLine, AT_LOG_LINE_SIZE);
+            if (Query.m_bJson)
+               CATLogJson::FormatRecord(fbLine, pFormat, pChannel, Record, Query.m_bTimestamp, Query.m_unDigits);
+            else
+               CATLogBinary::FormatRecord(fbLine, pFormat, pChannel, Record, Query.m_bTimestamp, Query.m_unDigits);
+            cLine[fbLine.Length()] = '\n';
+            sOut.append(cLine, fbLine.Length() + 1);
+         }
+         unAt += Record.m_usLength;
+      }
+      else
+         return false;
+   }
+   return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Function:  FindBlocks
+//
+// Purpose:  Hops from block header to block header through an INDEXED file, keeping the blocks whose index says
+//           they could have something the query wants.  Nothing but the headers is read.  A block cut short at
+//           the end (the file is still being written) is left out.
+//
+// In:  pFile - The file, just past its header.
+//      Query - What we're after.
+//      vBlocks - Where the blocks worth decoding go.
+//      unTotal - Receives the number of blocks in the file.
+//
+// Out:  true if the whole file was walked, false if a block header is corrupt.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool FindBlocks(FILE* pFile, const SQuery& Query, std::vector<SQueryBlock>& vBlocks, unsigned int& unTotal)
+{
+   AT_FSEEK(pFile, 0, SEEK_END);
+   long long llSize = static_cast<long long>(AT_FTELL(pFile));
+   long long llOffset = CATLogBinary::HEADER_SIZE;
+   unTotal = 0;
+
+   char cHeader[CATLogBinary::BLOCK_HEADER_SIZE];
+   while (llOffset + CATLogBinary::BLOCK_HEADER_SIZE <= llSize)
+   {
+      SATLogBlock Block;
+      if (AT_FSEEK(pFile, llOffset, SEEK_SET) != 0 || fread(cHeader, 1, sizeof(cHeader), pFile) != sizeof(cHeader))
+         break;
+      if (!CATLogBinary::ReadBlockHeader(cHeader, Block))
+         return false;
+
+      llOffset += CATLogBinary::BLOCK_HEADER_SIZE;
+      if (llOffset + Block.m_unLength > llSize)
+         break;
+      unTotal++;
+
+      if (Block.m_ullLast >= Query.m_ullFrom && Block.m_ullFirst < Query.m_ullUntil && (Block.m_ucLevels & Query.m_ucLevels))
+         vBlocks.push_back({llOffset, Block});
+      llOffset += Block.m_unLength;
+   }
+   return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Function:  DecodeBlocks
+//
+// Purpose:  Decodes the blocks FindBlocks kept across unThreads threads and writes their lines out in file order.
+//           Blocks are handed out a round at a time, each thread reading its own with its own FILE, so the output
+//           never has to wait on more than a round's worth of blocks.
+//
+// In:  pFilename - The file.
+//      vBlocks - Blocks to decode, in file order.
+//      Query - What we're after and how it's written.
+//      unThreads - Threads to decode with.
+//
+// Out:  true if every block was decoded, false otherwise.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+static bool DecodeBlocks(const char* pFilename, const std::vector<SQueryBlock>& vBlocks, const SQuery& Query, unsigned int unThreads)
+{
+   size_t unRound = static_cast<size_t>(unThreads) * AT_QUERY_BLOCKS_PER_THREAD;
+   std::vector<std::string> vOut(unRound);
+   std::atomic<bool> bOk(true);
+
+   for (size_t unFirst = 0; unFirst < vBlocks.size() && bOk; unFirst += unRound)
+   {
+      size_t unCount = (vBlocks.size() - unFirst < unRound) ? vBlocks.size() - unFirst : unRound;
+      std::atomic<size_t> unNext(0);
+
+      auto fnWorker = [&]()
+      {
+         FILE* pFile = fopen(pFilename, "rb");
+         if (!pFile)
+         {
+            bOk = false;
+            return;
+         }
+
+         std::vector<char> vData;
+         for (size_t i = unNext++; i < unCount; i = unNext++)
+         {
+            const SQueryBlock& Block = vBlocks[unFirst + i];
+            vData.resize(Block.m_Block.m_unLength);
+            vOut[i].clear();
+            if (AT_FSEEK(pFile, Block.m_llOffset, SEEK_SET) != 0 || fread(vData.data(), 1, vData.size(), pFile) != vData.size() ||
+               !DecodeEntries(vData.data(), vData.size(), Query, vOut[i]))
+               bOk = false;
+         }
+         fclose(pFile);
+      };
+
+      //No point starting more threads than there are blocks, and the calling thread pitches in too.
+      std::vector<std::thread> vThreads;
+      for (unsigned int t = 1; t < unThreads && t < unCount; t++)
+         vThreads.emplace_back(fnWorker);
+      fnWorker();
+      for (std::thread& tWorker : vThreads)
+         tWorker.join();
+
+      for (size_t i = 0; i < unCount; i++)
+         fwrite(vOut[i].data(), 1, vOut[i].size(), stdout);
+   }
+   return bOk;
+}
+
+int main(int argc, char** argv)
+{
+   const char* pFilename = 0;  //Binary Log we're querying.
+   int nTimestamps = -1;  //-1 = do what the file says, 0 = never, 1 = always.
+   unsigned int unThreads = std::thread::hardware_concurrency();
+   bool bVerbose = false;
+   SQuery Query;
+
+   for (int i = 1; i < argc; i++)
+   {
+      bool bHasValue = (i + 1 < argc);
+      if (strcmp(argv[i], "-f") == 0 && bHasValue)
+      {
+         if (!ParseTime(argv[++i], Query.m_ullFrom))
+         {
+            fprintf(stderr, "ATLogQuery: Can't read the time \"%s\"\n", argv[i]);
+            return 1;
+         }
+      }
+      else if (strcmp(argv[i], "-u") == 0 && bHasValue)
+      {
+         if (!ParseTime(argv[++i], Query.m_ullUntil))
+         {
+            fprintf(stderr, "ATLogQuery: Can't read the time \"%s\"\n", argv[i]);
+            return 1;
+         }
+      }
+      else if (strcmp(argv[i], "-l") == 0 && bHasValue)
+      {
+         Query.m_ucLevels = ParseLevels(argv[++i]);
+         if (!Query.m_ucLevels)
+         {
+            fprintf(stderr, "ATLogQuery: Levels are any of e, w, t and i, not \"%s\"\n", argv[i]);
+            return 1;
+         }
+      }
+      else if (strcmp(argv[i], "-p") == 0 && bHasValue)
+         unThreads = static_cast<unsigned int>(atoi(argv[++i]));
+      else if (strcmp(argv[i], "-t") == 0)
+         nTimestamps = 1;
+      else if (strcmp(argv[i], "-n") == 0)
+         nTimestamps = 0;
+      else if (strcmp(argv[i], "-j") == 0)
+         Query.m_bJson = true;
+      else if (strcmp(argv[i], "-v") == 0)
+         bVerbose = true;
+      else
+         pFilename = argv[i];
+   }
+
+   if (!pFilename)
+   {
+      fprintf(stderr, "Usage: ATLogQuery <binary log> [-f from] [-u until] [-l levels] [-p threads] [-t | -n] [-j] [-v]\n");
+      return 1;
+   }
+   if (unThreads == 0)
+      unThreads = 1;
+
+   FILE* pFile = fopen(pFilename, "rb");
+   if (!pFile)
+   {
+      fprintf(stderr, "ATLogQuery: Couldn't open %s\n", pFilename);
+      return 1;
+   }
+
+   //Make sure it's one of ours.
+   char cHeader[CATLogBinary::HEADER_SIZE];
+   unsigned short usFlags = 0;
+   if (fread(cHeader, 1, sizeof(cHeader), pFile) != sizeof(cHeader) || !CATLogBinary::ReadHeader(cHeader, usFlags))
+   {
+      fprintf(stderr, "ATLogQuery: %s isn't a binary Atlas Log\n", pFilename);
+      fclose(pFile);
+      return 1;
+   }
+
+   Query.m_bTimestamp = (nTimestamps == -1) ? ((usFlags & CATLogBinary::FILE_TIMESTAMP) != 0) : (nTimestamps == 1);
+   Query.m_unDigits = (usFlags & CATLogBinary::FILE_DIGITS) >> CATLogBinary::FILE_DIGITS_SHIFT;
+
+   //Without an index there's nothing to skip, the whole file gets decoded in one go.
+   if (!(usFlags & CATLogBinary::FILE_INDEXED))
+   {
+      std::vector<char> vData;
+      char cChunk[0x10000];
+      for (size_t unRead; (unRead = fread(cChunk, 1, sizeof(cChunk), pFile)) > 0; )
+         vData.insert(vData.end(), cChunk, cChunk + unRead);
+      fclose(pFile);
+
+      std::string sOut;
+      bool bOk = DecodeEntries(vData.data(), vData.size(), Query, sOut);
+      fwrite(sOut.data(), 1, sOut.size(), stdout);
+      if (!bOk)
+      {
+         fprintf(stderr, "ATLogQuery: %s is corrupt or cut short\n", pFilename);
+         return 1;
+      }
+      return 0;
+   }
+
+   std::vector<SQueryBlock> vBlocks;
+   unsigned int unTotal = 0;
+   bool bOk = FindBlocks(pFile, Query, vBlocks, unTotal);
+   fclose(pFile);
+
+   if (bVerbose)
+      fprintf(stderr, "ATLogQuery: Reading %u of %u blocks on %u threads\n", static_cast<unsigned int>(vBlocks.size()), unTotal, unThreads);
+
+   if (!DecodeBlocks(pFilename, vBlocks, Query, unThreads) || !bOk)
+   {
+      fprintf(stderr, "ATLogQuery: %s is corrupt\n", pFilename);
+      return 1;
+   }
+   return 0;
+}